@@ -0,0 +1,177 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "c2pa.hpp"
+#include "test_signer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+/// @brief Read a file into a string
+string read_file(const fs::path &path) {
+  ifstream file(path, ios::binary);
+  if (!file.is_open()) {
+    throw runtime_error("Could not open file " + path.string());
+  }
+  return {istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+}
+
+/// @brief Timing and allocation results for one benchmark
+struct Result {
+  string name;
+  vector<double> times_us;
+  c2pa::AllocStats allocs{};
+};
+
+/// @brief Run a benchmark for a number of iterations
+/// @details The allocation figures are from the last iteration, so caches
+/// filled by the first run are not counted.
+Result run(const string &name, int iterations, const function<void()> &body) {
+  Result result{name, {}, {}};
+  for (int i = 0; i < iterations; i++) {
+    const auto start = chrono::steady_clock::now();
+    body();
+    const auto end = chrono::steady_clock::now();
+    result.times_us.push_back(
+        chrono::duration<double, micro>(end - start).count());
+    result.allocs = c2pa::last_alloc_stats();
+  }
+  return result;
+}
+
+double percentile(vector<double> values, double p) {
+  sort(values.begin(), values.end());
+  const auto last = static_cast<double>(values.size() - 1);
+  const auto index = static_cast<size_t>(p / 100.0 * last);
+  return values[index];
+}
+
+void print(const Result &result, bool alloc_tracking) {
+  double sum = 0;
+  for (const double t : result.times_us) {
+    sum += t;
+  }
+  cout << left << setw(12) << result.name << right << fixed << setprecision(1)
+       << setw(12) << sum / static_cast<double>(result.times_us.size())
+       << setw(12) << percentile(result.times_us, 50) << setw(12)
+       << percentile(result.times_us, 95);
+  if (alloc_tracking) {
+    cout << setw(12) << result.allocs.allocations << setw(14)
+         << result.allocs.bytes_allocated << setw(14)
+         << result.allocs.peak_bytes;
+  }
+  cout << '\n';
+}
+
+/// @brief Compare the JSON and CBOR output of one manifest store
+/// @details Only the output is timed, the store is read once.
+void store_formats(const fs::path &asset, int iterations) {
+  const auto reader = c2pa::Reader(asset);
+  const auto json_size = reader.json().size();
+  const auto cbor_size = reader.cbor().size();
+  const auto json = run("json", iterations, [&] { auto out = reader.json(); });
+  const auto cbor = run("cbor", iterations, [&] { auto out = reader.cbor(); });
+  cout << "\nmanifest store of " << asset.filename().string() << '\n';
+  cout << left << setw(12) << "format" << right << setw(12) << "bytes"
+       << setw(12) << "p50_us" << setw(12) << "p95_us" << '\n';
+  const auto row = [](const Result &result, size_t size) {
+    cout << left << setw(12) << result.name << right << setw(12) << size
+         << setw(12) << percentile(result.times_us, 50) << setw(12)
+         << percentile(result.times_us, 95) << '\n';
+  };
+  row(json, json_size);
+  row(cbor, cbor_size);
+}
+} // namespace
+
+/// @brief Measures reading and signing latency and memory use.
+/// @details Usage: bench [iterations] [signed asset].
+/// Allocation columns are only shown when the library is built with the
+/// alloc_tracking feature. JSON and CBOR output are compared for the test
+/// fixture, and for the signed asset if one is given, which should have a
+/// large manifest store.
+/// @return 0 on success, 1 on failure
+int main(int argc, char *argv[]) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 20;
+  const fs::path fixtures =
+      fs::path(__FILE__).parent_path() / "../tests/fixtures";
+
+  bool alloc_tracking = true;
+  try {
+    c2pa::enable_alloc_tracking();
+  } catch (c2pa::Exception const &) {
+    alloc_tracking = false;
+  }
+
+  try {
+    const string signed_image = read_file(fixtures / "C.jpg");
+    const string unsigned_image = read_file(fixtures / "A.jpg");
+    const string manifest_json = read_file(fixtures / "training.json");
+    const string certs = read_file(fixtures / "es256_certs.pem");
+    auto signer = c2pa::Signer(&test_signer, Es256, certs, nullopt);
+
+    vector<Result> results;
+    results.push_back(run("read", iterations, [&] {
+      istringstream source(signed_image);
+      auto reader = c2pa::Reader("image/jpeg", source);
+    }));
+    results.push_back(run("read_json", iterations, [&] {
+      istringstream source(signed_image);
+      auto reader = c2pa::Reader("image/jpeg", source);
+      auto json = reader.json();
+    }));
+    results.push_back(run("sign", iterations, [&] {
+      istringstream source(unsigned_image);
+      stringstream dest;
+      auto builder = c2pa::Builder(manifest_json);
+      auto manifest = builder.sign("image/jpeg", source, dest, signer);
+    }));
+
+    cout << "c2pa " << c2pa::version() << ", " << iterations
+         << " iterations, times in us\n";
+    cout << left << setw(12) << "benchmark" << right << setw(12) << "mean"
+         << setw(12) << "p50" << setw(12) << "p95";
+    if (alloc_tracking) {
+      cout << setw(12) << "allocs" << setw(14) << "bytes" << setw(14)
+           << "peak_bytes";
+    }
+    cout << '\n';
+    for (const auto &result : results) {
+      print(result, alloc_tracking);
+    }
+    store_formats(fixtures / "C.jpg", iterations);
+    if (argc > 2) {
+      store_formats(argv[2], iterations);
+    }
+  } catch (c2pa::Exception const &e) {
+    cout << "C2PA Error: " << e.what() << '\n';
+    return 1;
+  } catch (runtime_error const &e) {
+    cout << "setup error " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -12,17 +12,15 @@
 
 #include "c2pa.h"
 #include "c2pa.hpp"
+#include "c2pa_view.hpp"
 #include "test_signer.hpp"
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <iterator>
-#include <nlohmann/json.hpp>
 #include <stdexcept>
 #include <string>
 
-// this example uses nlohmann json for parsing the manifest
-using json = nlohmann::json;
 using namespace std;
 namespace fs = std::filesystem;
 using namespace c2pa;
@@ -82,17 +80,13 @@ int main() {
     auto manifest_store_json = reader.json();
     cout << "The new manifest is " << manifest_store_json << '\n';
 
-    // get the active manifest
-    if (json manifest_store = json::parse(manifest_store_json);
-        manifest_store.contains("active_manifest")) {
-      const string active_manifest = manifest_store["active_manifest"];
-      json &manifest = manifest_store["manifests"][active_manifest];
-
-      // scan the assertions for the training-mining assertion
-      const string identifer = manifest["thumbnail"]["identifier"];
+    // get the active manifest, reading the fields in place
+    if (const auto manifest = reader.store().active_manifest();
+        manifest.valid()) {
+      const string identifier(manifest.thumbnail_identifier());
 
       // ReSharper disable once CppExpressionWithoutSideEffects
-      reader.get_resource(identifer, thumbnail_path);
+      reader.get_resource(identifier, thumbnail_path);
 
       cout << "thumbnail written to" << thumbnail_path << '\n';
     }
@@ -100,7 +94,5 @@ int main() {
     cout << "C2PA Error: " << e.what() << '\n';
   } catch (runtime_error const &e) {
     cout << "setup error" << e.what() << '\n';
-  } catch (json::parse_error const &e) {
-    cout << "parse error " << e.what() << '\n';
   }
 }
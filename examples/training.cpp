@@ -11,17 +11,15 @@
 // each license.
 
 #include "c2pa.hpp"
+#include "c2pa_view.hpp"
 #include "test_signer.hpp"
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <iterator>
-#include <nlohmann/json.hpp>
 #include <stdexcept>
 #include <string>
 
-// this example uses nlohmann json for parsing the manifest
-using json = nlohmann::json;
 using namespace std;
 namespace fs = std::filesystem;
 
@@ -161,22 +159,15 @@ int main() {
     auto new_manifest_json = reader.json();
     cout << "The new manifest is " << new_manifest_json << '\n';
 
-    // parse the manifest and display the AI training status
+    // read the AI training status from the manifest store
     bool allowed = true; // default to allowed
-    json manifest_store = json::parse(new_manifest_json);
-
-    // get the active manifest
-    const string active_manifest = manifest_store["active_manifest"];
-
-    // scan the assertions for the training-mining assertion
-    for (json &manifest = manifest_store["manifests"][active_manifest];
-         auto &assertion : manifest["assertions"]) {
-      if (assertion["label"] == "c2pa.training-mining") {
-        for (json &entry : assertion["data"]["entries"]) {
-          if (entry["use"] == "notAllowed") {
-            allowed = false;
-          }
-        }
+    const auto manifest = reader.store().active_manifest();
+
+    // the training-mining assertion has an entry for each kind of use
+    const auto assertion = manifest.assertion("c2pa.training-mining");
+    for (const auto &entry : assertion.data()["entries"]) {
+      if (entry.value["use"].text() == "notAllowed") {
+        allowed = false;
       }
     }
     cout << "AI training is " << (allowed ? "allowed" : "not allowed") << '\n';
@@ -184,7 +175,5 @@ int main() {
     cout << "C2PA Error: " << e.what() << '\n';
   } catch (runtime_error const &e) {
     cout << "setup error" << e.what() << '\n';
-  } catch (json::parse_error const &e) {
-    cout << "parse error " << e.what() << '\n';
   }
 }
@@ -21,6 +21,32 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+/**
+ * The number of buckets in a C2paHistogram.
+ */
+#define C2PA_HISTOGRAM_BUCKETS 24
+
+/**
+ * Set in C2paInitReport.steps when the settings were loaded.
+ */
+#define C2PA_INIT_SETTINGS 1
+
+/**
+ * Set in C2paInitReport.steps when the format handlers were set up.
+ * This alone does not warm crypto or validation, that needs a signer.
+ */
+#define C2PA_INIT_READER 2
+
+/**
+ * Set in C2paInitReport.steps when the signer signed the built-in image.
+ */
+#define C2PA_INIT_SIGNER 4
+
+/**
+ * Set in C2paInitReport.steps when the signed image was validated.
+ */
+#define C2PA_INIT_VALIDATION 8
+
 /**
  * An enum to define the seek mode for the seek callback
  * Start - seek from the start of the stream
@@ -48,6 +74,34 @@ typedef enum C2paSigningAlg {
 
 typedef struct C2paSigner C2paSigner;
 
+/**
+ * Signs a fragmented MP4 as its fragments are recorded.
+ */
+typedef struct C2paFragmentedSession C2paFragmentedSession;
+
+/**
+ * The body of a fetch, filled in by a fetch callback.
+ */
+typedef struct C2paFetchResponse C2paFetchResponse;
+
+/**
+ * The allocations made by one Reader or Builder operation.
+ */
+typedef struct C2paAllocStats {
+  /**
+   * The number of allocations, counting each reallocation as one.
+   */
+  uint64_t allocations;
+  /**
+   * The total number of bytes allocated.
+   */
+  uint64_t bytes_allocated;
+  /**
+   * The most bytes held at once by the operation.
+   */
+  uint64_t peak_bytes;
+} C2paAllocStats;
+
 /**
  * Defines the configuration for a Signer.
  *
@@ -126,6 +180,68 @@ typedef struct C2paBuilder {
 
 } C2paBuilder;
 
+/**
+ * Where to read one ingredient from, for c2pa_builder_add_ingredients.
+ */
+typedef struct C2paIngredientSource {
+  /**
+   * The JSON ingredient definition.
+   */
+  const char *ingredient_json;
+  /**
+   * The mime type or extension of the ingredient.
+   */
+  const char *format;
+  /**
+   * The stream to read the ingredient from.
+   */
+  struct CStream *stream;
+} C2paIngredientSource;
+
+/**
+ * What c2pa_init should initialize.
+ */
+typedef struct C2paInitOptions {
+  /**
+   * Settings to load, or NULL to keep the settings in effect.
+   */
+  const char *settings;
+  /**
+   * The format of the settings, such as "json" or "toml", or NULL for json.
+   */
+  const char *settings_format;
+  /**
+   * A signer to warm up, or NULL to skip signing and validation.
+   */
+  const struct C2paSigner *signer;
+} C2paInitOptions;
+
+/**
+ * What c2pa_init initialized, and how long each step took.
+ */
+typedef struct C2paInitReport {
+  /**
+   * The C2PA_INIT_* bits of the steps that completed.
+   */
+  uint32_t steps;
+  /**
+   * Nanoseconds spent loading the settings.
+   */
+  uint64_t settings_ns;
+  /**
+   * Nanoseconds spent setting up the format handlers.
+   */
+  uint64_t reader_ns;
+  /**
+   * Nanoseconds spent signing the built-in image.
+   */
+  uint64_t sign_ns;
+  /**
+   * Nanoseconds spent validating the signed image.
+   */
+  uint64_t validate_ns;
+} C2paInitReport;
+
 /**
  * Defines a callback to read from a stream.
  *
@@ -139,10 +255,238 @@ typedef intptr_t (*SignerCallback)(const void *context,
                                    unsigned char *signed_bytes,
                                    uintptr_t signed_len);
 
+/**
+ * The number of errors reported through c2pa_error, by kind.
+ */
+typedef struct C2paErrorCounts {
+  uint64_t assertion;
+  uint64_t assertion_not_found;
+  uint64_t decoding;
+  uint64_t encoding;
+  uint64_t file_not_found;
+  uint64_t io;
+  uint64_t json;
+  uint64_t manifest;
+  uint64_t manifest_not_found;
+  uint64_t not_supported;
+  uint64_t other;
+  uint64_t null_parameter;
+  uint64_t remote_manifest;
+  uint64_t resource_not_found;
+  uint64_t signature;
+  uint64_t verify;
+} C2paErrorCounts;
+
+/**
+ * A latency histogram with power of two microsecond buckets.
+ *
+ * Bucket 0 counts samples under 1µs and bucket n counts samples
+ * from 2^(n-1) up to 2^n µs. The last bucket also counts everything slower.
+ */
+typedef struct C2paHistogram {
+  /**
+   * The number of samples recorded.
+   */
+  uint64_t count;
+  /**
+   * The sum of all samples in microseconds.
+   */
+  uint64_t sum_us;
+  /**
+   * The slowest sample in microseconds.
+   */
+  uint64_t max_us;
+  /**
+   * The number of samples in each bucket.
+   */
+  uint64_t buckets[C2PA_HISTOGRAM_BUCKETS];
+} C2paHistogram;
+
+/**
+ * A snapshot of the process wide counters kept by this library.
+ */
+typedef struct C2paMetrics {
+  /**
+   * The number of Readers created successfully.
+   */
+  uint64_t readers_opened;
+  /**
+   * The number of manifests signed successfully.
+   */
+  uint64_t signs_completed;
+  /**
+   * The number of asset bytes read while signing.
+   */
+  uint64_t bytes_hashed;
+  /**
+   * The number of read and sign operations running right now.
+   */
+  uint64_t in_flight;
+  /**
+   * The most read and sign operations that have run at the same time.
+   */
+  uint64_t peak_in_flight;
+  /**
+   * The errors reported, by kind.
+   */
+  struct C2paErrorCounts errors;
+  /**
+   * The time taken to create a Reader.
+   */
+  struct C2paHistogram read_latency;
+  /**
+   * The time taken to sign and embed a manifest, including the signer and TSA.
+   */
+  struct C2paHistogram sign_latency;
+  /**
+   * The time spent in the signer.
+   */
+  struct C2paHistogram signer_latency;
+  /**
+   * The time spent waiting on the time stamp authority.
+   */
+  struct C2paHistogram tsa_latency;
+} C2paMetrics;
+
+/**
+ * A completed span of work reported to a trace callback.
+ *
+ * Timestamps are in nanoseconds from a process wide monotonic epoch.
+ */
+typedef struct C2paTraceSpan {
+  /**
+   * The NULL-terminated name of the phase, such as "builder.sign".
+   */
+  const char *name;
+  /**
+   * The time the phase started.
+   */
+  uint64_t start_ns;
+  /**
+   * The time the phase ended.
+   */
+  uint64_t end_ns;
+  /**
+   * The number of bytes processed by the phase, or 0 if not applicable.
+   */
+  uint64_t bytes;
+  /**
+   * A small integer identifying the thread that ran the phase.
+   */
+  uint64_t thread_id;
+} C2paTraceSpan;
+
+/**
+ * Defines a callback to receive trace spans.
+ *
+ * # Parameters
+ * * context: the context value passed to c2pa_set_trace_callback.
+ * * span: the completed span, only valid for the duration of the call.
+ */
+/**
+ * Defines a callback to fetch a remote manifest store.
+ *
+ * # Parameters
+ * * context: the context value passed to c2pa_set_fetch_callback.
+ * * url: the NULL-terminated URL of the manifest store.
+ * * response: the response to write the body to with c2pa_fetch_response_write.
+ *
+ * Returns 0 if the body was fetched, or a negative value if it was not.
+ */
+typedef int (*FetchCallback)(const void *context,
+                             const char *url,
+                             struct C2paFetchResponse *response);
+
+typedef void (*TraceCallback)(const void *context, const struct C2paTraceSpan *span);
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
 
+/**
+ * Turns per operation allocation tracking on or off.
+ *
+ * # Errors
+ * Returns -1 if this library was built without the alloc_tracking feature,
+ * otherwise returns 0.
+ * The error string can be retrieved by calling c2pa_error.
+ */
+int c2pa_alloc_tracking_enable(bool enable);
+
+/**
+ * Returns the allocations made by the last Reader or Builder operation
+ * on the calling thread.
+ *
+ * All fields are zero if tracking was off during that operation.
+ */
+struct C2paAllocStats c2pa_last_alloc_stats(void);
+
+/**
+ * Computes the hard binding hash of an asset without reading its manifest.
+ *
+ * The result is JSON shaped like a c2pa.hash.data assertion:
+ * `{"alg": "sha256", "hash": "<hex>", "exclusions": [{"start": n, "length": n}]}`.
+ * Only JPEG and PNG are supported, since other formats need c2pa's parsers
+ * to find the manifest, and BMFF formats use a BMFF hash.
+ *
+ * # Parameters
+ * * format: pointer to a C string with the mime type or extension.
+ * * stream: pointer to a CStream with the asset.
+ * * alg: pointer to a C string with "sha256", "sha384" or "sha512".
+ *
+ * # Errors
+ * Returns NULL if there were errors, otherwise returns a JSON string.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * The returned value MUST be released by calling c2pa_string_free
+ * and it is no longer valid after that call.
+ */
+char *c2pa_compute_binding_hash(const char *format, struct CStream *stream, const char *alg);
+
+/**
+ * Returns the data hash of a Reader's active manifest as binding hash JSON.
+ *
+ * # Errors
+ * Returns NULL if there were errors, including when the manifest is bound
+ * by something other than a data hash, otherwise returns a JSON string.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * The returned value MUST be released by calling c2pa_string_free
+ * and it is no longer valid after that call.
+ */
+char *c2pa_reader_binding_hash(struct C2paReader *reader_ptr);
+
+/**
+ * Checks candidate assets against a binding hash.
+ *
+ * The candidates are hashed on several threads, each with one sequential
+ * read, so every stream must be safe to read independently of the others.
+ * Each is hashed with the binding hash's exclusions, so a copy that was
+ * signed again with a manifest store of another size does not match.
+ *
+ * # Parameters
+ * * binding_json: pointer to a C string with binding hash JSON.
+ * * streams: pointer to an array of count CStream pointers.
+ * * count: the number of streams.
+ * * results: pointer to an array of count ints, each set to 1 if that
+ *   stream matches, 0 if it does not, or -1 if it could not be read.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns the number of matches.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * streams and results must point to at least count elements.
+ */
+int c2pa_verify_binding_hashes(const char *binding_json,
+                               struct CStream *const *streams,
+                               uintptr_t count,
+                               int *results);
+
 /**
  * Returns a version string for logging.
  *
@@ -164,6 +508,9 @@ char *c2pa_error(void);
 /**
  * Load Settings from a string.
  *
+ * Loading exactly the settings text that is already in effect, in the same
+ * format, is skipped. Any other text is loaded and parsed in full.
+ *
  * # Errors
  * Returns -1 if there were errors, otherwise returns 0.
  * The error string can be retrieved by calling c2pa_error.
@@ -271,6 +618,30 @@ void c2pa_string_free(char *s);
  */
 struct C2paReader *c2pa_reader_from_stream(const char *format, struct CStream *stream);
 
+/**
+ * Creates and verifies a C2paReader from a sidecar manifest and its asset stream.
+ *
+ * Parameters
+ * * format: pointer to a C string with the mime type or extension.
+ * * stream: pointer to a CStream with the asset the manifest was made for.
+ * * manifest_data: pointer to the manifest store, such as a .c2pa sidecar.
+ * * manifest_size: the size of the manifest store in bytes.
+ *
+ * # Errors
+ * Returns NULL if there were errors, otherwise returns a pointer to a ManifestStore.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * manifest_data must point to at least manifest_size bytes.
+ * The returned value MUST be released by calling c2pa_reader_free
+ * and it is no longer valid after that call.
+ */
+struct C2paReader *c2pa_reader_from_manifest_data_and_stream(const char *format,
+                                                             struct CStream *stream,
+                                                             const unsigned char *manifest_data,
+                                                             uintptr_t manifest_size);
+
 /**
  * Frees a C2paReader allocated by Rust.
  *
@@ -288,6 +659,26 @@ void c2pa_reader_free(struct C2paReader *reader_ptr);
  */
 char *c2pa_reader_json(struct C2paReader *reader_ptr);
 
+/**
+ * Returns the manifest store of a C2paReader as CBOR.
+ *
+ * The CBOR has the same structure as the JSON from c2pa_reader_json, and is
+ * smaller and quicker to produce and to parse.
+ *
+ * # Parameters
+ * * reader_ptr: pointer to a Reader.
+ * * cbor_ptr: pointer to a pointer to a c_uchar to return the CBOR.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns the size of the CBOR.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * The returned value MUST be released by calling c2pa_manifest_bytes_free
+ * and it is no longer valid after that call.
+ */
+int c2pa_reader_cbor(struct C2paReader *reader_ptr, const unsigned char **cbor_ptr);
+
 /**
  * Writes a C2paReader resource to a stream given a URI.
  *
@@ -316,6 +707,138 @@ int c2pa_reader_resource_to_stream(struct C2paReader *reader_ptr,
                                    const char *uri,
                                    struct CStream *stream);
 
+/**
+ * Returns the label of the active manifest.
+ *
+ * # Parameters
+ * * reader_ptr: pointer to a Reader.
+ *
+ * # Errors
+ * Returns NULL if there were errors, otherwise returns the label.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * The returned value MUST be released by calling c2pa_string_free
+ * and it is no longer valid after that call.
+ */
+char *c2pa_reader_active_label(struct C2paReader *reader_ptr);
+
+/**
+ * Returns the number of ingredients in a manifest.
+ *
+ * # Parameters
+ * * reader_ptr: pointer to a Reader.
+ * * manifest_label: pointer to a C string with a manifest label,
+ *   or NULL for the active manifest.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns the number of ingredients.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ */
+int c2pa_reader_ingredient_count(struct C2paReader *reader_ptr,
+                                 const char *manifest_label);
+
+/**
+ * Returns the JSON of one ingredient, without the manifest it was made from.
+ *
+ * # Parameters
+ * * reader_ptr: pointer to a Reader.
+ * * manifest_label: pointer to a C string with a manifest label,
+ *   or NULL for the active manifest.
+ * * index: the index of the ingredient in that manifest.
+ *
+ * # Errors
+ * Returns NULL if there were errors, otherwise returns a JSON string.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * The returned value MUST be released by calling c2pa_string_free
+ * and it is no longer valid after that call.
+ */
+char *c2pa_reader_ingredient_json(struct C2paReader *reader_ptr,
+                                  const char *manifest_label,
+                                  uintptr_t index);
+
+/**
+ * Returns the label of the manifest an ingredient was made from.
+ *
+ * Pass the label to the other c2pa_reader_ingredient functions to visit
+ * the ingredients of that manifest.
+ *
+ * # Parameters
+ * * reader_ptr: pointer to a Reader.
+ * * manifest_label: pointer to a C string with a manifest label,
+ *   or NULL for the active manifest.
+ * * index: the index of the ingredient in that manifest.
+ *
+ * # Errors
+ * Returns NULL if there were errors, otherwise returns the label, which is
+ * empty if the ingredient has no manifest.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * The returned value MUST be released by calling c2pa_string_free
+ * and it is no longer valid after that call.
+ */
+char *c2pa_reader_ingredient_manifest_label(struct C2paReader *reader_ptr,
+                                            const char *manifest_label,
+                                            uintptr_t index);
+
+/**
+ * Returns the validation status of an ingredient as a JSON array.
+ *
+ * The array is empty if the ingredient's manifest validated.
+ *
+ * # Parameters
+ * * reader_ptr: pointer to a Reader.
+ * * manifest_label: pointer to a C string with a manifest label,
+ *   or NULL for the active manifest.
+ * * index: the index of the ingredient in that manifest.
+ *
+ * # Errors
+ * Returns NULL if there were errors, otherwise returns a JSON string.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * The returned value MUST be released by calling c2pa_string_free
+ * and it is no longer valid after that call.
+ */
+char *c2pa_reader_ingredient_validation_status(struct C2paReader *reader_ptr,
+                                               const char *manifest_label,
+                                               uintptr_t index);
+
+/**
+ * Does the one time setup of a process up front.
+ *
+ * Loads the settings, sets up the format handlers and, given a signer,
+ * signs and validates a small built-in image. That sets up the crypto
+ * library, the thumbnail codecs and the signer, including a first request
+ * to its time stamp authority. Worker processes can call this before
+ * taking traffic, so their first request is as fast as later ones.
+ * Calling it again is cheap, and loading the same settings again is skipped.
+ *
+ * # Parameters
+ * * options: pointer to the C2paInitOptions, or NULL to only set up reading.
+ * * report: pointer to a C2paInitReport to fill in, or NULL.
+ *
+ * # Errors
+ * Returns -1 if the settings are not UTF-8 or a step failed, otherwise returns 0.
+ * The report holds the steps that completed before the failure.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * options and report must be valid pointers or NULL.
+ * The strings in options must be NULL-terminated C strings or NULL,
+ * and the signer a valid C2paSigner or NULL.
+ */
+int c2pa_init(const struct C2paInitOptions *options, struct C2paInitReport *report);
+
 /**
  * Creates a C2paBuilder from a JSON manifest definition string.
  *
@@ -338,6 +861,27 @@ int c2pa_reader_resource_to_stream(struct C2paReader *reader_ptr,
  */
 struct C2paBuilder *c2pa_builder_from_json(const char *manifest_json);
 
+/**
+ * Creates a C2paBuilder from a CBOR manifest definition.
+ *
+ * The definition has the same schema as for c2pa_builder_from_json and is
+ * checked the same way.
+ *
+ * # Parameters
+ * * manifest_cbor: pointer to the CBOR bytes.
+ * * len: the number of bytes.
+ *
+ * # Errors
+ * Returns NULL if there were errors, otherwise returns a pointer to a Builder.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * manifest_cbor must point to at least len readable bytes.
+ * The returned value MUST be released by calling c2pa_builder_free
+ * and it is no longer valid after that call.
+ */
+struct C2paBuilder *c2pa_builder_from_cbor(const unsigned char *manifest_cbor, uintptr_t len);
+
 /**
  * Create a C2paBuilder from an archive stream.
  *
@@ -435,6 +979,33 @@ int c2pa_builder_add_ingredient_from_stream(struct C2paBuilder *builder_ptr,
                                             const char *format,
                                             struct CStream *source);
 
+/**
+ * Adds several ingredients to the C2paBuilder, reading them concurrently.
+ *
+ * Each ingredient is read, hashed and thumbnailed as by
+ * c2pa_builder_add_ingredient_from_stream, on up to one thread per core,
+ * and they are added in the order given. If any ingredient fails, none
+ * are added.
+ *
+ * # Parameters
+ * * builder_ptr: pointer to a Builder.
+ * * sources: pointer to an array of count ingredient sources.
+ * * count: the number of sources.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns 0.
+ * The error string, which gives the index of the failed ingredient, can be
+ * retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * sources must point to count elements, each with its own stream, and the
+ * streams must be safe to read from different threads.
+ */
+int c2pa_builder_add_ingredients(struct C2paBuilder *builder_ptr,
+                                 const struct C2paIngredientSource *sources,
+                                 uintptr_t count);
+
 /**
  * Writes an Archive of the Builder to the destination stream.
  *
@@ -487,7 +1058,41 @@ int c2pa_builder_sign(struct C2paBuilder *builder_ptr,
                       const unsigned char **manifest_bytes_ptr);
 
 /**
- * Frees a C2PA manifest returned by c2pa_builder_sign.
+ * Creates and writes a signed manifest, with the source as its parent if it is signed.
+ *
+ * This is c2pa_builder_sign for editing an asset in place. If the source
+ * already has a manifest store and the builder has no parent ingredient,
+ * the source is added as the parent for this sign only. Finding out reads
+ * only the headers of JPEG, PNG and TIFF sources. A signed source is read
+ * twice, once for the parent ingredient and once to sign.
+ *
+ * # Parameters
+ * * builder_ptr: pointer to a Builder.
+ * * format: pointer to a C string with the mime type or extension.
+ * * source: pointer to a CStream.
+ * * dest: pointer to a writable CStream.
+ * * signer: pointer to a C2paSigner.
+ * * manifest_bytes_ptr: pointer to a pointer to a c_uchar to return manifest_bytes (optional, can be NULL).
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns the size of the c2pa data.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings
+ * If manifest_bytes_ptr is not NULL, the returned value MUST be released by calling c2pa_manifest_bytes_free
+ * and it is no longer valid after that call.
+ */
+int c2pa_builder_sign_with_parent(struct C2paBuilder *builder_ptr,
+                                  const char *format,
+                                  struct CStream *source,
+                                  struct CStream *dest,
+                                  struct C2paSigner *signer,
+                                  const unsigned char **manifest_bytes_ptr);
+
+/**
+ * Frees a C2PA manifest returned by c2pa_builder_sign, or CBOR returned by
+ * c2pa_reader_cbor.
  *
  * # Safety
  * The bytes can only be freed once and are invalid after this call.
@@ -547,6 +1152,38 @@ int c2pa_builder_sign_data_hashed_embeddable(struct C2paBuilder *builder_ptr,
                                              struct CStream *asset,
                                              const unsigned char **manifest_bytes_ptr);
 
+/**
+ * Signs a Builder as a sidecar manifest without writing the asset.
+ *
+ * The source is read once, to hash all of it, and nothing is copied.
+ * The result is the manifest store for a .c2pa sidecar file, which binds
+ * to the unmodified source with a data hash. No thumbnail is generated,
+ * add one as a resource if it is wanted.
+ *
+ * # Parameters
+ * * builder_ptr: pointer to a Builder.
+ * * format: pointer to a C string with the mime type or extension of the source.
+ * * source: pointer to a CStream.
+ * * signer: pointer to a C2paSigner.
+ * * manifest_bytes_ptr: pointer to a pointer to a c_uchar to return manifest_bytes.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns the size of the manifest_bytes.
+ * BMFF formats such as MP4 are not supported, since they need a BMFF hash;
+ * use c2pa_builder_set_no_embed and c2pa_builder_sign for those.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * The returned value MUST be released by calling c2pa_manifest_bytes_free
+ * and it is no longer valid after that call.
+ */
+int c2pa_builder_sign_sidecar(struct C2paBuilder *builder_ptr,
+                              const char *format,
+                              struct CStream *source,
+                              struct C2paSigner *signer,
+                              const unsigned char **manifest_bytes_ptr);
+
 /**
  * Convert a binary c2pa manifest into an embeddable version for the given format.
  * A raw manifest (in application/c2pa format) can be uploaded to the cloud but
@@ -686,6 +1323,265 @@ intptr_t flusher(struct StreamContext *_context);
 
 intptr_t writer(struct StreamContext *context, const uint8_t *data, intptr_t len);
 
+/**
+ * Starts signing a fragmented MP4 recording.
+ *
+ * The session takes a snapshot of the builder, so the builder may be
+ * changed or freed afterwards.
+ *
+ * # Parameters
+ * * builder_ptr: pointer to a Builder.
+ * * format: pointer to a C string with the mime type or extension.
+ * * init: pointer to a CStream with the init segment.
+ *
+ * # Errors
+ * Returns NULL if there were errors, otherwise returns a pointer to a session.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * The returned value MUST be released by calling c2pa_fragmented_session_free
+ * and it is no longer valid after that call.
+ */
+struct C2paFragmentedSession *c2pa_fragmented_session_new(struct C2paBuilder *builder_ptr,
+                                                          const char *format,
+                                                          struct CStream *init);
+
+/**
+ * Hashes the next fragment of a recording.
+ *
+ * Fragments must be added in the order they appear in the file.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns the number of fragments
+ * added so far.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * session_ptr must be a valid pointer returned by c2pa_fragmented_session_new.
+ */
+int64_t c2pa_fragmented_session_add_fragment(struct C2paFragmentedSession *session_ptr,
+                                             struct CStream *fragment);
+
+/**
+ * Writes the signed init segment for the fragments added so far.
+ *
+ * This may be called after any fragment, each call makes a complete
+ * manifest that replaces the previous one.
+ *
+ * # Parameters
+ * * session_ptr: pointer to a session.
+ * * signer: pointer to a C2paSigner.
+ * * dest: pointer to a writable CStream for the signed init segment.
+ * * manifest_bytes_ptr: pointer to a pointer to the manifest bytes.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns the size of the manifest.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * The returned manifest bytes MUST be released by calling c2pa_manifest_bytes_free
+ * and are no longer valid after that call.
+ */
+int c2pa_fragmented_session_sign(struct C2paFragmentedSession *session_ptr,
+                                 struct C2paSigner *signer,
+                                 struct CStream *dest,
+                                 const unsigned char **manifest_bytes_ptr);
+
+/**
+ * Checks the fragments of a recording against a Reader of its init segment.
+ *
+ * Reading the init segment validates its manifest, but not the fragments
+ * its fragments assertion commits to. This hashes the fragments and
+ * compares their count, total length and Merkle root with the assertion.
+ *
+ * # Parameters
+ * * reader_ptr: pointer to a Reader of the signed init segment.
+ * * fragments: pointer to an array of count CStream pointers, in order.
+ * * count: the number of fragments.
+ *
+ * # Errors
+ * Returns -1 if there were errors, including when the active manifest has
+ * no fragments assertion, otherwise returns 1 if the fragments match and 0
+ * if they do not.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * fragments must point to at least count elements.
+ */
+int c2pa_reader_verify_fragments(struct C2paReader *reader_ptr,
+                                 struct CStream *const *fragments,
+                                 uintptr_t count);
+
+/**
+ * Frees a session allocated by Rust.
+ *
+ * # Safety
+ * The session can only be freed once and is invalid after this call.
+ */
+void c2pa_fragmented_session_free(struct C2paFragmentedSession *session_ptr);
+
+/**
+ * Returns a snapshot of the process wide metrics.
+ *
+ * Counters are read one at a time, so a snapshot taken while other
+ * threads are working may be slightly inconsistent between fields.
+ */
+struct C2paMetrics c2pa_metrics_snapshot(void);
+
+/**
+ * Resets all counters and histograms to zero.
+ *
+ * The in flight count is left alone so operations running now are still
+ * subtracted when they finish. The peak is reset to the current count.
+ */
+void c2pa_metrics_reset(void);
+
+/**
+ * Registers a callback to fetch remote manifest stores.
+ *
+ * Fetched stores are written to the cache set by c2pa_set_remote_cache.
+ * Pass a NULL callback to let c2pa fetch them itself.
+ *
+ * # Parameters
+ * * context: a value passed back to the callback, often a pointer to an HTTP client.
+ * * callback: the callback to invoke for each fetch, or NULL.
+ *
+ * # Safety
+ * The context must remain valid until the callback is cleared.
+ * The callback may be called from any thread that reads an asset.
+ */
+void c2pa_set_fetch_callback(const void *context, FetchCallback callback);
+
+/**
+ * Appends bytes to the body of a fetch response.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns 0.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * response must be the pointer passed to a fetch callback, during that call.
+ * data must point to at least len readable bytes.
+ */
+int c2pa_fetch_response_write(struct C2paFetchResponse *response,
+                              const unsigned char *data,
+                              uintptr_t len);
+
+/**
+ * Sets a directory to cache remote manifest stores in.
+ *
+ * Cached stores are used before the fetch callback, so assets with
+ * remote manifests can be read again offline.
+ *
+ * # Parameters
+ * * dir: pointer to a C string with the cache directory, or NULL to turn caching off.
+ * * ttl_seconds: how long an entry is used for, or 0 to keep entries until evicted.
+ * * max_bytes: the size the cache is trimmed to after each write, or 0 for no limit.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns 0.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ */
+int c2pa_set_remote_cache(const char *dir,
+                          uint64_t ttl_seconds,
+                          uint64_t max_bytes);
+
+/**
+ * Rewrites remote manifest URLs that start with a prefix.
+ *
+ * Rewrites apply to URLs read by this library, which happens when a fetch
+ * callback or a cache is set. URLs fetched by c2pa itself are not rewritten.
+ *
+ * # Parameters
+ * * from_prefix: pointer to a C string with the prefix to replace, such as
+ *   the scheme and host of the old server.
+ * * to_prefix: pointer to a C string to replace it with, or NULL to remove
+ *   the rewrite for from_prefix.
+ *
+ * # Errors
+ * Returns -1 if there were errors, otherwise returns 0.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ */
+int c2pa_set_remote_url_rewrite(const char *from_prefix, const char *to_prefix);
+
+/**
+ * Fetches the remote manifest stores of a list of files on several threads.
+ *
+ * Each URL is rewritten and fetched through the fetch callback, and the
+ * store is written to the cache if one is set. Run it after moving
+ * manifests to a new server to warm the cache and to find the assets
+ * whose manifest did not make it.
+ *
+ * # Parameters
+ * * paths: pointer to an array of count C strings with file paths.
+ * * count: the number of paths.
+ * * threads: the number of threads to fetch with, or 0 for one per core.
+ * * results: pointer to an array of count ints, each set to 1 if the
+ *   manifest was fetched, 0 if the file has no remote manifest, or -1 if
+ *   the file could not be read, is not a JPEG, PNG or TIFF, or its
+ *   manifest could not be fetched.
+ *
+ * # Errors
+ * Returns -1 if there were errors, including when no fetch callback is set,
+ * otherwise returns the number of manifests fetched.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ * paths and results must point to at least count elements.
+ */
+int c2pa_prefetch_remote_manifests(const char *const *paths,
+                                   uintptr_t count,
+                                   unsigned int threads,
+                                   int *results);
+
+/**
+ * Registers a callback to receive a span for each phase of reading and signing.
+ *
+ * Replaces any trace callback or trace file set previously.
+ * Pass a NULL callback to turn tracing off.
+ *
+ * # Parameters
+ * * context: a value passed back to the callback, often a pointer to a collector.
+ * * callback: the callback to invoke for each completed span, or NULL.
+ *
+ * # Safety
+ * The context must remain valid until tracing is turned off.
+ * The callback may be called from any thread that calls into this library.
+ */
+void c2pa_set_trace_callback(const void *context, TraceCallback callback);
+
+/**
+ * Writes all spans to a file as Chrome trace-event JSON.
+ *
+ * Replaces any trace callback or trace file set previously.
+ * Call c2pa_trace_stop to complete the file.
+ *
+ * # Errors
+ * Returns -1 if the file could not be created, otherwise returns 0.
+ * The error string can be retrieved by calling c2pa_error.
+ *
+ * # Safety
+ * Reads from NULL-terminated C strings.
+ */
+int c2pa_set_trace_file(const char *path);
+
+/**
+ * Turns tracing off and completes any trace file in progress.
+ *
+ * # Errors
+ * Returns -1 if the trace file could not be completed, otherwise returns 0.
+ * The error string can be retrieved by calling c2pa_error.
+ */
+int c2pa_trace_stop(void);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
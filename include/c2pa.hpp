@@ -20,6 +20,7 @@
 #define C2PA_H
 
 // Suppress unused function warning for GCC/Clang
+#include <chrono>
 #include <cstdint>
 #include <exception>
 #ifdef __GNUC__
@@ -35,7 +36,11 @@
 
 #include <filesystem>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -77,6 +82,9 @@ public:
 string C2PA_EXPORT version();
 
 /// Loads C2PA settings from a string in a given format.
+/// @details Loading exactly the text that is already in effect, in the same
+/// format, is skipped, so this can be called before each read with the same
+/// settings. Any other text is loaded and parsed in full.
 /// @param format the mime format of the string.
 /// @param data the string to load.
 void C2PA_EXPORT load_settings(string format, string data);
@@ -109,6 +117,110 @@ void C2PA_EXPORT sign_file(const path &source_path, const path &dest_path,
                            const char *manifest, const SignerInfo *signer_info,
                            const std::optional<path> &data_dir = std::nullopt);
 
+/// @brief  Fetch callback function type.
+/// @param  url the URL of a remote manifest store.
+/// @return the manifest store, or nullopt if it could not be fetched.
+/// @details Exceptions thrown by the callback count as a failed fetch.
+using FetchFunc = std::optional<std::vector<unsigned char>>(const string &url);
+
+/// Sets a callback to fetch remote manifest stores when reading.
+/// @details Fetched stores go into the cache set by set_remote_cache.
+/// @param callback the function to fetch with, or nullptr to let the library
+/// fetch over HTTP itself.
+void C2PA_EXPORT set_fetch_callback(FetchFunc *callback);
+
+/// Caches remote manifest stores in a directory.
+/// @details The cache is checked before the fetch callback, so assets with
+/// remote manifests can be read again offline.
+/// @param cache_dir the directory to keep the stores in.
+/// @param ttl how long an entry is used for, 0 to keep it until evicted.
+/// @param max_bytes the size to trim the cache to, 0 for no limit.
+/// @throws a C2pa::Exception if the directory could not be created.
+void C2PA_EXPORT set_remote_cache(
+    const path &cache_dir, std::chrono::seconds ttl = std::chrono::seconds(0),
+    uint64_t max_bytes = 0);
+
+/// Turns the remote manifest cache off, leaving its files in place.
+void C2PA_EXPORT disable_remote_cache();
+
+/// Rewrites remote manifest URLs that start with a prefix.
+/// @details Use this when manifests move to a new server. Rewrites apply when
+/// a fetch callback or a cache is set.
+/// @param from_prefix the prefix to replace, such as the old scheme and host.
+/// @param to_prefix what to replace it with, or nullopt to remove the rewrite.
+void C2PA_EXPORT set_remote_url_rewrite(
+    const string &from_prefix, const std::optional<string> &to_prefix);
+
+/// Fetches the remote manifests of a list of files on several threads.
+/// @details URLs are rewritten and fetched with the fetch callback, filling
+/// the cache if one is set.
+/// @param paths the files to fetch manifests for.
+/// @param threads the number of threads to use, 0 for one per core.
+/// @return 1 for each file whose manifest was fetched, 0 for each with no
+/// remote manifest, and -1 for each that failed or is not a JPEG, PNG or
+/// TIFF, since only those are scanned for a remote manifest.
+/// @throws a C2pa::Exception if no fetch callback is set.
+std::vector<int> C2PA_EXPORT prefetch_remote_manifests(
+    const std::vector<path> &paths, unsigned threads = 0);
+
+/// @brief  Trace callback function type.
+/// @param  span the completed span, its name is valid for the life of the
+/// process.
+/// @details This function type is used to receive the timing of each phase of
+/// reading and signing.
+using TraceFunc = void(const C2paTraceSpan &);
+
+/// Sets a callback to receive a span for each phase of reading and signing.
+/// @param callback the function to call for each span, or nullptr to turn
+/// tracing off.
+void C2PA_EXPORT set_trace_callback(TraceFunc *callback);
+
+/// Writes all spans to a file as Chrome trace-event JSON.
+/// @param trace_path the path of the trace file to write.
+/// @throws a C2pa::Exception if the file could not be created.
+void C2PA_EXPORT set_trace_file(const path &trace_path);
+
+/// Turns tracing off and completes any trace file in progress.
+/// @throws a C2pa::Exception if the trace file could not be completed.
+void C2PA_EXPORT stop_trace();
+
+/// @brief Allocations made by one Reader or Builder operation.
+using AllocStats = C2paAllocStats;
+
+/// Turns per operation allocation tracking on or off.
+/// @param enable true to start counting allocations.
+/// @throws a C2pa::Exception if the library was built without the
+/// alloc_tracking feature.
+void C2PA_EXPORT enable_alloc_tracking(bool enable = true);
+
+/// Returns the allocations made by the last Reader or Builder call on this
+/// thread.
+/// @details Includes the copy this wrapper makes of the JSON or manifest
+/// bytes returned by the library.
+AllocStats C2PA_EXPORT last_alloc_stats();
+
+/// @brief Process wide counters and latency histograms.
+/// @details Mirrors C2paMetrics, all latencies are in microseconds.
+class C2PA_EXPORT Metrics : public C2paMetrics {
+public:
+  /// Takes a snapshot of the current metrics.
+  static Metrics snapshot();
+
+  /// Resets all counters and histograms to zero.
+  static void reset();
+
+  /// Estimates a percentile of a histogram.
+  /// @param histogram one of the latency histograms in a snapshot.
+  /// @param percentile the percentile to estimate, from 0 to 100.
+  /// @return the upper bound of the bucket holding the percentile, in
+  /// microseconds, or 0 if the histogram is empty.
+  static uint64_t percentile_us(const C2paHistogram &histogram,
+                                double percentile);
+
+private:
+  explicit Metrics(const C2paMetrics &metrics);
+};
+
 /// @brief Istream Class wrapper for CStream.
 /// @details This class is used to wrap an input stream for use with the C2PA
 /// library.
@@ -185,32 +297,140 @@ private:
   static intptr_t flusher(StreamContext *context);
 };
 
+/// @brief One ingredient in the provenance graph of a Reader.
+struct C2PA_EXPORT IngredientNode {
+  /// The label of the manifest this is an ingredient of, empty for the
+  /// active manifest.
+  string manifest_label;
+  /// The index of the ingredient in that manifest.
+  size_t index = 0;
+  /// 1 for ingredients of the active manifest, 2 for theirs and so on.
+  unsigned depth = 0;
+  /// The label of the manifest the ingredient was made from, empty if none.
+  string child_label;
+};
+
+/// @brief A depth first walk over the ingredients of a Reader.
+/// @details A manifest's ingredients are only looked up when the walk
+/// reaches them, so a small max_depth, skip_children or stopping early
+/// leaves the rest of the graph untouched. Use Reader::ingredient_json for
+/// the details of a node. The walk is only valid while its Reader is.
+/// A manifest is never expanded inside itself. An unlimited walk expands
+/// each manifest once, so one reached again by another path is a leaf.
+class C2PA_EXPORT IngredientWalk {
+public:
+  class C2PA_EXPORT iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = IngredientNode;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const IngredientNode *;
+    using reference = const IngredientNode &;
+
+    reference operator*() const { return walk->node; }
+    pointer operator->() const { return &walk->node; }
+    iterator &operator++();
+    bool operator==(const iterator &other) const {
+      return walk == other.walk;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    friend class IngredientWalk;
+    explicit iterator(IngredientWalk *walk_) : walk(walk_) {}
+    IngredientWalk *walk;
+  };
+
+  /// @brief Start the walk.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  iterator begin();
+  iterator end() { return iterator(nullptr); }
+
+  /// @brief Do not visit the ingredients of the current node.
+  void skip_children() { skip = true; }
+
+private:
+  friend class Reader;
+  struct Level {
+    string label;
+    size_t next;
+    size_t count;
+  };
+
+  IngredientWalk(C2paReader *reader_, unsigned max_depth_)
+      : reader(reader_), max_depth(max_depth_) {}
+  bool advance();
+  void push(const string &label);
+
+  C2paReader *reader;
+  unsigned max_depth;
+  std::vector<Level> stack;
+  IngredientNode node;
+  bool skip = false;
+  // the active manifest's label, the root of the walk
+  string active;
+  // the manifests an unlimited walk has expanded
+  std::set<string> expanded;
+};
+
+class ManifestStoreView;
+
 /// @brief Reader class for reading a manifest.
 /// @details This class is used to read and validate a manifest from a stream or
-/// file.
+/// file. The manifest store, embedded resources such as thumbnails included,
+/// is read into memory when the Reader is created. A Reader that owns its
+/// source keeps it open, but resources are not read from it on demand.
 class C2PA_EXPORT Reader {
 private:
-  C2paReader *c2pa_reader;
-  CppIStream *cpp_stream = nullptr;
+  C2paReader *c2pa_reader = nullptr;
+  // the source, when the Reader opened it or was given it
+  std::unique_ptr<std::istream> owned_stream;
+  std::unique_ptr<CppIStream> cpp_stream;
+  // the CBOR store() views, encoded once on first use
+  struct StoreCache {
+    std::once_flag once;
+    std::vector<unsigned char> cbor;
+  };
+  std::unique_ptr<StoreCache> store_cache = std::make_unique<StoreCache>();
+
+  void open(const string &format, std::istream &stream,
+            const std::vector<unsigned char> *manifest_data = nullptr);
 
 public:
   /// @brief Create a Reader from a stream.
   /// @details The validation_status field in the json contains validation
-  /// results.
+  /// results. The stream must outlive the Reader.
   /// @param format The mime format of the stream.
   /// @param stream The input stream to read from.
   /// @throws C2pa::Exception for errors encountered by the C2PA library.
   Reader(const std::string &format, std::istream &stream);
 
+  /// @brief Create a Reader that owns its source stream.
+  /// @details The stream is kept open for the life of the Reader.
+  /// @param format The mime format of the stream.
+  /// @param stream The input stream to read from.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  Reader(const std::string &format, std::unique_ptr<std::istream> stream);
+
+  /// @brief Create a Reader from a sidecar manifest and the asset it is for.
+  /// @details The stream must outlive the Reader.
+  /// @param format The mime format of the stream.
+  /// @param stream The asset the manifest was made for.
+  /// @param manifest_data The manifest store, such as from sign_sidecar.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  Reader(const std::string &format, std::istream &stream,
+         const std::vector<unsigned char> &manifest_data);
+
   /// @brief Create a Reader from a file path.
+  /// @details The file is kept open for the life of the Reader.
   /// @param source_path  the path to the file to read.
   /// @throws C2pa::Exception for errors encountered by the C2PA library.
   explicit Reader(const std::filesystem::path &source_path);
 
-  Reader(const Reader &) = default;
-  Reader(Reader &&) = default;
-  Reader &operator=(const Reader &) = default;
-  Reader &operator=(Reader &&) = default;
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+  Reader(Reader &&other) noexcept;
+  Reader &operator=(Reader &&other) noexcept;
   ~Reader();
 
   /// @brief Get the manifest as a json string.
@@ -218,7 +438,31 @@ public:
   /// @throws C2pa::Exception for errors encountered by the C2PA library.
   [[nodiscard]] string json() const;
 
+  /// @brief Get the manifest store as CBOR.
+  /// @details Has the same structure as json(), and is smaller and quicker to
+  /// produce and parse, for passing to other services.
+  /// @return The manifest store as CBOR.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  [[nodiscard]] std::vector<unsigned char> cbor() const;
+
+  /// @brief Get the manifest store as CBOR the Reader keeps.
+  /// @details Encoded on the first call, from any thread, and kept for the
+  /// life of the Reader, including after it is moved.
+  /// @return The manifest store as CBOR.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  [[nodiscard]] const std::vector<unsigned char> &kept_cbor() const;
+
+  /// @brief Get a typed view of the manifest store.
+  /// @details Reads fields in place from kept_cbor(), without a json parse.
+  /// The view and the string_views it returns are valid for the life of the
+  /// Reader, including after it is moved. Defined in c2pa_view.hpp, which
+  /// needs C++20; include it to use this.
+  /// @return A view of the manifest store.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  [[nodiscard]] ManifestStoreView store() const;
+
   /// @brief  Get a resource from the reader and write it to a file.
+  /// @details Copies the resource from the store held in memory.
   /// @param uri The uri of the resource.
   /// @param path The path to write the resource to.
   /// @return The number of bytes written.
@@ -227,13 +471,76 @@ public:
                                  const std::filesystem::path &path) const;
 
   /// @brief  Get a resource from the reader  and write it to an output stream.
+  /// @details Copies the resource from the store held in memory.
   /// @param uri The uri of the resource.
   /// @param stream The output stream to write the resource to.
   /// @return The number of bytes written.
   /// @throws C2pa::Exception for errors encountered by the C2PA library.
   int get_resource(const string &uri, std::ostream &stream) const;
+
+  /// @brief Walk the ingredients, expanding nested manifests on demand.
+  /// @param max_depth The deepest level to visit, 1 for the ingredients of
+  /// the active manifest only, 0 for no limit.
+  /// @return A walk to iterate over with a range based for loop.
+  [[nodiscard]] IngredientWalk ingredients(unsigned max_depth = 1) const;
+
+  /// @brief Get one ingredient as a json string.
+  /// @details The manifest it was made from is not included, walk to it.
+  /// @param node A node from ingredients().
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  [[nodiscard]] string ingredient_json(const IngredientNode &node) const;
+
+  /// @brief Get the validation status of one ingredient as a json array.
+  /// @param node A node from ingredients().
+  /// @return An empty array if the ingredient validated.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  [[nodiscard]] string
+  ingredient_validation_status(const IngredientNode &node) const;
+
+  /// @brief Get the hard binding hash of the active manifest.
+  /// @details Compare it with compute_binding_hash of another asset to find
+  /// copies of this one.
+  /// @return The hash as json shaped like a c2pa.hash.data assertion.
+  /// @throws C2pa::Exception if the manifest has no data hash.
+  [[nodiscard]] string binding_hash() const;
+
+  /// @brief Check the fragments of a recording signed by a FragmentedSession.
+  /// @details Reading the init segment does not check the fragments its
+  /// manifest commits to, this hashes them and compares.
+  /// @param fragments the fragments of the recording, in order.
+  /// @return true if the fragments are the ones the manifest covers.
+  /// @throws C2pa::Exception if the manifest has no fragments assertion.
+  [[nodiscard]] bool
+  verify_fragments(const std::vector<std::istream *> &fragments) const;
 };
 
+/// Computes the hard binding hash of an asset without reading its manifest.
+/// @details Each asset is hashed without its own manifest store, so equal
+/// hashes mean the same asset content, whatever manifest is embedded, and
+/// this can be used to find duplicates. Only JPEG and PNG are supported.
+/// @param format the mime type or extension of the asset.
+/// @param stream the asset to hash.
+/// @param alg the hash algorithm, sha256, sha384 or sha512.
+/// @return the hash as json shaped like a c2pa.hash.data assertion.
+/// @throws a C2pa::Exception for errors encountered by the C2PA library.
+string C2PA_EXPORT compute_binding_hash(const string &format,
+                                        std::istream &stream,
+                                        const string &alg = "sha256");
+
+/// Checks candidate assets against a binding hash on several threads.
+/// @details Candidates are hashed with the binding hash's exclusions, so a
+/// copy signed again with a manifest store of another size does not match.
+/// Compare compute_binding_hash results to find those.
+/// @param binding_json a hash from compute_binding_hash or
+/// Reader::binding_hash.
+/// @param streams the candidates, each read independently of the others.
+/// @return 1 for each candidate that matches, 0 for each that does not, and
+/// -1 for each that could not be read.
+/// @throws a C2pa::Exception if the binding hash is not valid.
+std::vector<int> C2PA_EXPORT
+verify_binding_hashes(const string &binding_json,
+                      const std::vector<std::istream *> &streams);
+
 /// @brief  Signer Callback function type.
 /// @param  data the data to sign.
 /// @return the signature as a vector of bytes.
@@ -275,6 +582,36 @@ public:
   [[nodiscard]] C2paSigner *c2pa_signer() const;
 };
 
+/// @brief What initialize() did, see C2paInitReport.
+using InitReport = C2paInitReport;
+
+/// Does the one time setup of a process up front.
+/// @details Loads the settings, sets up the format handlers and, given a
+/// signer, signs and validates a small built-in image, which sets up the
+/// crypto library, the thumbnail codecs and the signer. Call it before a
+/// worker takes traffic, so its first request is as fast as later ones.
+/// @param settings settings to load, or nullopt to keep those in effect.
+/// @param format the format of the settings.
+/// @param signer a signer to warm up, or nullptr to skip signing.
+/// @return the C2PA_INIT_* steps that completed and how long each took.
+/// @throws a C2pa::Exception for errors encountered by the C2PA library.
+InitReport C2PA_EXPORT initialize(const optional<string> &settings = nullopt,
+                                  const string &format = "json",
+                                  const Signer *signer = nullptr);
+
+/// @brief One ingredient for Builder::add_ingredients.
+struct IngredientSource {
+  /// Any fields of the ingredient you want to define.
+  string ingredient_json;
+  /// The format of the ingredient file.
+  string format;
+  /// The input stream to read the ingredient from, one per source.
+  istream *source = nullptr;
+};
+
+/// @brief Encodings of a manifest definition.
+enum class ManifestEncoding { Json, Cbor };
+
 /// @brief Builder class for creating a manifest.
 /// @details This class is used to create a manifest from a json string and add
 /// resources and ingredients to the manifest.
@@ -287,6 +624,14 @@ public:
   /// @param manifest_json  The manifest JSON string.
   /// @throws C2pa::Exception for errors encountered by the C2PA library.
   explicit Builder(const std::string &manifest_json);
+
+  /// @brief  Create a Builder from an encoded manifest definition.
+  /// @details Programs that build definitions as CBOR can pass them without
+  /// converting them to JSON. The schema and checks are the same.
+  /// @param manifest  The encoded manifest definition.
+  /// @param encoding  The encoding of manifest.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  Builder(const std::vector<uint8_t> &manifest, ManifestEncoding encoding);
   Builder(const Builder &) = delete;
   Builder(Builder &&) = delete;
   Builder &operator=(const Builder &) = delete;
@@ -330,6 +675,15 @@ public:
   void add_ingredient(const string &ingredient_json,
                       const std::filesystem::path &source_path) const;
 
+  /// @brief Add several ingredients to the builder, reading them concurrently.
+  /// @details Ingredients are read, hashed and thumbnailed on up to one
+  /// thread per core and added in the order given, so adding many takes about
+  /// as long as the slowest. If any fails, none are added.
+  /// @param sources  The ingredients, each with its own stream.
+  /// @throws C2pa::Exception if a source has no stream, or for errors
+  /// encountered by the C2PA library.
+  void add_ingredients(const std::vector<IngredientSource> &sources) const;
+
   /// @brief Sign an input stream and write the signed data to an output stream.
   /// @param format The format of the output stream.
   /// @param source The input stream to sign.
@@ -349,6 +703,22 @@ public:
   std::vector<unsigned char> sign(const path &source_path,
                                   const path &dest_path, Signer &signer) const;
 
+  /// @brief Sign a stream, making it the parent if it is already signed.
+  /// @details For editing an asset in place. The source becomes the parent
+  /// ingredient for this sign only, and only if it has a manifest store and
+  /// the builder has no parent. Unsigned JPEG, PNG and TIFF sources are read
+  /// once. Signed sources are read twice, once for the parent ingredient
+  /// and once to sign, and the parent's thumbnail is reused.
+  /// @param format The format of the output stream.
+  /// @param source The input stream to sign.
+  /// @param dest The output stream to write the signed data to.
+  /// @param signer The signer to use for signing.
+  /// @return A vector containing the signed manifest bytes.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  std::vector<unsigned char> sign_with_parent(const string &format,
+                                              istream &source, iostream &dest,
+                                              const Signer &signer) const;
+
   /// @brief Create a Builder from an archive.
   /// @param archive  The input stream to read the archive from.
   /// @throws C2pa::Exception for errors encountered by the C2PA library.
@@ -393,6 +763,29 @@ public:
                               const string &format,
                               istream *asset = nullptr) const;
 
+  /// @brief Sign a source as a sidecar manifest, without writing the asset.
+  /// @details The source is read once to hash it and nothing is copied. No
+  /// thumbnail is generated. BMFF formats such as MP4 are not supported, use
+  /// set_no_embed and sign for those.
+  /// @param format The mime type or extension of the source.
+  /// @param source The input stream to hash.
+  /// @param signer The signer to use for signing.
+  /// @return A vector containing the manifest store for a .c2pa sidecar.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  std::vector<unsigned char> sign_sidecar(const string &format,
+                                          istream &source,
+                                          const Signer &signer) const;
+
+  /// @brief Sign a file and write its manifest to a .c2pa sidecar file.
+  /// @param source_path The path to the file to sign, which is only read.
+  /// @param sidecar_path The path to write the sidecar to.
+  /// @param signer The signer to use for signing.
+  /// @return A vector containing the manifest store.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  std::vector<unsigned char> sign_sidecar(const path &source_path,
+                                          const path &sidecar_path,
+                                          const Signer &signer) const;
+
   /// @brief convert an unformatted manifest data to an embeddable format.
   /// @param format The format for embedding into.
   /// @param data An unformatted manifest data block from
@@ -402,11 +795,53 @@ public:
   format_embeddable(const string &format,
                     const std::vector<unsigned char> &data);
 
+  /// @brief  Get the C2paBuilder
+  [[nodiscard]] C2paBuilder *c2pa_builder() const;
+
 private:
   // Private constructor for Builder from an archive (todo: find a better way to
   // handle this)
   explicit Builder(istream &archive);
 };
+
+/// @brief Signs a fragmented MP4 as it is recorded.
+/// @details Each fragment is hashed once when it is added. Sign can be
+/// called after any fragment to get a signed init segment whose manifest
+/// covers every fragment so far. Readers check the fragments with
+/// Reader::verify_fragments.
+class C2PA_EXPORT FragmentedSession final {
+private:
+  C2paFragmentedSession *session;
+
+public:
+  /// @brief  Start a session.
+  /// @param builder  The builder to sign with, later changes to it are not
+  /// seen by the session.
+  /// @param format  The format of the recording, such as "video/mp4".
+  /// @param init  The input stream to read the init segment from.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  FragmentedSession(const Builder &builder, const string &format,
+                    istream &init);
+  FragmentedSession(const FragmentedSession &) = delete;
+  FragmentedSession(FragmentedSession &&) = delete;
+  FragmentedSession &operator=(const FragmentedSession &) = delete;
+  FragmentedSession &operator=(FragmentedSession &&) = delete;
+
+  ~FragmentedSession() { c2pa_fragmented_session_free(session); }
+
+  /// @brief  Hash the next fragment of the recording.
+  /// @param fragment  The input stream to read the fragment from.
+  /// @return The number of fragments added so far.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  uint64_t add_fragment(istream &fragment) const;
+
+  /// @brief  Write the signed init segment for the fragments added so far.
+  /// @param dest  The output stream to write the init segment to.
+  /// @param signer  The signer to use for signing.
+  /// @return A vector containing the signed manifest bytes.
+  /// @throws C2pa::Exception for errors encountered by the C2PA library.
+  std::vector<unsigned char> sign(iostream &dest, const Signer &signer) const;
+};
 } // namespace c2pa
 
 // Restore warnings
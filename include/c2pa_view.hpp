@@ -0,0 +1,668 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+/// @file   c2pa_view.hpp
+/// @brief  Typed views of a manifest store encoded as CBOR.
+/// @details The views read fields in place from the CBOR from Reader::cbor,
+///          without parsing the rest of the store or copying strings. They
+///          do not own the buffer, which must outlive them. Reader::store
+///          keeps one for the life of the Reader. This header needs C++20
+///          and is not included by c2pa.hpp.
+
+#ifndef C2PA_VIEW_H
+#define C2PA_VIEW_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "c2pa.hpp"
+
+namespace c2pa {
+
+struct CborEntry;
+class CborIterator;
+
+/// @brief One CBOR data item, read in place.
+/// @details Default constructed, missing and malformed items have the type
+/// Invalid, and lookups on them return Invalid items, so a chain of lookups
+/// only needs checking at the end. Tags are skipped. Strings split into
+/// chunks read as empty; the library does not write them.
+class CborValue {
+public:
+  enum class Type {
+    Invalid,
+    Unsigned,
+    Negative,
+    Bytes,
+    Text,
+    Array,
+    Map,
+    Bool,
+    Null,
+    Float
+  };
+
+  CborValue() = default;
+
+  /// @brief Read the item at the start of a buffer.
+  explicit CborValue(std::span<const uint8_t> data)
+      : CborValue(data.data(), data.data() + data.size()) {}
+
+  [[nodiscard]] Type type() const;
+  [[nodiscard]] bool valid() const { return type() != Type::Invalid; }
+  explicit operator bool() const { return valid(); }
+
+  /// @brief The text of a text string, or empty.
+  [[nodiscard]] std::string_view text() const;
+
+  /// @brief The contents of a byte string, or empty.
+  [[nodiscard]] std::span<const uint8_t> bytes() const;
+
+  /// @brief The value of an integer that fits in an int64_t.
+  [[nodiscard]] std::optional<int64_t> integer() const;
+
+  /// @brief The value of an integer or floating point number.
+  [[nodiscard]] std::optional<double> number() const;
+
+  /// @brief The value of true or false.
+  [[nodiscard]] std::optional<bool> boolean() const;
+
+  /// @brief The number of items in an array or entries in a map, or 0.
+  [[nodiscard]] size_t size() const;
+
+  /// @brief The value for a text key in a map, or an Invalid item.
+  /// @details Maps are searched in order, so this is linear in their size.
+  [[nodiscard]] CborValue operator[](std::string_view key) const;
+
+  /// @brief The item at an index in an array, or an Invalid item.
+  [[nodiscard]] CborValue operator[](size_t index) const;
+
+  /// @brief The encoded bytes of this item, including nested items.
+  [[nodiscard]] std::span<const uint8_t> encoded() const;
+
+  /// @brief Iterate over the items of an array or the entries of a map.
+  [[nodiscard]] CborIterator begin() const;
+  [[nodiscard]] CborIterator end() const;
+
+private:
+  friend class CborIterator;
+
+  // the deepest nesting read, to bound recursion on hostile input
+  static constexpr int max_depth = 64;
+
+  // the first byte of a data item and what it says
+  struct Head {
+    uint8_t major = 0;
+    uint8_t info = 0;
+    uint64_t arg = 0;
+    // the byte after the head, nullptr if the head is malformed
+    const uint8_t *next = nullptr;
+
+    [[nodiscard]] bool indefinite() const { return info == 31; }
+  };
+
+  CborValue(const uint8_t *item, const uint8_t *limit);
+
+  static Head head(const uint8_t *pos, const uint8_t *limit);
+  static const uint8_t *skip(const uint8_t *pos, const uint8_t *limit,
+                             int depth);
+  [[nodiscard]] Head own_head() const { return head(item_, limit_); }
+
+  const uint8_t *item_ = nullptr;
+  // the end of the buffer, nothing is read at or past it
+  const uint8_t *limit_ = nullptr;
+};
+
+/// @brief An item of an array, or an entry of a map with its key.
+struct CborEntry {
+  CborValue key;
+  CborValue value;
+};
+
+/// @brief Iterates over an array or map without decoding it first.
+class CborIterator {
+public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = CborEntry;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const CborEntry *;
+  using reference = const CborEntry &;
+
+  CborIterator() = default;
+
+  reference operator*() const { return entry_; }
+  pointer operator->() const { return &entry_; }
+  CborIterator &operator++() {
+    advance();
+    return *this;
+  }
+  void operator++(int) { advance(); }
+  bool operator==(const CborIterator &other) const {
+    return pos_ == other.pos_;
+  }
+
+private:
+  friend class CborValue;
+
+  CborIterator(const CborValue &collection);
+  void advance();
+
+  // the next item to read, nullptr at the end
+  const uint8_t *pos_ = nullptr;
+  const uint8_t *limit_ = nullptr;
+  uint64_t remaining_ = 0;
+  bool indefinite_ = false;
+  bool map_ = false;
+  CborEntry entry_;
+};
+
+inline CborValue::CborValue(const uint8_t *item, const uint8_t *limit)
+    : item_(item), limit_(limit) {
+  // tags only qualify the item that follows
+  for (int depth = 0; depth < max_depth; depth++) {
+    const Head tag = own_head();
+    if (tag.next == nullptr || tag.major != 6) {
+      return;
+    }
+    item_ = tag.next;
+  }
+  item_ = nullptr;
+}
+
+inline CborValue::Head CborValue::head(const uint8_t *pos,
+                                       const uint8_t *limit) {
+  Head result;
+  if (pos == nullptr || pos >= limit) {
+    return result;
+  }
+  result.major = static_cast<uint8_t>(*pos >> 5);
+  result.info = static_cast<uint8_t>(*pos & 0x1f);
+  pos++;
+  if (result.info < 24) {
+    result.arg = result.info;
+  } else if (result.info < 28) {
+    const size_t length = size_t{1} << (result.info - 24);
+    if (static_cast<size_t>(limit - pos) < length) {
+      return result;
+    }
+    for (size_t i = 0; i < length; i++) {
+      result.arg = (result.arg << 8) | pos[i];
+    }
+    pos += length;
+  } else if (result.info != 31 || result.major < 2 || result.major == 6) {
+    // reserved, or indefinite where it is not allowed
+    return result;
+  }
+  result.next = pos;
+  return result;
+}
+
+inline const uint8_t *CborValue::skip(const uint8_t *pos,
+                                      const uint8_t *limit, int depth) {
+  const Head item = head(pos, limit);
+  if (item.next == nullptr || depth > max_depth) {
+    return nullptr;
+  }
+  const auto available = static_cast<uint64_t>(limit - item.next);
+  switch (item.major) {
+  case 0:
+  case 1:
+    return item.next;
+  case 2:
+  case 3:
+    if (item.indefinite()) {
+      pos = item.next;
+      while (pos != nullptr && pos < limit && *pos != 0xff) {
+        const Head chunk = head(pos, limit);
+        if (chunk.next == nullptr || chunk.major != item.major ||
+            chunk.indefinite() ||
+            static_cast<uint64_t>(limit - chunk.next) < chunk.arg) {
+          return nullptr;
+        }
+        pos = chunk.next + chunk.arg;
+      }
+      return pos != nullptr && pos < limit ? pos + 1 : nullptr;
+    }
+    return available < item.arg ? nullptr : item.next + item.arg;
+  case 4:
+  case 5: {
+    pos = item.next;
+    if (item.indefinite()) {
+      while (pos != nullptr && pos < limit && *pos != 0xff) {
+        pos = skip(pos, limit, depth + 1);
+      }
+      return pos != nullptr && pos < limit ? pos + 1 : nullptr;
+    }
+    // every item takes at least a byte
+    if (available < item.arg) {
+      return nullptr;
+    }
+    const uint64_t items = item.major == 5 ? item.arg * 2 : item.arg;
+    for (uint64_t i = 0; i < items && pos != nullptr; i++) {
+      pos = skip(pos, limit, depth + 1);
+    }
+    return pos;
+  }
+  case 6:
+    return skip(item.next, limit, depth + 1);
+  default:
+    // a break outside an indefinite item is malformed
+    return item.indefinite() ? nullptr : item.next;
+  }
+}
+
+inline CborValue::Type CborValue::type() const {
+  const Head item = own_head();
+  if (item.next == nullptr) {
+    return Type::Invalid;
+  }
+  switch (item.major) {
+  case 0:
+    return Type::Unsigned;
+  case 1:
+    return Type::Negative;
+  case 2:
+    return Type::Bytes;
+  case 3:
+    return Type::Text;
+  case 4:
+    return Type::Array;
+  case 5:
+    return Type::Map;
+  case 7:
+    switch (item.info) {
+    case 20:
+    case 21:
+      return Type::Bool;
+    case 22:
+    case 23:
+      return Type::Null;
+    case 25:
+    case 26:
+    case 27:
+      return Type::Float;
+    default:
+      return Type::Invalid;
+    }
+  default:
+    return Type::Invalid;
+  }
+}
+
+inline std::string_view CborValue::text() const {
+  const Head item = own_head();
+  if (item.next == nullptr || item.major != 3 || item.indefinite() ||
+      static_cast<uint64_t>(limit_ - item.next) < item.arg) {
+    return {};
+  }
+  return {reinterpret_cast<const char *>(item.next),
+          static_cast<size_t>(item.arg)};
+}
+
+inline std::span<const uint8_t> CborValue::bytes() const {
+  const Head item = own_head();
+  if (item.next == nullptr || item.major != 2 || item.indefinite() ||
+      static_cast<uint64_t>(limit_ - item.next) < item.arg) {
+    return {};
+  }
+  return {item.next, static_cast<size_t>(item.arg)};
+}
+
+inline std::optional<int64_t> CborValue::integer() const {
+  const Head item = own_head();
+  constexpr auto max = static_cast<uint64_t>(
+      std::numeric_limits<int64_t>::max());
+  if (item.next == nullptr || item.major > 1 || item.arg > max) {
+    return std::nullopt;
+  }
+  const auto value = static_cast<int64_t>(item.arg);
+  return item.major == 0 ? value : -1 - value;
+}
+
+inline std::optional<double> CborValue::number() const {
+  const Head item = own_head();
+  if (item.next == nullptr) {
+    return std::nullopt;
+  }
+  if (item.major == 0) {
+    return static_cast<double>(item.arg);
+  }
+  if (item.major == 1) {
+    return -1.0 - static_cast<double>(item.arg);
+  }
+  if (item.major != 7) {
+    return std::nullopt;
+  }
+  switch (item.info) {
+  case 25: {
+    // half precision, see RFC 8949 appendix D
+    const auto half = static_cast<unsigned>(item.arg);
+    const auto exponent = static_cast<int>((half >> 10) & 0x1f);
+    const double mantissa = half & 0x3ff;
+    double value = 0;
+    if (exponent == 0) {
+      value = std::ldexp(mantissa, -24);
+    } else if (exponent != 31) {
+      value = std::ldexp(mantissa + 1024, exponent - 25);
+    } else {
+      value = mantissa == 0 ? std::numeric_limits<double>::infinity()
+                            : std::numeric_limits<double>::quiet_NaN();
+    }
+    return (half & 0x8000) != 0 ? -value : value;
+  }
+  case 26: {
+    const auto bits = static_cast<uint32_t>(item.arg);
+    float value = 0;
+    static_assert(sizeof(value) == sizeof(bits));
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+  case 27: {
+    double value = 0;
+    static_assert(sizeof(value) == sizeof(item.arg));
+    std::memcpy(&value, &item.arg, sizeof(value));
+    return value;
+  }
+  default:
+    return std::nullopt;
+  }
+}
+
+inline std::optional<bool> CborValue::boolean() const {
+  const Head item = own_head();
+  if (item.next == nullptr || item.major != 7 ||
+      (item.info != 20 && item.info != 21)) {
+    return std::nullopt;
+  }
+  return item.info == 21;
+}
+
+inline size_t CborValue::size() const {
+  const Head item = own_head();
+  if (item.next == nullptr || (item.major != 4 && item.major != 5)) {
+    return 0;
+  }
+  if (!item.indefinite()) {
+    return static_cast<size_t>(item.arg);
+  }
+  return static_cast<size_t>(std::distance(begin(), end()));
+}
+
+inline CborValue CborValue::operator[](std::string_view key) const {
+  if (type() != Type::Map) {
+    return {};
+  }
+  for (const auto &entry : *this) {
+    if (entry.key.type() == Type::Text && entry.key.text() == key) {
+      return entry.value;
+    }
+  }
+  return {};
+}
+
+inline CborValue CborValue::operator[](size_t index) const {
+  if (type() != Type::Array) {
+    return {};
+  }
+  for (const auto &entry : *this) {
+    if (index-- == 0) {
+      return entry.value;
+    }
+  }
+  return {};
+}
+
+inline std::span<const uint8_t> CborValue::encoded() const {
+  const uint8_t *end = skip(item_, limit_, 0);
+  if (end == nullptr) {
+    return {};
+  }
+  return {item_, static_cast<size_t>(end - item_)};
+}
+
+inline CborIterator CborValue::begin() const { return CborIterator(*this); }
+
+inline CborIterator CborValue::end() const { return {}; }
+
+inline CborIterator::CborIterator(const CborValue &collection)
+    : limit_(collection.limit_) {
+  const auto item = collection.own_head();
+  if (item.next == nullptr || (item.major != 4 && item.major != 5)) {
+    return;
+  }
+  pos_ = item.next;
+  remaining_ = item.arg;
+  indefinite_ = item.indefinite();
+  map_ = item.major == 5;
+  advance();
+}
+
+inline void CborIterator::advance() {
+  if (pos_ == nullptr || pos_ >= limit_ ||
+      (indefinite_ ? *pos_ == 0xff : remaining_ == 0)) {
+    pos_ = nullptr;
+    return;
+  }
+  remaining_--;
+  const uint8_t *value = pos_;
+  entry_.key = CborValue();
+  if (map_) {
+    entry_.key = CborValue(pos_, limit_);
+    value = CborValue::skip(pos_, limit_, 0);
+  }
+  entry_.value = CborValue(value, limit_);
+  pos_ = CborValue::skip(value, limit_, 0);
+  if (pos_ == nullptr) {
+    // a malformed item ends the iteration without being returned
+    entry_ = CborEntry();
+  }
+}
+
+/// @brief The entries of an array or map, as views of type View.
+template <typename View> class ViewRange {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = View;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = View;
+
+    iterator() = default;
+    explicit iterator(CborIterator position) : position_(position) {}
+
+    View operator*() const { return View(*position_); }
+    iterator &operator++() {
+      ++position_;
+      return *this;
+    }
+    void operator++(int) { ++position_; }
+    bool operator==(const iterator &other) const {
+      return position_ == other.position_;
+    }
+
+  private:
+    CborIterator position_;
+  };
+
+  ViewRange() = default;
+  explicit ViewRange(CborValue collection) : collection_(collection) {}
+
+  [[nodiscard]] iterator begin() const {
+    return iterator(collection_.begin());
+  }
+  [[nodiscard]] iterator end() const { return iterator(collection_.end()); }
+  [[nodiscard]] size_t size() const { return collection_.size(); }
+  [[nodiscard]] bool empty() const { return begin() == end(); }
+
+private:
+  CborValue collection_;
+};
+
+/// @brief An assertion in a manifest.
+class AssertionView {
+public:
+  AssertionView() = default;
+  explicit AssertionView(const CborEntry &entry) : value_(entry.value) {}
+
+  [[nodiscard]] bool valid() const { return value_.valid(); }
+  [[nodiscard]] std::string_view label() const {
+    return value_["label"].text();
+  }
+  /// @brief The assertion data, its shape depends on the label.
+  [[nodiscard]] CborValue data() const { return value_["data"]; }
+  [[nodiscard]] const CborValue &value() const { return value_; }
+
+private:
+  CborValue value_;
+};
+
+/// @brief An ingredient of a manifest.
+class IngredientView {
+public:
+  IngredientView() = default;
+  explicit IngredientView(const CborEntry &entry) : value_(entry.value) {}
+
+  [[nodiscard]] bool valid() const { return value_.valid(); }
+  [[nodiscard]] std::string_view title() const {
+    return value_["title"].text();
+  }
+  [[nodiscard]] std::string_view format() const {
+    return value_["format"].text();
+  }
+  [[nodiscard]] std::string_view instance_id() const {
+    return value_["instance_id"].text();
+  }
+  /// @brief parentOf, componentOf or inputTo.
+  [[nodiscard]] std::string_view relationship() const {
+    return value_["relationship"].text();
+  }
+  /// @brief The label of the manifest the ingredient was made from, if any.
+  [[nodiscard]] std::string_view active_manifest() const {
+    return value_["active_manifest"].text();
+  }
+  [[nodiscard]] std::string_view thumbnail_identifier() const {
+    return value_["thumbnail"]["identifier"].text();
+  }
+  /// @brief The ingredient's validation status codes, an array of maps.
+  [[nodiscard]] CborValue validation_status() const {
+    return value_["validation_status"];
+  }
+  [[nodiscard]] const CborValue &value() const { return value_; }
+
+private:
+  CborValue value_;
+};
+
+/// @brief A manifest in a manifest store.
+class ManifestView {
+public:
+  ManifestView() = default;
+  explicit ManifestView(const CborEntry &entry)
+      : label_(entry.key.text()), value_(entry.value) {}
+
+  [[nodiscard]] bool valid() const { return value_.valid(); }
+  [[nodiscard]] std::string_view label() const { return label_; }
+  [[nodiscard]] std::string_view title() const {
+    return value_["title"].text();
+  }
+  [[nodiscard]] std::string_view format() const {
+    return value_["format"].text();
+  }
+  [[nodiscard]] std::string_view instance_id() const {
+    return value_["instance_id"].text();
+  }
+  [[nodiscard]] std::string_view claim_generator() const {
+    return value_["claim_generator"].text();
+  }
+  [[nodiscard]] std::string_view thumbnail_identifier() const {
+    return value_["thumbnail"]["identifier"].text();
+  }
+  [[nodiscard]] ViewRange<AssertionView> assertions() const {
+    return ViewRange<AssertionView>(value_["assertions"]);
+  }
+  /// @brief The first assertion with a label, or an invalid view.
+  [[nodiscard]] AssertionView assertion(std::string_view label) const {
+    for (auto assertion : assertions()) {
+      if (assertion.label() == label) {
+        return assertion;
+      }
+    }
+    return {};
+  }
+  [[nodiscard]] ViewRange<IngredientView> ingredients() const {
+    return ViewRange<IngredientView>(value_["ingredients"]);
+  }
+  /// @brief The issuer, time and algorithm of the signature.
+  [[nodiscard]] CborValue signature_info() const {
+    return value_["signature_info"];
+  }
+  [[nodiscard]] const CborValue &value() const { return value_; }
+
+private:
+  std::string_view label_;
+  CborValue value_;
+};
+
+/// @brief A manifest store, as returned by Reader::store.
+class ManifestStoreView {
+public:
+  ManifestStoreView() = default;
+  explicit ManifestStoreView(std::span<const uint8_t> cbor) : root_(cbor) {}
+
+  [[nodiscard]] bool valid() const {
+    return root_.type() == CborValue::Type::Map;
+  }
+  [[nodiscard]] std::string_view active_label() const {
+    return root_["active_manifest"].text();
+  }
+  /// @brief The active manifest, or an invalid view if there is none.
+  [[nodiscard]] ManifestView active_manifest() const {
+    return manifest(active_label());
+  }
+  /// @brief The manifest with a label, or an invalid view.
+  [[nodiscard]] ManifestView manifest(std::string_view label) const {
+    for (const auto &entry : root_["manifests"]) {
+      if (entry.key.text() == label) {
+        return ManifestView(entry);
+      }
+    }
+    return {};
+  }
+  [[nodiscard]] ViewRange<ManifestView> manifests() const {
+    return ViewRange<ManifestView>(root_["manifests"]);
+  }
+  /// @brief The validation status codes of the store, an array of maps.
+  [[nodiscard]] CborValue validation_status() const {
+    return root_["validation_status"];
+  }
+  [[nodiscard]] const CborValue &value() const { return root_; }
+
+private:
+  CborValue root_;
+};
+
+inline ManifestStoreView Reader::store() const {
+  return ManifestStoreView(kept_cbor());
+}
+
+} // namespace c2pa
+
+#endif // C2PA_VIEW_H
@@ -0,0 +1,226 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Per operation allocation accounting.
+//!
+//! Built with the `alloc_tracking` feature, this library installs a global
+//! allocator that counts the allocations made on the calling thread while
+//! a Reader or Builder operation runs. Counting is off until
+//! c2pa_alloc_tracking_enable is called, and without the feature every
+//! operation reports zeros.
+
+use std::{
+    cell::Cell,
+    os::raw::c_int,
+    sync::atomic::{AtomicBool, Ordering},
+};
+
+use crate::Error;
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+/// The allocations made by one Reader or Builder operation.
+pub struct C2paAllocStats {
+    /// The number of allocations, counting each reallocation as one.
+    pub allocations: u64,
+    /// The total number of bytes allocated.
+    pub bytes_allocated: u64,
+    /// The most bytes held at once by the operation.
+    pub peak_bytes: u64,
+}
+
+#[derive(Clone, Copy)]
+#[cfg_attr(not(feature = "alloc_tracking"), allow(dead_code))]
+struct ThreadStats {
+    active: bool,
+    allocations: u64,
+    bytes_allocated: u64,
+    // may go negative if the operation frees memory it did not allocate
+    current: i64,
+    peak: i64,
+}
+
+const IDLE: ThreadStats = ThreadStats {
+    active: false,
+    allocations: 0,
+    bytes_allocated: 0,
+    current: 0,
+    peak: 0,
+};
+
+static TRACKING: AtomicBool = AtomicBool::new(false);
+
+// These must stay const initialized with no destructor so the allocator can use them.
+thread_local! {
+    static CURRENT: Cell<ThreadStats> = const { Cell::new(IDLE) };
+    static LAST: Cell<C2paAllocStats> = const {
+        Cell::new(C2paAllocStats { allocations: 0, bytes_allocated: 0, peak_bytes: 0 })
+    };
+}
+
+#[cfg(feature = "alloc_tracking")]
+mod counting {
+    use std::alloc::{GlobalAlloc, Layout, System};
+
+    use super::{CURRENT, TRACKING};
+
+    struct CountingAllocator;
+
+    #[global_allocator]
+    static GLOBAL: CountingAllocator = CountingAllocator;
+
+    fn record(allocated: usize, freed: usize) {
+        if !TRACKING.load(std::sync::atomic::Ordering::Relaxed) {
+            return;
+        }
+        // try_with avoids a panic if a thread allocates while it is being torn down
+        let _ = CURRENT.try_with(|cell| {
+            let mut stats = cell.get();
+            if stats.active {
+                if allocated > 0 {
+                    stats.allocations += 1;
+                    stats.bytes_allocated += allocated as u64;
+                }
+                stats.current += allocated as i64 - freed as i64;
+                stats.peak = stats.peak.max(stats.current);
+                cell.set(stats);
+            }
+        });
+    }
+
+    unsafe impl GlobalAlloc for CountingAllocator {
+        unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+            let ptr = System.alloc(layout);
+            if !ptr.is_null() {
+                record(layout.size(), 0);
+            }
+            ptr
+        }
+
+        unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+            let ptr = System.alloc_zeroed(layout);
+            if !ptr.is_null() {
+                record(layout.size(), 0);
+            }
+            ptr
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+            System.dealloc(ptr, layout);
+            record(0, layout.size());
+        }
+
+        unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+            let new_ptr = System.realloc(ptr, layout, new_size);
+            if !new_ptr.is_null() {
+                record(new_size, layout.size());
+            }
+            new_ptr
+        }
+    }
+}
+
+/// Accounts for the allocations made on this thread until it is dropped.
+///
+/// Scopes do not nest, an inner scope leaves the outer one counting.
+pub(crate) struct Scope {
+    owner: bool,
+}
+
+impl Scope {
+    pub fn new() -> Self {
+        if !TRACKING.load(Ordering::Relaxed) {
+            LAST.with(|last| last.set(C2paAllocStats::default()));
+            return Self { owner: false };
+        }
+        let owner = CURRENT.with(|cell| {
+            if cell.get().active {
+                return false;
+            }
+            cell.set(ThreadStats {
+                active: true,
+                ..IDLE
+            });
+            true
+        });
+        Self { owner }
+    }
+}
+
+impl Drop for Scope {
+    fn drop(&mut self) {
+        if !self.owner {
+            return;
+        }
+        let stats = CURRENT.with(|cell| cell.replace(IDLE));
+        LAST.with(|last| {
+            last.set(C2paAllocStats {
+                allocations: stats.allocations,
+                bytes_allocated: stats.bytes_allocated,
+                peak_bytes: stats.peak.max(0) as u64,
+            })
+        });
+    }
+}
+
+/// Turns per operation allocation tracking on or off.
+///
+/// # Errors
+/// Returns -1 if this library was built without the alloc_tracking feature,
+/// otherwise returns 0.
+/// The error string can be retrieved by calling c2pa_error.
+#[no_mangle]
+pub extern "C" fn c2pa_alloc_tracking_enable(enable: bool) -> c_int {
+    if cfg!(not(feature = "alloc_tracking")) {
+        Error::NotSupported("built without the alloc_tracking feature".to_string()).set_last();
+        return -1;
+    }
+    TRACKING.store(enable, Ordering::Relaxed);
+    0
+}
+
+/// Returns the allocations made by the last Reader or Builder operation
+/// on the calling thread.
+///
+/// All fields are zero if tracking was off during that operation.
+#[no_mangle]
+pub extern "C" fn c2pa_last_alloc_stats() -> C2paAllocStats {
+    LAST.with(|last| last.get())
+}
+
+#[cfg(all(test, feature = "alloc_tracking"))]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_scope_counts_allocations() {
+        assert_eq!(c2pa_alloc_tracking_enable(true), 0);
+        {
+            let _scope = Scope::new();
+            let first = vec![0u8; 1000];
+            {
+                // a nested scope keeps counting into the outer one
+                let _inner = Scope::new();
+                let second = vec![0u8; 3000];
+                drop(second);
+            }
+            drop(first);
+            let third = vec![0u8; 500];
+            drop(third);
+        }
+        let stats = c2pa_last_alloc_stats();
+        assert_eq!(stats.allocations, 3);
+        assert_eq!(stats.bytes_allocated, 4500);
+        assert_eq!(stats.peak_bytes, 4000);
+    }
+}
@@ -0,0 +1,474 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Hard binding fingerprints without building or validating a manifest.
+//!
+//! A data hash binds a manifest to its asset by hashing every byte except
+//! the manifest itself. The same digest identifies the asset content across
+//! re-signing, so it works as a deduplication key. The manifest region comes
+//! from the JPEG and PNG header scans, then the rest of the asset is hashed
+//! in one sequential read that seeks over the excluded ranges.
+//!
+//! Verifying candidates against a binding hash reuses its exclusions, as
+//! c2pa does, so it only finds copies whose manifest store has the same
+//! place and size. To match copies that were signed again, compare hashes
+//! computed for each asset instead.
+
+use std::{
+    io::{self, Read, Seek, SeekFrom},
+    os::raw::{c_char, c_int},
+    sync::atomic::{AtomicUsize, Ordering},
+    thread,
+};
+
+use c2pa::{assertions::DataHash, Reader as C2paReader};
+use serde::{Deserialize, Serialize};
+use sha2::{digest::DynDigest, Sha256, Sha384, Sha512};
+
+use crate::{
+    alloc_stats,
+    c_api::to_c_string,
+    c_stream::CStream,
+    from_cstr_null_check, from_cstr_null_check_int, jpeg, merkle, null_check, null_check_int, png,
+    trace::{names, Span},
+    Error, Result,
+};
+
+const DATA_HASH_LABEL: &str = "c2pa.hash.data";
+const READ_BUFFER_SIZE: usize = 256 * 1024;
+
+/// A range of bytes left out of the hash.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub(crate) struct Exclusion {
+    pub start: u64,
+    pub length: u64,
+}
+
+/// A data hash, shaped like the c2pa.hash.data assertion, with a hex digest.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub(crate) struct BindingHash {
+    pub alg: String,
+    pub hash: String,
+    #[serde(default)]
+    pub exclusions: Vec<Exclusion>,
+}
+
+fn hasher(alg: &str) -> Result<Box<dyn DynDigest>> {
+    match alg {
+        "sha256" => Ok(Box::<Sha256>::default()),
+        "sha384" => Ok(Box::<Sha384>::default()),
+        "sha512" => Ok(Box::<Sha512>::default()),
+        _ => Err(Error::NotSupported(format!("hash algorithm {alg}"))),
+    }
+}
+
+fn io_error(e: io::Error) -> Error {
+    Error::Io(e.to_string())
+}
+
+/// Returns the ranges c2pa leaves out of the data hash for an asset.
+///
+/// An asset without an embedded manifest has none, as for a sidecar.
+pub(crate) fn exclusions<R: Read + Seek>(format: &str, stream: &mut R) -> Result<Vec<Exclusion>> {
+    let exclusions = if jpeg::is_jpeg(format) {
+        jpeg::scan(stream)
+            .map_err(io_error)?
+            .map(|layout| {
+                layout
+                    .store_ranges
+                    .iter()
+                    .map(|range| Exclusion {
+                        start: range.start,
+                        length: range.end - range.start,
+                    })
+                    .collect()
+            })
+            .unwrap_or_default()
+    } else if png::is_png(format) {
+        png::scan(stream)
+            .map_err(io_error)?
+            .map(|layout| {
+                layout
+                    .stores
+                    .iter()
+                    .map(|(chunk, _)| Exclusion {
+                        start: chunk.offset,
+                        length: chunk.size(),
+                    })
+                    .collect()
+            })
+            .unwrap_or_default()
+    } else {
+        // BMFF is bound by a BMFF hash, and other formats need c2pa's parsers
+        return Err(Error::NotSupported(format!(
+            "binding hashes for {format}{}",
+            if merkle::is_bmff(format) {
+                ", which uses a BMFF hash"
+            } else {
+                ""
+            }
+        )));
+    };
+    Ok(exclusions)
+}
+
+// Returns where an exclusion ends, which a bad binding hash can overflow.
+fn exclusion_end(exclusion: &Exclusion) -> Result<u64> {
+    exclusion
+        .start
+        .checked_add(exclusion.length)
+        .ok_or_else(|| {
+            Error::Json(format!(
+                "exclusion at {} of length {} is out of range",
+                exclusion.start, exclusion.length
+            ))
+        })
+}
+
+/// Hashes a stream in one pass, seeking over the exclusions.
+///
+/// Returns the digest and the number of bytes hashed.
+pub(crate) fn hash_excluding<R: Read + Seek>(
+    stream: &mut R,
+    alg: &str,
+    exclusions: &[Exclusion],
+) -> Result<(Vec<u8>, u64)> {
+    let mut hasher = hasher(alg)?;
+    let mut exclusions = exclusions.to_vec();
+    exclusions.sort_by_key(|e| e.start);
+    let mut buffer = vec![0u8; READ_BUFFER_SIZE];
+    let mut pos = stream.seek(SeekFrom::Start(0)).map_err(io_error)?;
+    let mut hashed = 0;
+    let mut next = exclusions.iter().peekable();
+    loop {
+        if let Some(exclusion) = next.peek() {
+            if pos >= exclusion.start {
+                let end = exclusion_end(exclusion)?;
+                if end > pos {
+                    pos = stream.seek(SeekFrom::Start(end)).map_err(io_error)?;
+                }
+                next.next();
+                continue;
+            }
+        }
+        // read no further than the next exclusion
+        let want = next.peek().map_or(buffer.len() as u64, |e| {
+            (e.start - pos).min(buffer.len() as u64)
+        });
+        let len = match stream.read(&mut buffer[..want as usize]) {
+            Ok(0) => break,
+            Ok(len) => len,
+            Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+            Err(e) => return Err(io_error(e)),
+        };
+        hasher.update(&buffer[..len]);
+        pos += len as u64;
+        hashed += len as u64;
+    }
+    Ok((hasher.finalize().into_vec(), hashed))
+}
+
+/// Computes the binding hash of an asset.
+pub(crate) fn compute<R: Read + Seek>(
+    format: &str,
+    stream: &mut R,
+    alg: &str,
+) -> Result<BindingHash> {
+    let exclusions = exclusions(format, stream)?;
+    let (hash, _) = hash_excluding(stream, alg, &exclusions)?;
+    Ok(BindingHash {
+        alg: alg.to_string(),
+        hash: merkle::hex(&hash),
+        exclusions,
+    })
+}
+
+/// Returns the data hash of the active manifest as a binding hash.
+///
+/// Assets bound by a BMFF or box hash have no data hash.
+pub(crate) fn from_reader(reader: &C2paReader) -> Result<BindingHash> {
+    let manifest = reader
+        .active_manifest()
+        .ok_or_else(|| Error::ManifestNotFound("active".to_string()))?;
+    let data_hash: DataHash = manifest
+        .find_assertion(DATA_HASH_LABEL)
+        .map_err(|_| Error::AssertionNotFound(DATA_HASH_LABEL.to_string()))?;
+    Ok(BindingHash {
+        // the assertion inherits the claim's algorithm when it names none
+        alg: data_hash
+            .alg
+            .clone()
+            .unwrap_or_else(|| "sha256".to_string()),
+        hash: merkle::hex(&data_hash.hash),
+        exclusions: data_hash
+            .exclusions
+            .iter()
+            .flatten()
+            .map(|range| Exclusion {
+                start: range.start() as u64,
+                length: range.length() as u64,
+            })
+            .collect(),
+    })
+}
+
+/// Returns true if a candidate asset hashes to the binding hash.
+pub(crate) fn verify<R: Read + Seek>(binding: &BindingHash, stream: &mut R) -> Result<bool> {
+    let (hash, _) = hash_excluding(stream, &binding.alg, &binding.exclusions)?;
+    Ok(merkle::hex(&hash).eq_ignore_ascii_case(&binding.hash))
+}
+
+/// Computes the hard binding hash of an asset without reading its manifest.
+///
+/// The result is JSON shaped like a c2pa.hash.data assertion:
+/// `{"alg": "sha256", "hash": "<hex>", "exclusions": [{"start": n, "length": n}]}`.
+/// Only JPEG and PNG are supported, since other formats need c2pa's parsers
+/// to find the manifest, and BMFF formats use a BMFF hash.
+///
+/// # Parameters
+/// * format: pointer to a C string with the mime type or extension.
+/// * stream: pointer to a CStream with the asset.
+/// * alg: pointer to a C string with "sha256", "sha384" or "sha512".
+///
+/// # Errors
+/// Returns NULL if there were errors, otherwise returns a JSON string.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// The returned value MUST be released by calling c2pa_string_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_compute_binding_hash(
+    format: *const c_char,
+    stream: *mut CStream,
+    alg: *const c_char,
+) -> *mut c_char {
+    null_check!(stream);
+    let format = from_cstr_null_check!(format);
+    let alg = from_cstr_null_check!(alg);
+
+    let _alloc = alloc_stats::Scope::new();
+    let _span = Span::new(names::BINDING_HASH);
+    let result = compute(&format, &mut *stream, &alg).and_then(|binding| {
+        serde_json::to_string(&binding).map_err(|e| Error::Json(e.to_string()))
+    });
+    match result {
+        Ok(json) => to_c_string(json),
+        Err(err) => {
+            err.set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Returns the data hash of a Reader's active manifest as binding hash JSON.
+///
+/// # Errors
+/// Returns NULL if there were errors, including when the manifest is bound
+/// by something other than a data hash, otherwise returns a JSON string.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// The returned value MUST be released by calling c2pa_string_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_binding_hash(reader_ptr: *mut C2paReader) -> *mut c_char {
+    null_check!(reader_ptr);
+    let result = from_reader(&*reader_ptr).and_then(|binding| {
+        serde_json::to_string(&binding).map_err(|e| Error::Json(e.to_string()))
+    });
+    match result {
+        Ok(json) => to_c_string(json),
+        Err(err) => {
+            err.set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Checks candidate assets against a binding hash.
+///
+/// The candidates are hashed on several threads, each with one sequential
+/// read, so every stream must be safe to read independently of the others.
+/// Each is hashed with the binding hash's exclusions, so a copy that was
+/// signed again with a manifest store of another size does not match.
+///
+/// # Parameters
+/// * binding_json: pointer to a C string with binding hash JSON.
+/// * streams: pointer to an array of count CStream pointers.
+/// * count: the number of streams.
+/// * results: pointer to an array of count ints, each set to 1 if that
+///   stream matches, 0 if it does not, or -1 if it could not be read.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns the number of matches.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// streams and results must point to at least count elements.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_verify_binding_hashes(
+    binding_json: *const c_char,
+    streams: *const *mut CStream,
+    count: usize,
+    results: *mut c_int,
+) -> c_int {
+    let binding_json = from_cstr_null_check_int!(binding_json);
+    if count > 0 {
+        null_check_int!(streams);
+        null_check_int!(results);
+    }
+    let binding: BindingHash = match serde_json::from_str(&binding_json) {
+        Ok(binding) => binding,
+        Err(e) => {
+            Error::Json(e.to_string()).set_last();
+            return -1;
+        }
+    };
+    let checked = hasher(&binding.alg).and_then(|_| {
+        binding
+            .exclusions
+            .iter()
+            .try_for_each(|e| exclusion_end(e).map(drop))
+    });
+    if let Err(err) = checked {
+        err.set_last();
+        return -1;
+    }
+    if count == 0 {
+        return 0;
+    }
+
+    let _span = Span::new(names::BINDING_VERIFY);
+    // pointers are not Send, the addresses are
+    let streams: Vec<usize> = std::slice::from_raw_parts(streams, count)
+        .iter()
+        .map(|s| *s as usize)
+        .collect();
+    let outcomes: Vec<AtomicUsize> = (0..count).map(|_| AtomicUsize::new(0)).collect();
+    let next = AtomicUsize::new(0);
+    let threads = thread::available_parallelism()
+        .map(|n| n.get())
+        .unwrap_or(1)
+        .min(count);
+    thread::scope(|scope| {
+        for _ in 0..threads {
+            scope.spawn(|| loop {
+                let index = next.fetch_add(1, Ordering::Relaxed);
+                if index >= count {
+                    break;
+                }
+                let stream = streams[index] as *mut CStream;
+                let outcome = if stream.is_null() {
+                    0
+                } else {
+                    // SAFETY: the caller passes count valid, independent streams
+                    match verify(&binding, unsafe { &mut *stream }) {
+                        Ok(true) => 2,
+                        Ok(false) => 1,
+                        Err(_) => 0,
+                    }
+                };
+                outcomes[index].store(outcome, Ordering::Relaxed);
+            });
+        }
+    });
+
+    let results = std::slice::from_raw_parts_mut(results, count);
+    let mut matches = 0;
+    for (result, outcome) in results.iter_mut().zip(&outcomes) {
+        *result = outcome.load(Ordering::Relaxed) as c_int - 1;
+        if *result == 1 {
+            matches += 1;
+        }
+    }
+    matches
+}
+
+#[cfg(test)]
+mod tests {
+    use std::{ffi::CString, io::Cursor};
+
+    use sha2::Digest;
+
+    use super::*;
+
+    #[test]
+    fn test_hash_excluding_skips_ranges() {
+        let data: Vec<u8> = (0..1_000_000u32).map(|i| (i % 251) as u8).collect();
+        let exclusions = vec![
+            Exclusion {
+                start: 900_000,
+                length: 50_000,
+            },
+            Exclusion {
+                start: 10,
+                length: 300_000,
+            },
+        ];
+        let (hash, hashed) =
+            hash_excluding(&mut Cursor::new(&data), "sha256", &exclusions).unwrap();
+        let kept = [&data[..10], &data[300_010..900_000], &data[950_000..]].concat();
+        assert_eq!(hash, Sha256::digest(&kept).to_vec());
+        assert_eq!(hashed, 1_000_000 - 350_000);
+    }
+
+    #[test]
+    fn test_hash_excluding_rejects_overflow() {
+        let exclusions = vec![Exclusion {
+            start: 4,
+            length: u64::MAX,
+        }];
+        assert!(matches!(
+            hash_excluding(&mut Cursor::new(&[0u8; 16]), "sha256", &exclusions),
+            Err(Error::Json(_))
+        ));
+        let json = CString::new(
+            r#"{"alg": "sha256", "hash": "00", "exclusions": [{"start": 4, "length": 18446744073709551615}]}"#,
+        )
+        .unwrap();
+        let stream: *mut CStream = std::ptr::null_mut();
+        let mut result = 0;
+        assert_eq!(
+            unsafe { c2pa_verify_binding_hashes(json.as_ptr(), &stream, 1, &mut result) },
+            -1
+        );
+    }
+
+    #[test]
+    fn test_compute_and_verify_fixtures() {
+        let signed =
+            std::fs::read(concat!(env!("CARGO_MANIFEST_DIR"), "/tests/fixtures/C.jpg")).unwrap();
+        let binding = compute("image/jpeg", &mut Cursor::new(&signed), "sha256").unwrap();
+        assert_eq!(binding.exclusions.len(), 1);
+        assert!(verify(&binding, &mut Cursor::new(&signed)).unwrap());
+
+        let unsigned =
+            std::fs::read(concat!(env!("CARGO_MANIFEST_DIR"), "/tests/fixtures/A.jpg")).unwrap();
+        let binding = compute("jpg", &mut Cursor::new(&unsigned), "sha512").unwrap();
+        assert!(binding.exclusions.is_empty());
+        assert_eq!(binding.hash, merkle::hex(&Sha512::digest(&unsigned)));
+        assert!(!verify(&binding, &mut Cursor::new(&signed)).unwrap());
+
+        assert!(matches!(
+            compute("mp4", &mut Cursor::new(&unsigned), "sha256"),
+            Err(Error::NotSupported(_))
+        ));
+        assert!(matches!(
+            compute("jpg", &mut Cursor::new(&unsigned), "md5"),
+            Err(Error::NotSupported(_))
+        ));
+    }
+}
@@ -16,6 +16,7 @@
 ///          This is an early version, and has not been fully tested.
 ///          Thread safety is not guaranteed due to the use of errno and etc.
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
@@ -63,6 +64,36 @@ intptr_t signer_passthrough(const void *context, const unsigned char *data,
     return -1;
   }
 }
+
+// The size of the result the wrapper copied out of the last library call on
+// this thread, added to the library's own figures by last_alloc_stats.
+thread_local size_t result_copy_bytes = 0;
+
+void trace_passthrough(const void *context, const C2paTraceSpan *span) {
+  try {
+    // the context is a pointer to the C++ callback function
+    auto *callback = reinterpret_cast<TraceFunc *>(const_cast<void *>(context));
+    (callback)(*span);
+  } catch (...) {
+    // exceptions must not unwind into Rust
+  }
+}
+
+int fetch_passthrough(const void *context, const char *url,
+                      C2paFetchResponse *response) {
+  try {
+    // the context is a pointer to the C++ callback function
+    auto *callback = reinterpret_cast<FetchFunc *>(const_cast<void *>(context));
+    auto body = (callback)(url);
+    if (!body) {
+      return -1;
+    }
+    return c2pa_fetch_response_write(response, body->data(), body->size());
+  } catch (...) {
+    // exceptions must not unwind into Rust
+    return -1;
+  }
+}
 } // namespace
 
 namespace c2pa {
@@ -101,7 +132,9 @@ void load_settings(const string &format, const string &data) {
 
 /// converts a filesystem::path to a string in utf-8 format
 inline std::string path_to_string(const filesystem::path &source_path) {
-  return source_path.u8string().c_str();
+  // u8string is a std::u8string from C++20
+  const auto utf8 = source_path.u8string();
+  return {utf8.begin(), utf8.end()};
 }
 
 /// Reads a file and returns the manifest json as a C2pa::String.
@@ -171,6 +204,141 @@ void sign_file(const path &source_path, const path &dest_path,
   c2pa_release_string(result);
 }
 
+/// Sets a callback to fetch remote manifest stores when reading.
+/// @param callback the function to fetch with, or nullptr to let the library
+/// fetch over HTTP itself.
+void set_fetch_callback(FetchFunc *callback) {
+  if (callback == nullptr) {
+    c2pa_set_fetch_callback(nullptr, nullptr);
+    return;
+  }
+  c2pa_set_fetch_callback(reinterpret_cast<const void *>(callback),
+                          &fetch_passthrough);
+}
+
+/// Caches remote manifest stores in a directory.
+/// @throws a C2pa::Exception if the directory could not be created.
+void set_remote_cache(const path &cache_dir, std::chrono::seconds ttl,
+                      uint64_t max_bytes) {
+  const auto ttl_seconds = static_cast<uint64_t>(std::max<int64_t>(
+      0, static_cast<int64_t>(ttl.count())));
+  if (c2pa_set_remote_cache(path_to_string(cache_dir).c_str(), ttl_seconds,
+                            max_bytes) != 0) {
+    throw c2pa::Exception();
+  }
+}
+
+/// Turns the remote manifest cache off, leaving its files in place.
+void disable_remote_cache() { c2pa_set_remote_cache(nullptr, 0, 0); }
+
+/// Rewrites remote manifest URLs that start with a prefix.
+void set_remote_url_rewrite(const string &from_prefix,
+                            const std::optional<string> &to_prefix) {
+  if (c2pa_set_remote_url_rewrite(
+          from_prefix.c_str(),
+          to_prefix.has_value() ? to_prefix->c_str() : nullptr) < 0) {
+    throw c2pa::Exception();
+  }
+}
+
+/// Fetches the remote manifests of a list of files on several threads.
+std::vector<int> prefetch_remote_manifests(const std::vector<path> &paths,
+                                           unsigned threads) {
+  std::vector<string> strings;
+  std::vector<const char *> c_paths;
+  strings.reserve(paths.size());
+  c_paths.reserve(paths.size());
+  for (const auto &source_path : paths) {
+    strings.push_back(path_to_string(source_path));
+    c_paths.push_back(strings.back().c_str());
+  }
+  std::vector<int> results(paths.size());
+  if (c2pa_prefetch_remote_manifests(c_paths.data(), c_paths.size(), threads,
+                                     results.data()) < 0) {
+    throw c2pa::Exception();
+  }
+  return results;
+}
+
+/// Sets a callback to receive a span for each phase of reading and signing.
+/// @param callback the function to call for each span, or nullptr to turn
+/// tracing off.
+void set_trace_callback(TraceFunc *callback) {
+  if (callback == nullptr) {
+    c2pa_set_trace_callback(nullptr, nullptr);
+    return;
+  }
+  c2pa_set_trace_callback(reinterpret_cast<const void *>(callback),
+                          &trace_passthrough);
+}
+
+/// Writes all spans to a file as Chrome trace-event JSON.
+/// @param trace_path the path of the trace file to write.
+/// @throws a C2pa::Exception if the file could not be created.
+void set_trace_file(const path &trace_path) {
+  if (c2pa_set_trace_file(path_to_string(trace_path).c_str()) != 0) {
+    throw c2pa::Exception();
+  }
+}
+
+/// Turns tracing off and completes any trace file in progress.
+/// @throws a C2pa::Exception if the trace file could not be completed.
+void stop_trace() {
+  if (c2pa_trace_stop() != 0) {
+    throw c2pa::Exception();
+  }
+}
+
+/// Turns per operation allocation tracking on or off.
+void enable_alloc_tracking(bool enable) {
+  if (c2pa_alloc_tracking_enable(enable) != 0) {
+    throw c2pa::Exception();
+  }
+}
+
+/// Returns the allocations made by the last Reader or Builder call on this
+/// thread.
+AllocStats last_alloc_stats() {
+  auto stats = c2pa_last_alloc_stats();
+  if (stats.allocations > 0 && result_copy_bytes > 0) {
+    // the copy is made while the library's result is still held
+    stats.allocations += 1;
+    stats.bytes_allocated += result_copy_bytes;
+    stats.peak_bytes += result_copy_bytes;
+  }
+  return stats;
+}
+
+Metrics::Metrics(const C2paMetrics &metrics) : C2paMetrics(metrics) {}
+
+/// Takes a snapshot of the current metrics.
+Metrics Metrics::snapshot() { return Metrics(c2pa_metrics_snapshot()); }
+
+/// Resets all counters and histograms to zero.
+void Metrics::reset() { c2pa_metrics_reset(); }
+
+/// Estimates a percentile of a histogram.
+uint64_t Metrics::percentile_us(const C2paHistogram &histogram,
+                                double percentile) {
+  if (histogram.count == 0) {
+    return 0;
+  }
+  const auto target = static_cast<uint64_t>(
+      static_cast<double>(histogram.count) * percentile / 100.0);
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < C2PA_HISTOGRAM_BUCKETS; bucket++) {
+    seen += histogram.buckets[bucket];
+    if (seen > target || seen == histogram.count) {
+      // bucket n holds samples below 2^n microseconds, the last holds the rest
+      if (bucket + 1 == C2PA_HISTOGRAM_BUCKETS) {
+        return histogram.max_us;
+      }
+      return std::min(uint64_t{1} << bucket, histogram.max_us);
+    }
+  }
+  return histogram.max_us;
+}
+
 /// IStream Class wrapper for CStream.
 template <typename IStream>
 CppIStream::CppIStream(IStream &istream)
@@ -452,18 +620,27 @@ intptr_t CppIOStream::flusher(StreamContext *context) {
 }
 
 /// Reader class for reading a manifest implementation.
-Reader::Reader(const string &format, std::istream &stream)
-    : cpp_stream(new CppIStream(stream)) {
-  // keep this allocated for life of Reader
-  c2pa_reader = c2pa_reader_from_stream(format.c_str(), cpp_stream->c_stream);
-  if (c2pa_reader == nullptr) {
-    throw Exception();
+Reader::Reader(const string &format, std::istream &stream) {
+  open(format, stream);
+}
+
+Reader::Reader(const string &format, std::unique_ptr<std::istream> stream)
+    : owned_stream(std::move(stream)) {
+  if (!owned_stream) {
+    throw Exception("Reader needs a source stream");
   }
+  open(format, *owned_stream);
+}
+
+Reader::Reader(const string &format, std::istream &stream,
+               const std::vector<unsigned char> &manifest_data) {
+  open(format, stream, &manifest_data);
 }
 
 Reader::Reader(const std::filesystem::path &source_path) {
-  std::ifstream file_stream(source_path, std::ios::binary);
-  if (!file_stream.is_open()) {
+  auto file_stream =
+      std::make_unique<std::ifstream>(source_path, std::ios::binary);
+  if (!file_stream->is_open()) {
     throw Exception("Failed to open file: " + source_path.string() + " - " +
                     std::strerror(errno));
   }
@@ -471,21 +648,45 @@ Reader::Reader(const std::filesystem::path &source_path) {
   if (!extension.empty()) {
     extension = extension.substr(1); // Skip the dot
   }
+  // owned, so the stream outlives the CStream that refers to it
+  owned_stream = std::move(file_stream);
+  open(extension, *owned_stream);
+}
 
-  cpp_stream =
-      new CppIStream(file_stream); // keep this allocated for life of Reader
-  c2pa_reader =
-      c2pa_reader_from_stream(extension.c_str(), cpp_stream->c_stream);
+void Reader::open(const string &format, std::istream &stream,
+                  const std::vector<unsigned char> *manifest_data) {
+  cpp_stream = std::make_unique<CppIStream>(stream);
+  result_copy_bytes = 0;
+  c2pa_reader = manifest_data != nullptr
+                    ? c2pa_reader_from_manifest_data_and_stream(
+                          format.c_str(), cpp_stream->c_stream,
+                          manifest_data->data(), manifest_data->size())
+                    : c2pa_reader_from_stream(format.c_str(),
+                                              cpp_stream->c_stream);
   if (c2pa_reader == nullptr) {
     throw Exception();
   }
 }
 
-Reader::~Reader() {
-  c2pa_reader_free(c2pa_reader);
-  delete cpp_stream;
+Reader::Reader(Reader &&other) noexcept
+    : c2pa_reader(std::exchange(other.c2pa_reader, nullptr)),
+      owned_stream(std::move(other.owned_stream)),
+      cpp_stream(std::move(other.cpp_stream)),
+      store_cache(std::move(other.store_cache)) {}
+
+Reader &Reader::operator=(Reader &&other) noexcept {
+  if (this != &other) {
+    c2pa_reader_free(c2pa_reader);
+    c2pa_reader = std::exchange(other.c2pa_reader, nullptr);
+    cpp_stream = std::move(other.cpp_stream);
+    owned_stream = std::move(other.owned_stream);
+    store_cache = std::move(other.store_cache);
+  }
+  return *this;
 }
 
+Reader::~Reader() { c2pa_reader_free(c2pa_reader); }
+
 string Reader::json() const {
   char *result = c2pa_reader_json(c2pa_reader);
   if (result == nullptr) {
@@ -493,9 +694,32 @@ string Reader::json() const {
   }
   auto str = string(result);
   c2pa_release_string(result);
+  result_copy_bytes = str.size();
   return str;
 }
 
+std::vector<unsigned char> Reader::cbor() const {
+  const unsigned char *c2pa_cbor = nullptr;
+  const int result = c2pa_reader_cbor(c2pa_reader, &c2pa_cbor);
+  if (result < 0 || c2pa_cbor == nullptr) {
+    throw Exception();
+  }
+  auto cbor = std::vector<unsigned char>(c2pa_cbor, c2pa_cbor + result);
+  c2pa_manifest_bytes_free(c2pa_cbor);
+  result_copy_bytes = cbor.size();
+  return cbor;
+}
+
+const std::vector<unsigned char> &Reader::kept_cbor() const {
+  if (!store_cache) {
+    throw Exception("Reader has been moved from");
+  }
+  // a failed encode leaves the flag unset, so the next call tries again
+  std::call_once(store_cache->once,
+                 [this] { store_cache->cbor = cbor(); });
+  return store_cache->cbor;
+}
+
 int Reader::get_resource(const string &uri,
                          const std::filesystem::path &path) const {
   std::ofstream file_stream(path, std::ios::binary);
@@ -507,6 +731,7 @@ int Reader::get_resource(const string &uri,
 
 int Reader::get_resource(const string &uri, std::ostream &stream) const {
   const CppOStream cpp_stream_(stream);
+  result_copy_bytes = 0;
   const int result = c2pa_reader_resource_to_stream(c2pa_reader, uri.c_str(),
                                                     cpp_stream_.c_stream);
   if (result < 0) {
@@ -515,6 +740,145 @@ int Reader::get_resource(const string &uri, std::ostream &stream) const {
   return result;
 }
 
+namespace {
+const char *label_or_active(const string &label) {
+  return label.empty() ? nullptr : label.c_str();
+}
+
+string take_string(char *result) {
+  if (result == nullptr) {
+    throw Exception();
+  }
+  auto str = string(result);
+  c2pa_release_string(result);
+  return str;
+}
+} // namespace
+
+IngredientWalk Reader::ingredients(unsigned max_depth) const {
+  return IngredientWalk(c2pa_reader, max_depth);
+}
+
+string Reader::ingredient_json(const IngredientNode &node) const {
+  auto str = take_string(c2pa_reader_ingredient_json(
+      c2pa_reader, label_or_active(node.manifest_label), node.index));
+  result_copy_bytes = str.size();
+  return str;
+}
+
+string Reader::ingredient_validation_status(const IngredientNode &node) const {
+  return take_string(c2pa_reader_ingredient_validation_status(
+      c2pa_reader, label_or_active(node.manifest_label), node.index));
+}
+
+IngredientWalk::iterator IngredientWalk::begin() {
+  stack.clear();
+  node = IngredientNode();
+  skip = false;
+  active = take_string(c2pa_reader_active_label(reader));
+  expanded = {active};
+  push("");
+  return iterator(advance() ? this : nullptr);
+}
+
+IngredientWalk::iterator &IngredientWalk::iterator::operator++() {
+  if (!walk->advance()) {
+    walk = nullptr;
+  }
+  return *this;
+}
+
+void IngredientWalk::push(const string &label) {
+  const auto count =
+      c2pa_reader_ingredient_count(reader, label_or_active(label));
+  if (count < 0) {
+    throw Exception();
+  }
+  stack.push_back(Level{label, 0, static_cast<size_t>(count)});
+}
+
+/// Moves to the next node, expanding the current one if it has a manifest.
+bool IngredientWalk::advance() {
+  bool expand = !skip && !node.child_label.empty();
+  if (expand && max_depth == 0) {
+    // a diamond would be walked once per path, so only expand once
+    expand = expanded.insert(node.child_label).second;
+  } else if (expand) {
+    // a damaged store could refer back to a manifest on the current path
+    expand = node.depth < max_depth && node.child_label != active &&
+             std::none_of(stack.begin(), stack.end(),
+                          [this](const Level &level) {
+                            return level.label == node.child_label;
+                          });
+  }
+  skip = false;
+  if (expand) {
+    push(node.child_label);
+  }
+  while (!stack.empty()) {
+    auto &level = stack.back();
+    if (level.next < level.count) {
+      node.manifest_label = level.label;
+      node.index = level.next++;
+      node.depth = static_cast<unsigned>(stack.size());
+      node.child_label = take_string(c2pa_reader_ingredient_manifest_label(
+          reader, label_or_active(level.label), node.index));
+      return true;
+    }
+    stack.pop_back();
+  }
+  node = IngredientNode();
+  return false;
+}
+
+string Reader::binding_hash() const {
+  return take_string(c2pa_reader_binding_hash(c2pa_reader));
+}
+
+bool Reader::verify_fragments(
+    const std::vector<std::istream *> &fragments) const {
+  std::vector<std::unique_ptr<CppIStream>> cpp_streams;
+  std::vector<CStream *> c_streams;
+  cpp_streams.reserve(fragments.size());
+  c_streams.reserve(fragments.size());
+  for (auto *fragment : fragments) {
+    cpp_streams.push_back(std::make_unique<CppIStream>(*fragment));
+    c_streams.push_back(cpp_streams.back()->c_stream);
+  }
+  const auto result = c2pa_reader_verify_fragments(
+      c2pa_reader, c_streams.data(), c_streams.size());
+  if (result < 0) {
+    throw Exception();
+  }
+  return result == 1;
+}
+
+string compute_binding_hash(const string &format, std::istream &stream,
+                            const string &alg) {
+  const CppIStream cpp_stream_(stream);
+  return take_string(c2pa_compute_binding_hash(
+      format.c_str(), cpp_stream_.c_stream, alg.c_str()));
+}
+
+std::vector<int>
+verify_binding_hashes(const string &binding_json,
+                      const std::vector<std::istream *> &streams) {
+  std::vector<std::unique_ptr<CppIStream>> cpp_streams;
+  std::vector<CStream *> c_streams;
+  cpp_streams.reserve(streams.size());
+  c_streams.reserve(streams.size());
+  for (auto *stream : streams) {
+    cpp_streams.push_back(std::make_unique<CppIStream>(*stream));
+    c_streams.push_back(cpp_streams.back()->c_stream);
+  }
+  std::vector<int> results(streams.size());
+  if (c2pa_verify_binding_hashes(binding_json.c_str(), c_streams.data(),
+                                 c_streams.size(), results.data()) < 0) {
+    throw Exception();
+  }
+  return results;
+}
+
 Signer::Signer(SignerFunc *callback, const C2paSigningAlg alg,
                const string &sign_cert,
                const std::optional<std::string> &tsa_uri)
@@ -533,10 +897,37 @@ uintptr_t Signer::reserve_size() const {
   return c2pa_signer_reserve_size(signer_);
 }
 
+/// Does the one time setup of a process up front.
+InitReport initialize(const optional<string> &settings, const string &format,
+                      const Signer *signer) {
+  const C2paInitOptions options = {
+      settings ? settings->c_str() : nullptr,
+      format.c_str(),
+      signer != nullptr ? signer->c2pa_signer() : nullptr,
+  };
+  InitReport report{};
+  if (c2pa_init(&options, &report) != 0) {
+    throw c2pa::Exception();
+  }
+  return report;
+}
+
 /// @brief  Builder class for creating a manifest implementation.
 Builder::Builder(const string &manifest_json)
     : builder(c2pa_builder_from_json(manifest_json.c_str())) {
+  result_copy_bytes = 0;
+  if (builder == nullptr) {
+    throw Exception();
+  }
+}
 
+Builder::Builder(const std::vector<uint8_t> &manifest,
+                 ManifestEncoding encoding)
+    : builder(encoding == ManifestEncoding::Cbor
+                  ? c2pa_builder_from_cbor(manifest.data(), manifest.size())
+                  : c2pa_builder_from_json(
+                        string(manifest.begin(), manifest.end()).c_str())) {
+  result_copy_bytes = 0;
   if (builder == nullptr) {
     throw Exception();
   }
@@ -547,6 +938,7 @@ Builder::Builder(const string &manifest_json)
 /// @throws C2pa::Exception for errors encountered by the C2PA library.
 Builder::Builder(istream &archive) {
   const auto c_archive = CppIStream(archive);
+  result_copy_bytes = 0;
   builder = c2pa_builder_from_archive(c_archive.c_stream);
   if (builder == nullptr) {
     throw Exception();
@@ -565,6 +957,7 @@ void Builder::set_remote_url(const string &remote_url) const {
 
 void Builder::add_resource(const string &uri, istream &source) const {
   const auto c_source = CppIStream(source);
+  result_copy_bytes = 0;
   if (const int result =
           c2pa_builder_add_resource(builder, uri.c_str(), c_source.c_stream);
       result < 0) {
@@ -585,6 +978,7 @@ void Builder::add_resource(const string &uri,
 void Builder::add_ingredient(const string &ingredient_json,
                              const string &format, istream &source) const {
   const auto c_source = CppIStream(source);
+  result_copy_bytes = 0;
   if (const int result = c2pa_builder_add_ingredient_from_stream(
           builder, ingredient_json.c_str(), format.c_str(), c_source.c_stream);
       result < 0) {
@@ -606,6 +1000,28 @@ void Builder::add_ingredient(const string &ingredient_json,
   add_ingredient(ingredient_json, format, stream);
 }
 
+void Builder::add_ingredients(
+    const std::vector<IngredientSource> &sources) const {
+  std::vector<std::unique_ptr<CppIStream>> streams;
+  std::vector<C2paIngredientSource> c_sources;
+  streams.reserve(sources.size());
+  c_sources.reserve(sources.size());
+  for (const auto &source : sources) {
+    if (source.source == nullptr) {
+      throw Exception("IngredientSource needs a source stream");
+    }
+    streams.push_back(std::make_unique<CppIStream>(*source.source));
+    c_sources.push_back(C2paIngredientSource{source.ingredient_json.c_str(),
+                                             source.format.c_str(),
+                                             streams.back()->c_stream});
+  }
+  result_copy_bytes = 0;
+  if (c2pa_builder_add_ingredients(builder, c_sources.data(),
+                                   c_sources.size()) < 0) {
+    throw Exception();
+  }
+}
+
 std::vector<unsigned char> Builder::sign(const string &format, istream &source,
                                          iostream &dest,
                                          const Signer &signer) const {
@@ -622,6 +1038,34 @@ std::vector<unsigned char> Builder::sign(const string &format, istream &source,
   auto manifest_bytes = std::vector<unsigned char>(
       c2pa_manifest_bytes, c2pa_manifest_bytes + result);
   c2pa_manifest_bytes_free(c2pa_manifest_bytes);
+  result_copy_bytes = manifest_bytes.size();
+  return manifest_bytes;
+}
+
+/// @brief Sign a stream, making it the parent if it is already signed.
+/// @param format The format of the output stream.
+/// @param source The input stream to sign.
+/// @param dest The output stream to write the signed data to.
+/// @param signer The signer to use for signing.
+/// @return A vector containing the signed manifest bytes.
+/// @throws C2pa::Exception for errors encountered by the C2PA library.
+std::vector<unsigned char>
+Builder::sign_with_parent(const string &format, istream &source,
+                          iostream &dest, const Signer &signer) const {
+  const auto c_source = CppIStream(source);
+  const auto c_dest = CppIOStream(dest);
+  const unsigned char *c2pa_manifest_bytes = nullptr;
+  const auto result = c2pa_builder_sign_with_parent(
+      builder, format.c_str(), c_source.c_stream, c_dest.c_stream,
+      signer.c2pa_signer(), &c2pa_manifest_bytes);
+  if (result < 0 || c2pa_manifest_bytes == nullptr) {
+    throw Exception();
+  }
+
+  auto manifest_bytes = std::vector<unsigned char>(
+      c2pa_manifest_bytes, c2pa_manifest_bytes + result);
+  c2pa_manifest_bytes_free(c2pa_manifest_bytes);
+  result_copy_bytes = manifest_bytes.size();
   return manifest_bytes;
 }
 
@@ -680,6 +1124,7 @@ Builder Builder::from_archive(const path &archive_path) {
 /// @throws C2pa::Exception for errors encountered by the C2PA library.
 void Builder::to_archive(ostream &dest) const {
   const auto c_dest = CppOStream(dest);
+  result_copy_bytes = 0;
   if (const int result = c2pa_builder_to_archive(builder, c_dest.c_stream);
       result < 0) {
     throw Exception();
@@ -711,6 +1156,7 @@ Builder::data_hashed_placeholder(uintptr_t reserve_size,
   auto data = std::vector<unsigned char>(c2pa_manifest_bytes,
                                          c2pa_manifest_bytes + result);
   c2pa_manifest_bytes_free(c2pa_manifest_bytes);
+  result_copy_bytes = data.size();
   return data;
 }
 
@@ -736,9 +1182,59 @@ std::vector<unsigned char> Builder::sign_data_hashed_embeddable(
   auto data = std::vector<unsigned char>(c2pa_manifest_bytes,
                                          c2pa_manifest_bytes + result);
   c2pa_manifest_bytes_free(c2pa_manifest_bytes);
+  result_copy_bytes = data.size();
   return data;
 }
 
+/// @brief Sign a source as a sidecar manifest, without writing the asset.
+std::vector<unsigned char> Builder::sign_sidecar(const string &format,
+                                                 istream &source,
+                                                 const Signer &signer) const {
+  const auto c_source = CppIStream(source);
+  const unsigned char *c2pa_manifest_bytes = nullptr;
+  const auto result =
+      c2pa_builder_sign_sidecar(builder, format.c_str(), c_source.c_stream,
+                                signer.c2pa_signer(), &c2pa_manifest_bytes);
+  if (result < 0 || c2pa_manifest_bytes == nullptr) {
+    throw Exception();
+  }
+
+  auto manifest_bytes = std::vector<unsigned char>(
+      c2pa_manifest_bytes, c2pa_manifest_bytes + result);
+  c2pa_manifest_bytes_free(c2pa_manifest_bytes);
+  result_copy_bytes = manifest_bytes.size();
+  return manifest_bytes;
+}
+
+/// @brief Sign a file and write its manifest to a .c2pa sidecar file.
+std::vector<unsigned char> Builder::sign_sidecar(const path &source_path,
+                                                 const path &sidecar_path,
+                                                 const Signer &signer) const {
+  std::ifstream source(source_path, std::ios::binary);
+  if (!source.is_open()) {
+    throw std::runtime_error("Failed to open source file: " +
+                             source_path.string());
+  }
+  auto format = source_path.extension().string();
+  if (!format.empty()) {
+    format = format.substr(1); // Skip the dot
+  }
+  auto manifest_bytes = sign_sidecar(format, source, signer);
+
+  std::ofstream sidecar(sidecar_path, std::ios::binary | std::ios::trunc);
+  if (!sidecar.is_open()) {
+    throw std::runtime_error("Failed to open sidecar file: " +
+                             sidecar_path.string());
+  }
+  sidecar.write(reinterpret_cast<const char *>(manifest_bytes.data()),
+                static_cast<std::streamsize>(manifest_bytes.size()));
+  if (!sidecar) {
+    throw std::runtime_error("Failed to write sidecar file: " +
+                             sidecar_path.string());
+  }
+  return manifest_bytes;
+}
+
 std::vector<unsigned char>
 Builder::format_embeddable(const string &format,
                            const std::vector<unsigned char> &data) {
@@ -754,4 +1250,48 @@ Builder::format_embeddable(const string &format,
   c2pa_manifest_bytes_free(c2pa_manifest_bytes);
   return formatted_data;
 }
+
+/// @brief  Get the C2paBuilder
+C2paBuilder *Builder::c2pa_builder() const { return builder; }
+
+/// @brief  Start signing a fragmented MP4 recording.
+FragmentedSession::FragmentedSession(const Builder &builder,
+                                     const string &format, istream &init) {
+  const auto c_init = CppIStream(init);
+  result_copy_bytes = 0;
+  session = c2pa_fragmented_session_new(builder.c2pa_builder(),
+                                        format.c_str(), c_init.c_stream);
+  if (session == nullptr) {
+    throw Exception();
+  }
+}
+
+/// @brief  Hash the next fragment of the recording.
+uint64_t FragmentedSession::add_fragment(istream &fragment) const {
+  const auto c_fragment = CppIStream(fragment);
+  const auto count =
+      c2pa_fragmented_session_add_fragment(session, c_fragment.c_stream);
+  if (count < 0) {
+    throw Exception();
+  }
+  return static_cast<uint64_t>(count);
+}
+
+/// @brief  Write the signed init segment for the fragments added so far.
+std::vector<unsigned char> FragmentedSession::sign(iostream &dest,
+                                                   const Signer &signer) const {
+  const auto c_dest = CppIOStream(dest);
+  const unsigned char *c2pa_manifest_bytes = nullptr;
+  const auto result = c2pa_fragmented_session_sign(
+      session, signer.c2pa_signer(), c_dest.c_stream, &c2pa_manifest_bytes);
+  if (result < 0 || c2pa_manifest_bytes == nullptr) {
+    throw Exception();
+  }
+
+  auto manifest_bytes = std::vector<unsigned char>(
+      c2pa_manifest_bytes, c2pa_manifest_bytes + result);
+  c2pa_manifest_bytes_free(c2pa_manifest_bytes);
+  result_copy_bytes = manifest_bytes.size();
+  return manifest_bytes;
+}
 } // namespace c2pa
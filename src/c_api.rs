@@ -13,20 +13,33 @@
 
 use std::{
     ffi::CString,
+    io::{Cursor, Read, Seek, Write},
     os::raw::{c_char, c_int, c_uchar, c_void},
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Mutex,
+    },
+    thread,
 };
 
 // C has no namespace so we prefix things with C2PA to make them unique
 use c2pa::{
-    assertions::DataHash, settings::load_settings_from_str, Builder as C2paBuilder, CallbackSigner,
-    Reader as C2paReader, SigningAlg,
+    assertions::DataHash, Builder as C2paBuilder, CallbackSigner, Ingredient, ManifestDefinition,
+    Reader as C2paReader, Signer, SigningAlg,
 };
 
 use crate::{
+    alloc_stats,
     c_stream::CStream,
-    error::Error,
+    error::{Error, Result},
+    jpeg,
     json_api::{read_file, read_ingredient_file, sign_file},
+    merkle,
+    metrics::{self, Kind, Operation},
+    parent, png, settings,
     signer_info::SignerInfo,
+    tiff,
+    trace::{names, Span, TracedSigner, TracedStream},
 };
 
 // Work around limitations in cbindgen.
@@ -123,6 +136,25 @@ macro_rules! from_cstr_null_check_int {
     };
 }
 
+// Internal routine to convert a *const c_char to Option<String>,
+// or return a -1 int error if it is not UTF-8.
+#[macro_export]
+macro_rules! from_cstr_option_int {
+    ($ptr : expr) => {
+        if $ptr.is_null() {
+            None
+        } else {
+            match std::ffi::CStr::from_ptr($ptr).to_str() {
+                Ok(s) => Some(s.to_owned()),
+                Err(err) => {
+                    Error::set_last(Error::Decoding(format!("{}: {}", stringify!($ptr), err)));
+                    return -1;
+                }
+            }
+        }
+    };
+}
+
 // Internal routine to convert a *const c_char to Option<String>.
 #[macro_export]
 macro_rules! from_cstr_option {
@@ -155,7 +187,7 @@ pub type SignerCallback = unsafe extern "C" fn(
 // Internal routine to return a rust String reference to C as *mut c_char.
 // The returned value MUST be released by calling release_string
 // and it is no longer valid after that call.
-unsafe fn to_c_string(s: String) -> *mut c_char {
+pub(crate) unsafe fn to_c_string(s: String) -> *mut c_char {
     match CString::new(s) {
         Ok(c_str) => c_str.into_raw(),
         Err(_) => std::ptr::null_mut(),
@@ -191,6 +223,9 @@ pub unsafe extern "C" fn c2pa_error() -> *mut c_char {
 
 /// Load Settings from a string.
 ///
+/// Loading exactly the settings text that is already in effect, in the same
+/// format, is skipped. Any other text is loaded and parsed in full.
+///
 /// # Errors
 /// Returns -1 if there were errors, otherwise returns 0.
 /// The error string can be retrieved by calling c2pa_error.
@@ -204,7 +239,7 @@ pub unsafe extern "C" fn c2pa_load_settings(
 ) -> c_int {
     let settings = from_cstr_null_check_int!(settings);
     let format = from_cstr_null_check_int!(format);
-    let result = load_settings_from_str(&settings, &format);
+    let result = settings::load(&settings, &format);
     match result {
         Ok(_) => 0,
         Err(err) => {
@@ -324,10 +359,19 @@ pub unsafe extern "C" fn c2pa_sign_file(
         ta_url: from_cstr_option!(signer_info.ta_url),
     };
     // Read manifest from JSON and then sign and write it.
+    let _alloc = alloc_stats::Scope::new();
+    let _span = Span::new(names::SIGN_FILE);
+    let operation = Operation::begin(Kind::Sign);
     let result = sign_file(&source_path, &dest_path, &manifest, &signer_info, data_dir);
 
     match result {
-        Ok(_c2pa_data) => to_c_string("".to_string()),
+        Ok(_c2pa_data) => {
+            if let Ok(metadata) = std::fs::metadata(&source_path) {
+                metrics::add_bytes_hashed(metadata.len());
+            }
+            operation.complete();
+            to_c_string("".to_string())
+        }
         Err(e) => {
             e.set_last();
             std::ptr::null_mut()
@@ -390,9 +434,73 @@ pub unsafe extern "C" fn c2pa_reader_from_stream(
 ) -> *mut C2paReader {
     let format = from_cstr_null_check!(format);
 
-    let result = C2paReader::from_stream(&format, &mut (*stream));
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::READER_FROM_STREAM);
+    let operation = Operation::begin(Kind::Read);
+    let mut stream = TracedStream::new(&mut (*stream));
+    // the format readers also read remote manifests, after their own scan
+    let result = if jpeg::is_jpeg(&format) {
+        jpeg::read(&format, &mut stream)
+    } else if png::is_png(&format) {
+        png::read(&format, &mut stream)
+    } else if tiff::is_tiff(&format) {
+        tiff::read(&format, &mut stream)
+    } else {
+        C2paReader::from_stream(&format, &mut stream)
+    };
+    span.add_bytes(stream.bytes_read());
     match result {
-        Ok(reader) => Box::into_raw(Box::new(reader)),
+        Ok(reader) => {
+            operation.complete();
+            Box::into_raw(Box::new(reader))
+        }
+        Err(err) => {
+            Error::from_c2pa_error(err).set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Creates and verifies a C2paReader from a sidecar manifest and its asset stream.
+///
+/// Parameters
+/// * format: pointer to a C string with the mime type or extension.
+/// * stream: pointer to a CStream with the asset the manifest was made for.
+/// * manifest_data: pointer to the manifest store, such as a .c2pa sidecar.
+/// * manifest_size: the size of the manifest store in bytes.
+///
+/// # Errors
+/// Returns NULL if there were errors, otherwise returns a pointer to a ManifestStore.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// manifest_data must point to at least manifest_size bytes.
+/// The returned value MUST be released by calling c2pa_reader_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_from_manifest_data_and_stream(
+    format: *const c_char,
+    stream: *mut CStream,
+    manifest_data: *const c_uchar,
+    manifest_size: usize,
+) -> *mut C2paReader {
+    null_check!(stream);
+    null_check!(manifest_data);
+    let format = from_cstr_null_check!(format);
+    let manifest_data = std::slice::from_raw_parts(manifest_data, manifest_size);
+
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::READER_FROM_STREAM);
+    let operation = Operation::begin(Kind::Read);
+    let mut stream = TracedStream::new(&mut (*stream));
+    let result = C2paReader::from_manifest_data_and_stream(manifest_data, &format, &mut stream);
+    span.add_bytes(stream.bytes_read());
+    match result {
+        Ok(reader) => {
+            operation.complete();
+            Box::into_raw(Box::new(reader))
+        }
         Err(err) => {
             Error::from_c2pa_error(err).set_last();
             std::ptr::null_mut()
@@ -418,12 +526,55 @@ pub unsafe extern "C" fn c2pa_reader_free(reader_ptr: *mut C2paReader) {
 /// and it is no longer valid after that call.
 #[no_mangle]
 pub unsafe extern "C" fn c2pa_reader_json(reader_ptr: *mut C2paReader) -> *mut c_char {
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::READER_JSON);
     let c2pa_reader: Box<C2paReader> = Box::from_raw(reader_ptr);
     let json = c2pa_reader.json();
     let _ = Box::into_raw(c2pa_reader);
+    span.add_bytes(json.len() as u64);
     to_c_string(json)
 }
 
+/// Returns the manifest store of a C2paReader as CBOR.
+///
+/// The CBOR has the same structure as the JSON from c2pa_reader_json, and is
+/// smaller and quicker to produce and to parse.
+///
+/// # Parameters
+/// * reader_ptr: pointer to a Reader.
+/// * cbor_ptr: pointer to a pointer to a c_uchar to return the CBOR.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns the size of the CBOR.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// The returned value MUST be released by calling c2pa_manifest_bytes_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_cbor(
+    reader_ptr: *mut C2paReader,
+    cbor_ptr: *mut *const c_uchar,
+) -> c_int {
+    null_check_int!(reader_ptr);
+    null_check_int!(cbor_ptr);
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::READER_CBOR);
+    let mut cbor = Vec::new();
+    match ciborium::into_writer(&*reader_ptr, &mut cbor) {
+        Ok(()) => {
+            span.add_bytes(cbor.len() as u64);
+            let len = cbor.len() as c_int;
+            *cbor_ptr = Box::into_raw(cbor.into_boxed_slice()) as *const c_uchar;
+            len
+        }
+        Err(err) => {
+            Error::Encoding(err.to_string()).set_last();
+            -1
+        }
+    }
+}
+
 /// Writes a C2paReader resource to a stream given a URI.
 ///
 /// The resource uri should match an identifier in the the manifest store.
@@ -454,8 +605,13 @@ pub unsafe extern "C" fn c2pa_reader_resource_to_stream(
 ) -> c_int {
     let reader: Box<C2paReader> = Box::from_raw(reader_ptr);
     let uri = from_cstr_null_check_int!(uri);
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::READER_RESOURCE);
     let result = reader.resource_to_stream(&uri, &mut (*stream));
     let _ = Box::into_raw(reader);
+    if let Ok(len) = result.as_ref() {
+        span.add_bytes(*len as u64);
+    }
     match result {
         Ok(len) => len as c_int,
         Err(err) => {
@@ -486,6 +642,7 @@ pub unsafe extern "C" fn c2pa_reader_resource_to_stream(
 #[no_mangle]
 pub unsafe extern "C" fn c2pa_builder_from_json(manifest_json: *const c_char) -> *mut C2paBuilder {
     let manifest_json = from_cstr_null_check!(manifest_json);
+    let _alloc = alloc_stats::Scope::new();
     let result = C2paBuilder::from_json(&manifest_json);
     match result {
         Ok(builder) => Box::into_raw(Box::new(builder)),
@@ -496,6 +653,47 @@ pub unsafe extern "C" fn c2pa_builder_from_json(manifest_json: *const c_char) ->
     }
 }
 
+/// Creates a C2paBuilder from a CBOR manifest definition.
+///
+/// The definition has the same schema as for c2pa_builder_from_json and is
+/// checked the same way.
+///
+/// # Parameters
+/// * manifest_cbor: pointer to the CBOR bytes.
+/// * len: the number of bytes.
+///
+/// # Errors
+/// Returns NULL if there were errors, otherwise returns a pointer to a Builder.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// manifest_cbor must point to at least len readable bytes.
+/// The returned value MUST be released by calling c2pa_builder_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+// the other Builder fields are private, so it cannot be built with the definition
+#[allow(clippy::field_reassign_with_default)]
+pub unsafe extern "C" fn c2pa_builder_from_cbor(
+    manifest_cbor: *const c_uchar,
+    len: usize,
+) -> *mut C2paBuilder {
+    null_check!(manifest_cbor);
+    let manifest_cbor = std::slice::from_raw_parts(manifest_cbor, len);
+    let _alloc = alloc_stats::Scope::new();
+    // as C2paBuilder::from_json does, with the other decoder
+    match ciborium::from_reader::<ManifestDefinition, _>(manifest_cbor) {
+        Ok(definition) => {
+            let mut builder = C2paBuilder::default();
+            builder.definition = definition;
+            Box::into_raw(Box::new(builder))
+        }
+        Err(err) => {
+            Error::Decoding(err.to_string()).set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
 /// Create a C2paBuilder from an archive stream.
 ///
 /// # Errors
@@ -516,6 +714,7 @@ pub unsafe extern "C" fn c2pa_builder_from_json(manifest_json: *const c_char) ->
 /// ```
 #[no_mangle]
 pub unsafe extern "C" fn c2pa_builder_from_archive(stream: *mut CStream) -> *mut C2paBuilder {
+    let _alloc = alloc_stats::Scope::new();
     let result = C2paBuilder::from_archive(&mut (*stream));
     match result {
         Ok(builder) => Box::into_raw(Box::new(builder)),
@@ -596,7 +795,11 @@ pub unsafe extern "C" fn c2pa_builder_add_resource(
 ) -> c_int {
     let mut builder: Box<C2paBuilder> = Box::from_raw(builder_ptr);
     let uri = from_cstr_null_check_int!(uri);
-    let result = builder.add_resource(&uri, &mut (*stream));
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::BUILDER_ADD_RESOURCE);
+    let mut stream = TracedStream::new(&mut (*stream));
+    let result = builder.add_resource(&uri, &mut stream);
+    span.add_bytes(stream.bytes_read());
     match result {
         Ok(_builder) => {
             let _ = Box::into_raw(builder);
@@ -633,7 +836,11 @@ pub unsafe extern "C" fn c2pa_builder_add_ingredient_from_stream(
     let mut builder: Box<C2paBuilder> = Box::from_raw(builder_ptr);
     let ingredient_json = from_cstr_null_check_int!(ingredient_json);
     let format = from_cstr_null_check_int!(format);
-    let result = builder.add_ingredient_from_stream(&ingredient_json, &format, &mut (*source));
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::BUILDER_ADD_INGREDIENT);
+    let mut source = TracedStream::new(&mut (*source));
+    let result = builder.add_ingredient_from_stream(&ingredient_json, &format, &mut source);
+    span.add_bytes(source.bytes_read());
     match result {
         Ok(_builder) => {
             let _ = Box::into_raw(builder);
@@ -646,6 +853,131 @@ pub unsafe extern "C" fn c2pa_builder_add_ingredient_from_stream(
     }
 }
 
+/// Where to read one ingredient from, for c2pa_builder_add_ingredients.
+#[repr(C)]
+pub struct C2paIngredientSource {
+    /// The JSON ingredient definition.
+    pub ingredient_json: *const c_char,
+    /// The mime type or extension of the ingredient.
+    pub format: *const c_char,
+    /// The stream to read the ingredient from.
+    pub stream: *mut CStream,
+}
+
+// Reads ingredients on up to one thread per core, returning them in order.
+fn read_ingredients(sources: Vec<(String, String, &mut CStream)>) -> Result<Vec<Ingredient>> {
+    let count = sources.len();
+    let threads = thread::available_parallelism()
+        .map(|n| n.get())
+        .unwrap_or(1)
+        .min(count);
+    let queue = Mutex::new(sources.into_iter().enumerate());
+    let failed = AtomicBool::new(false);
+    let mut slots: Vec<Option<Result<Ingredient>>> = (0..count).map(|_| None).collect();
+    thread::scope(|scope| {
+        let workers: Vec<_> = (0..threads)
+            .map(|_| {
+                scope.spawn(|| {
+                    let mut done = Vec::new();
+                    // stop taking work once any ingredient has failed
+                    while !failed.load(Ordering::Relaxed) {
+                        let next = queue.lock().unwrap_or_else(|e| e.into_inner()).next();
+                        let Some((index, (json, format, stream))) = next else {
+                            break;
+                        };
+                        let mut span = Span::new(names::BUILDER_ADD_INGREDIENT);
+                        let mut source = TracedStream::new(stream);
+                        let result = Ingredient::from_json(&json)
+                            .and_then(|ingredient| ingredient.with_stream(format, &mut source))
+                            .map_err(Error::from_c2pa_error);
+                        span.add_bytes(source.bytes_read());
+                        if result.is_err() {
+                            failed.store(true, Ordering::Relaxed);
+                        }
+                        done.push((index, result));
+                    }
+                    done
+                })
+            })
+            .collect();
+        for worker in workers {
+            // a panic in c2pa leaves its slots empty, which is reported below
+            for (index, result) in worker.join().unwrap_or_default() {
+                slots[index] = Some(result);
+            }
+        }
+    });
+
+    let mut ingredients = Vec::with_capacity(count);
+    for (index, slot) in slots.into_iter().enumerate() {
+        match slot {
+            Some(Ok(ingredient)) => ingredients.push(ingredient),
+            Some(Err(err)) => return Err(Error::Other(format!("ingredient {index}: {err}"))),
+            // skipped after another ingredient failed, that one is reported
+            None if failed.load(Ordering::Relaxed) => continue,
+            None => return Err(Error::Other(format!("ingredient {index}: not read"))),
+        }
+    }
+    Ok(ingredients)
+}
+
+/// Adds several ingredients to the C2paBuilder, reading them concurrently.
+///
+/// Each ingredient is read, hashed and thumbnailed as by
+/// c2pa_builder_add_ingredient_from_stream, on up to one thread per core,
+/// and they are added in the order given. If any ingredient fails, none
+/// are added.
+///
+/// # Parameters
+/// * builder_ptr: pointer to a Builder.
+/// * sources: pointer to an array of count ingredient sources.
+/// * count: the number of sources.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns 0.
+/// The error string, which gives the index of the failed ingredient, can be
+/// retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// sources must point to count elements, each with its own stream, and the
+/// streams must be safe to read from different threads.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_builder_add_ingredients(
+    builder_ptr: *mut C2paBuilder,
+    sources: *const C2paIngredientSource,
+    count: usize,
+) -> c_int {
+    null_check_int!(builder_ptr);
+    if count == 0 {
+        return 0;
+    }
+    null_check_int!(sources);
+    let mut inputs = Vec::with_capacity(count);
+    for source in std::slice::from_raw_parts(sources, count) {
+        let ingredient_json = from_cstr_null_check_int!(source.ingredient_json);
+        let format = from_cstr_null_check_int!(source.format);
+        null_check_int!(source.stream);
+        inputs.push((ingredient_json, format, &mut *source.stream));
+    }
+
+    let _alloc = alloc_stats::Scope::new();
+    let _span = Span::new(names::BUILDER_ADD_INGREDIENTS);
+    match read_ingredients(inputs) {
+        Ok(ingredients) => {
+            let builder = &mut *builder_ptr;
+            for ingredient in ingredients {
+                builder.add_ingredient(ingredient);
+            }
+            0
+        }
+        Err(err) => {
+            err.set_last();
+            -1
+        }
+    }
+}
+
 /// Writes an Archive of the Builder to the destination stream.
 ///
 /// # Parameters
@@ -672,6 +1004,7 @@ pub unsafe extern "C" fn c2pa_builder_to_archive(
     stream: *mut CStream,
 ) -> c_int {
     let mut builder: Box<C2paBuilder> = Box::from_raw(builder_ptr);
+    let _alloc = alloc_stats::Scope::new();
     let result = builder.to_archive(&mut (*stream));
     match result {
         Ok(_builder) => {
@@ -717,16 +1050,22 @@ pub unsafe extern "C" fn c2pa_builder_sign(
 
     let c2pa_signer = Box::from_raw(signer);
 
-    let result = builder.sign(
-        c2pa_signer.signer.as_ref(),
-        &format,
-        &mut *source,
-        &mut *dest,
-    );
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::BUILDER_SIGN);
+    let operation = Operation::begin(Kind::Sign);
+    let mut source = TracedStream::new(&mut *source);
+    let mut dest = TracedStream::new(&mut *dest);
+    let signer = TracedSigner::new(c2pa_signer.signer.as_ref());
+    let result = sign_stream(&mut builder, &signer, &format, &mut source, &mut dest);
+    source.emit_reads(names::SIGN_READ_SOURCE);
+    dest.emit_writes(names::SIGN_WRITE_DEST);
+    span.add_bytes(source.bytes_read());
+    metrics::add_bytes_hashed(source.bytes_read());
     let _ = Box::into_raw(c2pa_signer);
     let _ = Box::into_raw(builder);
     match result {
         Ok(manifest_bytes) => {
+            operation.complete();
             let len = manifest_bytes.len() as c_int;
             if !manifest_bytes_ptr.is_null() {
                 *manifest_bytes_ptr =
@@ -741,7 +1080,159 @@ pub unsafe extern "C" fn c2pa_builder_sign(
     }
 }
 
-/// Frees a C2PA manifest returned by c2pa_builder_sign.
+/// Signs with the fastest path the format has.
+pub(crate) fn sign_stream<R, W>(
+    builder: &mut C2paBuilder,
+    signer: &dyn Signer,
+    format: &str,
+    source: &mut R,
+    dest: &mut W,
+) -> c2pa::Result<Vec<u8>>
+where
+    R: Read + Seek + Send,
+    W: Read + Write + Seek + Send,
+{
+    // JPEG and PNG with at most one store can be signed with one pass over the source
+    let spliced = if jpeg::is_jpeg(format) {
+        jpeg::sign(builder, signer, source, dest)
+    } else if png::is_png(format) {
+        png::sign(builder, signer, source, dest)
+    } else {
+        Ok(None)
+    };
+    spliced.and_then(|manifest_bytes| match manifest_bytes {
+        Some(manifest_bytes) => Ok(manifest_bytes),
+        // c2pa reads TIFF metadata in small pieces, serve them from large sequential reads
+        None if tiff::is_tiff(format) => {
+            source.rewind()?;
+            let mut source = tiff::ReadAhead::new(source);
+            builder.sign(signer, format, &mut source, dest)
+        }
+        None => {
+            source.rewind()?;
+            builder.sign(signer, format, source, dest)
+        }
+    })
+}
+
+/// Adds the source as the parent ingredient if it has a manifest store, then signs.
+///
+/// The header scan decides whether the source is a parent, so an unsigned
+/// source is only read once. A signed source is read twice, once by c2pa
+/// for the ingredient and once to sign, but the ingredient's thumbnail is
+/// reused when the builder has none, so only one thumbnail is made.
+/// The builder is left as it was, so it can sign other sources.
+fn sign_stream_with_parent<R, W>(
+    builder: &mut C2paBuilder,
+    signer: &dyn Signer,
+    format: &str,
+    source: &mut R,
+    dest: &mut W,
+) -> c2pa::Result<Vec<u8>>
+where
+    R: Read + Seek + Send,
+    W: Read + Write + Seek + Send,
+{
+    if builder.definition.ingredients.iter().any(|i| i.is_parent()) {
+        return sign_stream(builder, signer, format, source, dest);
+    }
+    let Some(ingredient) = parent::from_stream(format, source)? else {
+        return sign_stream(builder, signer, format, source, dest);
+    };
+    let ingredients = builder.definition.ingredients.len();
+    let thumbnail = builder.definition.thumbnail.clone();
+    let mut result = Ok(());
+    let mut reused = None;
+    if thumbnail.is_none() {
+        if let Some((thumbnail_format, bytes)) = parent::thumbnail(&ingredient) {
+            result = builder
+                .set_thumbnail(&thumbnail_format, &mut Cursor::new(bytes))
+                .map(|_| ());
+            reused = Some(thumbnail_format);
+        }
+    }
+    builder.add_ingredient(ingredient);
+    let result = result.and_then(|_| sign_stream(builder, signer, format, source, dest));
+    builder.definition.ingredients.truncate(ingredients);
+    if let Some(thumbnail_format) = reused {
+        // the Builder can't remove a resource, so the parent's thumbnail is
+        // replaced with nothing under the same id
+        let _ = builder.set_thumbnail(&thumbnail_format, &mut Cursor::new(Vec::new()));
+    }
+    builder.definition.thumbnail = thumbnail;
+    result
+}
+
+/// Creates and writes a signed manifest, with the source as its parent if it is signed.
+///
+/// This is c2pa_builder_sign for editing an asset in place. If the source
+/// already has a manifest store and the builder has no parent ingredient,
+/// the source is added as the parent for this sign only. Finding out reads
+/// only the headers of JPEG, PNG and TIFF sources. A signed source is read
+/// twice, once for the parent ingredient and once to sign.
+///
+/// # Parameters
+/// * builder_ptr: pointer to a Builder.
+/// * format: pointer to a C string with the mime type or extension.
+/// * source: pointer to a CStream.
+/// * dest: pointer to a writable CStream.
+/// * signer: pointer to a C2paSigner.
+/// * manifest_bytes_ptr: pointer to a pointer to a c_uchar to return manifest_bytes (optional, can be NULL).
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns the size of the c2pa data.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings
+/// If manifest_bytes_ptr is not NULL, the returned value MUST be released by calling c2pa_manifest_bytes_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_builder_sign_with_parent(
+    builder_ptr: *mut C2paBuilder,
+    format: *const c_char,
+    source: *mut CStream,
+    dest: *mut CStream,
+    signer: *mut C2paSigner,
+    manifest_bytes_ptr: *mut *const c_uchar,
+) -> c_int {
+    null_check_int!(builder_ptr);
+    null_check_int!(source);
+    null_check_int!(dest);
+    null_check_int!(signer);
+    let format = from_cstr_null_check_int!(format);
+
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::BUILDER_SIGN_WITH_PARENT);
+    let operation = Operation::begin(Kind::Sign);
+    let mut source = TracedStream::new(&mut *source);
+    let mut dest = TracedStream::new(&mut *dest);
+    let signer = TracedSigner::new((*signer).signer.as_ref());
+    let result =
+        sign_stream_with_parent(&mut *builder_ptr, &signer, &format, &mut source, &mut dest);
+    source.emit_reads(names::SIGN_READ_SOURCE);
+    dest.emit_writes(names::SIGN_WRITE_DEST);
+    span.add_bytes(source.bytes_read());
+    metrics::add_bytes_hashed(source.bytes_read());
+    match result {
+        Ok(manifest_bytes) => {
+            operation.complete();
+            let len = manifest_bytes.len() as c_int;
+            if !manifest_bytes_ptr.is_null() {
+                *manifest_bytes_ptr =
+                    Box::into_raw(manifest_bytes.into_boxed_slice()) as *const c_uchar;
+            }
+            len
+        }
+        Err(err) => {
+            Error::from_c2pa_error(err).set_last();
+            -1
+        }
+    }
+}
+
+/// Frees a C2PA manifest returned by c2pa_builder_sign, or CBOR returned by
+/// c2pa_reader_cbor.
 ///
 /// # Safety
 /// The bytes can only be freed once and are invalid after this call.
@@ -780,6 +1271,7 @@ pub unsafe extern "C" fn c2pa_builder_data_hashed_placeholder(
     null_check_int!(manifest_bytes_ptr);
     let mut builder: Box<C2paBuilder> = Box::from_raw(builder_ptr);
     let format = from_cstr_null_check_int!(format);
+    let _alloc = alloc_stats::Scope::new();
     let result = builder.data_hashed_placeholder(reserved_size, &format);
     let _ = Box::into_raw(builder);
     match result {
@@ -828,6 +1320,9 @@ pub unsafe extern "C" fn c2pa_builder_sign_data_hashed_embeddable(
     null_check_int!(builder_ptr);
     null_check_int!(manifest_bytes_ptr);
 
+    let _alloc = alloc_stats::Scope::new();
+    let _span = Span::new(names::BUILDER_SIGN_DATA_HASHED);
+    let operation = Operation::begin(Kind::Sign);
     let mut builder: Box<C2paBuilder> = Box::from_raw(builder_ptr);
     let c2pa_signer = Box::from_raw(signer);
     let data_hash_json = from_cstr_null_check_int!(data_hash);
@@ -840,7 +1335,13 @@ pub unsafe extern "C" fn c2pa_builder_sign_data_hashed_embeddable(
     };
     if !asset.is_null() {
         // calc hashes from the asset stream
-        match data_hash.gen_hash_from_stream(&mut *asset) {
+        let mut span = Span::new(names::SIGN_HASH);
+        let mut asset = TracedStream::new(&mut *asset);
+        let result = data_hash.gen_hash_from_stream(&mut asset);
+        span.add_bytes(asset.bytes_read());
+        metrics::add_bytes_hashed(asset.bytes_read());
+        drop(span);
+        match result {
             Ok(_) => {}
             Err(err) => {
                 Error::from_c2pa_error(err).set_last();
@@ -849,12 +1350,93 @@ pub unsafe extern "C" fn c2pa_builder_sign_data_hashed_embeddable(
         }
     }
     let format = from_cstr_null_check_int!(format);
-    let result =
-        builder.sign_data_hashed_embeddable(c2pa_signer.signer.as_ref(), &data_hash, &format);
+    let result = builder.sign_data_hashed_embeddable(
+        &TracedSigner::new(c2pa_signer.signer.as_ref()),
+        &data_hash,
+        &format,
+    );
     let _ = Box::into_raw(c2pa_signer);
     let _ = Box::into_raw(builder);
     match result {
         Ok(manifest_bytes) => {
+            operation.complete();
+            let len = manifest_bytes.len() as c_int;
+            *manifest_bytes_ptr =
+                Box::into_raw(manifest_bytes.into_boxed_slice()) as *const c_uchar;
+            len
+        }
+        Err(err) => {
+            Error::from_c2pa_error(err).set_last();
+            -1
+        }
+    }
+}
+
+/// Signs a Builder as a sidecar manifest without writing the asset.
+///
+/// The source is read once, to hash all of it, and nothing is copied.
+/// The result is the manifest store for a .c2pa sidecar file, which binds
+/// to the unmodified source with a data hash. No thumbnail is generated,
+/// add one as a resource if it is wanted.
+///
+/// # Parameters
+/// * builder_ptr: pointer to a Builder.
+/// * format: pointer to a C string with the mime type or extension of the source.
+/// * source: pointer to a CStream.
+/// * signer: pointer to a C2paSigner.
+/// * manifest_bytes_ptr: pointer to a pointer to a c_uchar to return manifest_bytes.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns the size of the manifest_bytes.
+/// BMFF formats such as MP4 are not supported, since they need a BMFF hash;
+/// use c2pa_builder_set_no_embed and c2pa_builder_sign for those.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// The returned value MUST be released by calling c2pa_manifest_bytes_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_builder_sign_sidecar(
+    builder_ptr: *mut C2paBuilder,
+    format: *const c_char,
+    source: *mut CStream,
+    signer: *mut C2paSigner,
+    manifest_bytes_ptr: *mut *const c_uchar,
+) -> c_int {
+    null_check_int!(builder_ptr);
+    null_check_int!(source);
+    null_check_int!(signer);
+    null_check_int!(manifest_bytes_ptr);
+    let format = from_cstr_null_check_int!(format);
+    if merkle::is_bmff(&format) {
+        Error::NotSupported(format!("sidecar signing of {format}")).set_last();
+        return -1;
+    }
+
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::BUILDER_SIGN_SIDECAR);
+    let operation = Operation::begin(Kind::Sign);
+    let builder = &mut *builder_ptr;
+    let signer = TracedSigner::new((*signer).signer.as_ref());
+    let mut source = TracedStream::new(&mut *source);
+
+    // data_hashed_placeholder adds a DataHash assertion, which must not
+    // leak into later signs with this builder
+    let assertions = builder.definition.assertions.len();
+    let result = builder
+        .data_hashed_placeholder(signer.reserve_size(), "c2pa")
+        .and_then(|_| {
+            let mut data_hash = DataHash::new("jumbf manifest", "sha256");
+            data_hash.gen_hash_from_stream(&mut source)?;
+            builder.sign_data_hashed_embeddable(&signer, &data_hash, "c2pa")
+        });
+    builder.definition.assertions.truncate(assertions);
+    span.add_bytes(source.bytes_read());
+    metrics::add_bytes_hashed(source.bytes_read());
+    match result {
+        Ok(manifest_bytes) => {
+            operation.complete();
             let len = manifest_bytes.len() as c_int;
             *manifest_bytes_ptr =
                 Box::into_raw(manifest_bytes.into_boxed_slice()) as *const c_uchar;
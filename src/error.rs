@@ -118,6 +118,7 @@ impl Error {
 
     /// Sets the last error
     pub fn set_last(self) {
+        crate::metrics::record_error(&self);
         LAST_ERROR.with(|prev| *prev.borrow_mut() = Some(self));
     }
 
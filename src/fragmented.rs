@@ -0,0 +1,437 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Incremental signing of fragmented MP4 while it is recorded.
+//!
+//! A session keeps the init segment and a Merkle tree with one leaf per
+//! media fragment. Each fragment is hashed once as it is added. Signing
+//! embeds a manifest in the init segment with an assertion that commits to
+//! every fragment so far, so a manifest can be emitted after any fragment
+//! without going back over the recording.
+//!
+//! c2pa validates the init segment but does not know the assertion, so the
+//! fragments are only checked by c2pa_reader_verify_fragments.
+
+use std::{
+    io::{self, Cursor, Read, Write},
+    os::raw::{c_char, c_int, c_uchar},
+};
+
+use c2pa::{Builder as C2paBuilder, Reader as C2paReader, Signer};
+use serde::{Deserialize, Serialize};
+use sha2::{Digest, Sha256};
+
+use crate::{
+    alloc_stats,
+    c_api::C2paSigner,
+    c_stream::CStream,
+    from_cstr_null_check,
+    merkle::{hex, MerkleAccumulator},
+    metrics::{self, Kind, Operation},
+    null_check, null_check_int,
+    trace::{names, Span, TracedSigner},
+    Error, Result,
+};
+
+/// The label of the assertion that commits to the fragments.
+pub const FRAGMENTS_LABEL: &str = "org.contentauth.fragments";
+
+const READ_BUFFER_SIZE: usize = 256 * 1024;
+
+#[derive(Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+struct FragmentsAssertion {
+    alg: String,
+    /// The hash of the unsigned init segment.
+    init_hash: String,
+    /// The number of fragments.
+    count: u64,
+    /// The total size of the fragments.
+    length: u64,
+    /// The Merkle root over the hash of each fragment, in order.
+    root: String,
+    /// The roots of the complete subtrees, so the tree can be extended.
+    peaks: Vec<String>,
+}
+
+/// Signs a fragmented MP4 as its fragments are recorded.
+pub struct C2paFragmentedSession {
+    // a snapshot of the builder, restored for each sign
+    archive: Vec<u8>,
+    format: String,
+    init: Vec<u8>,
+    init_hash: [u8; 32],
+    fragments: MerkleAccumulator,
+    length: u64,
+}
+
+impl C2paFragmentedSession {
+    /// Starts a session from a builder and the init segment of the recording.
+    ///
+    /// Later changes to the builder do not affect the session.
+    pub fn new<R: Read>(builder: &mut C2paBuilder, format: &str, mut init: R) -> Result<Self> {
+        let mut init_bytes = Vec::new();
+        init.read_to_end(&mut init_bytes)
+            .map_err(|e| Error::Io(e.to_string()))?;
+        if init_bytes.get(4..8) != Some(b"ftyp".as_slice()) {
+            return Err(Error::NotSupported(
+                "the init segment must start with an ftyp box".to_string(),
+            ));
+        }
+        let mut archive = Cursor::new(Vec::new());
+        builder
+            .to_archive(&mut archive)
+            .map_err(Error::from_c2pa_error)?;
+        Ok(Self {
+            archive: archive.into_inner(),
+            format: format.to_string(),
+            init_hash: Sha256::digest(&init_bytes).into(),
+            init: init_bytes,
+            fragments: MerkleAccumulator::default(),
+            length: 0,
+        })
+    }
+
+    /// Hashes the next fragment and returns the number of fragments so far.
+    pub fn add_fragment<R: Read>(&mut self, fragment: R) -> Result<u64> {
+        let mut span = Span::new(names::FRAGMENTS_ADD);
+        let (hash, length) = hash_fragment(fragment)?;
+        self.fragments.push(hash);
+        self.length += length;
+        span.add_bytes(length);
+        Ok(self.fragments.count())
+    }
+
+    /// Writes the init segment with a manifest covering every fragment so far.
+    ///
+    /// Returns the manifest bytes, as Builder::sign does.
+    pub fn sign<W: Read + Write + io::Seek + Send>(
+        &self,
+        signer: &dyn Signer,
+        dest: &mut W,
+    ) -> Result<Vec<u8>> {
+        let mut builder = C2paBuilder::from_archive(Cursor::new(&self.archive))
+            .map_err(Error::from_c2pa_error)?;
+        builder
+            .add_assertion(FRAGMENTS_LABEL, &self.assertion())
+            .map_err(Error::from_c2pa_error)?;
+        builder
+            .sign(signer, &self.format, &mut Cursor::new(&self.init), dest)
+            .map_err(Error::from_c2pa_error)
+    }
+
+    fn assertion(&self) -> FragmentsAssertion {
+        FragmentsAssertion {
+            alg: "sha256".to_string(),
+            init_hash: hex(&self.init_hash),
+            count: self.fragments.count(),
+            length: self.length,
+            root: hex(&self.fragments.root()),
+            peaks: self.fragments.peaks().map(|peak| hex(peak)).collect(),
+        }
+    }
+}
+
+// Hashes one fragment, returning its hash and length.
+fn hash_fragment<R: Read>(mut fragment: R) -> Result<([u8; 32], u64)> {
+    let mut hasher = Sha256::new();
+    let mut buffer = vec![0u8; READ_BUFFER_SIZE];
+    let mut length = 0;
+    loop {
+        let len = match fragment.read(&mut buffer) {
+            Ok(0) => break,
+            Ok(len) => len,
+            Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+            Err(e) => return Err(Error::Io(e.to_string())),
+        };
+        hasher.update(&buffer[..len]);
+        length += len as u64;
+    }
+    metrics::add_bytes_hashed(length);
+    Ok((hasher.finalize().into(), length))
+}
+
+// Returns true if the fragments are the ones the assertion commits to.
+fn matches<R: Read>(
+    assertion: &FragmentsAssertion,
+    fragments: impl IntoIterator<Item = R>,
+) -> Result<bool> {
+    if assertion.alg != "sha256" {
+        return Err(Error::NotSupported(format!(
+            "fragment hash algorithm {}",
+            assertion.alg
+        )));
+    }
+    let mut tree = MerkleAccumulator::default();
+    let mut length = 0;
+    for fragment in fragments {
+        let (hash, len) = hash_fragment(fragment)?;
+        tree.push(hash);
+        length += len;
+    }
+    Ok(tree.count() == assertion.count
+        && length == assertion.length
+        && hex(&tree.root()) == assertion.root)
+}
+
+/// Returns true if fragments match the fragments assertion of a Reader.
+pub(crate) fn verify<R: Read>(
+    reader: &C2paReader,
+    fragments: impl IntoIterator<Item = R>,
+) -> Result<bool> {
+    let manifest = reader
+        .active_manifest()
+        .ok_or_else(|| Error::ManifestNotFound("active".to_string()))?;
+    let assertion: FragmentsAssertion = manifest
+        .find_assertion(FRAGMENTS_LABEL)
+        .map_err(|_| Error::AssertionNotFound(FRAGMENTS_LABEL.to_string()))?;
+    matches(&assertion, fragments)
+}
+
+/// Starts signing a fragmented MP4 recording.
+///
+/// The session takes a snapshot of the builder, so the builder may be
+/// changed or freed afterwards.
+///
+/// # Parameters
+/// * builder_ptr: pointer to a Builder.
+/// * format: pointer to a C string with the mime type or extension.
+/// * init: pointer to a CStream with the init segment.
+///
+/// # Errors
+/// Returns NULL if there were errors, otherwise returns a pointer to a session.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// The returned value MUST be released by calling c2pa_fragmented_session_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_fragmented_session_new(
+    builder_ptr: *mut C2paBuilder,
+    format: *const c_char,
+    init: *mut CStream,
+) -> *mut C2paFragmentedSession {
+    null_check!(builder_ptr);
+    null_check!(init);
+    let format = from_cstr_null_check!(format);
+
+    let _alloc = alloc_stats::Scope::new();
+    match C2paFragmentedSession::new(&mut *builder_ptr, &format, &mut *init) {
+        Ok(session) => Box::into_raw(Box::new(session)),
+        Err(err) => {
+            err.set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Hashes the next fragment of a recording.
+///
+/// Fragments must be added in the order they appear in the file.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns the number of fragments
+/// added so far.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// session_ptr must be a valid pointer returned by c2pa_fragmented_session_new.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_fragmented_session_add_fragment(
+    session_ptr: *mut C2paFragmentedSession,
+    fragment: *mut CStream,
+) -> i64 {
+    null_check_int!(session_ptr);
+    null_check_int!(fragment);
+    match (*session_ptr).add_fragment(&mut *fragment) {
+        Ok(count) => count as i64,
+        Err(err) => {
+            err.set_last();
+            -1
+        }
+    }
+}
+
+/// Writes the signed init segment for the fragments added so far.
+///
+/// This may be called after any fragment, each call makes a complete
+/// manifest that replaces the previous one.
+///
+/// # Parameters
+/// * session_ptr: pointer to a session.
+/// * signer: pointer to a C2paSigner.
+/// * dest: pointer to a writable CStream for the signed init segment.
+/// * manifest_bytes_ptr: pointer to a pointer to the manifest bytes.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns the size of the manifest.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// The returned manifest bytes MUST be released by calling c2pa_manifest_bytes_free
+/// and are no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_fragmented_session_sign(
+    session_ptr: *mut C2paFragmentedSession,
+    signer: *mut C2paSigner,
+    dest: *mut CStream,
+    manifest_bytes_ptr: *mut *const c_uchar,
+) -> c_int {
+    null_check_int!(session_ptr);
+    null_check_int!(signer);
+    null_check_int!(dest);
+
+    let _alloc = alloc_stats::Scope::new();
+    let _span = Span::new(names::FRAGMENTS_SIGN);
+    let operation = Operation::begin(Kind::Sign);
+    let signer = TracedSigner::new((*signer).signer.as_ref());
+    match (*session_ptr).sign(&signer, &mut *dest) {
+        Ok(manifest_bytes) => {
+            operation.complete();
+            let len = manifest_bytes.len() as c_int;
+            if !manifest_bytes_ptr.is_null() {
+                *manifest_bytes_ptr =
+                    Box::into_raw(manifest_bytes.into_boxed_slice()) as *const c_uchar;
+            }
+            len
+        }
+        Err(err) => {
+            err.set_last();
+            -1
+        }
+    }
+}
+
+/// Checks the fragments of a recording against a Reader of its init segment.
+///
+/// Reading the init segment validates its manifest, but not the fragments
+/// its fragments assertion commits to. This hashes the fragments and
+/// compares their count, total length and Merkle root with the assertion.
+///
+/// # Parameters
+/// * reader_ptr: pointer to a Reader of the signed init segment.
+/// * fragments: pointer to an array of count CStream pointers, in order.
+/// * count: the number of fragments.
+///
+/// # Errors
+/// Returns -1 if there were errors, including when the active manifest has
+/// no fragments assertion, otherwise returns 1 if the fragments match and 0
+/// if they do not.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// fragments must point to at least count elements.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_verify_fragments(
+    reader_ptr: *mut C2paReader,
+    fragments: *const *mut CStream,
+    count: usize,
+) -> c_int {
+    null_check_int!(reader_ptr);
+    if count > 0 {
+        null_check_int!(fragments);
+    }
+    let streams = if count > 0 {
+        std::slice::from_raw_parts(fragments, count)
+    } else {
+        &[]
+    };
+    if streams.iter().any(|stream| stream.is_null()) {
+        Error::NullParameter("fragments".to_string()).set_last();
+        return -1;
+    }
+
+    let _alloc = alloc_stats::Scope::new();
+    let _span = Span::new(names::FRAGMENTS_VERIFY);
+    match verify(&*reader_ptr, streams.iter().map(|stream| &mut **stream)) {
+        Ok(matched) => matched as c_int,
+        Err(err) => {
+            err.set_last();
+            -1
+        }
+    }
+}
+
+/// Frees a session allocated by Rust.
+///
+/// # Safety
+/// The session can only be freed once and is invalid after this call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_fragmented_session_free(session_ptr: *mut C2paFragmentedSession) {
+    if !session_ptr.is_null() {
+        drop(Box::from_raw(session_ptr));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn init_segment() -> Vec<u8> {
+        let mut init = 16u32.to_be_bytes().to_vec();
+        init.extend_from_slice(b"ftypiso6\0\0\0\0");
+        init
+    }
+
+    #[test]
+    fn test_fragments_extend_the_tree() {
+        let mut builder = C2paBuilder::default();
+        let mut session =
+            C2paFragmentedSession::new(&mut builder, "mp4", init_segment().as_slice()).unwrap();
+        let fragments: Vec<Vec<u8>> = (0..5u8).map(|i| vec![i; 1000 + i as usize]).collect();
+        for (i, fragment) in fragments.iter().enumerate() {
+            assert_eq!(
+                session.add_fragment(fragment.as_slice()).unwrap(),
+                i as u64 + 1
+            );
+        }
+
+        let mut all = MerkleAccumulator::default();
+        for fragment in &fragments {
+            all.push(Sha256::digest(fragment).into());
+        }
+        let assertion = session.assertion();
+        assert_eq!(assertion.count, 5);
+        assert_eq!(assertion.length, 5010);
+        assert_eq!(assertion.root, hex(&all.root()));
+        assert_eq!(assertion.peaks.len(), 2);
+        assert_eq!(assertion.init_hash, hex(&Sha256::digest(init_segment())));
+    }
+
+    #[test]
+    fn test_matches_checks_every_fragment() {
+        let mut builder = C2paBuilder::default();
+        let mut session =
+            C2paFragmentedSession::new(&mut builder, "mp4", init_segment().as_slice()).unwrap();
+        let mut fragments: Vec<Vec<u8>> = (0..3u8).map(|i| vec![i; 500]).collect();
+        for fragment in &fragments {
+            session.add_fragment(fragment.as_slice()).unwrap();
+        }
+        // as it is read back from the manifest
+        let json = serde_json::to_string(&session.assertion()).unwrap();
+        let assertion: FragmentsAssertion = serde_json::from_str(&json).unwrap();
+        assert!(matches(&assertion, fragments.iter().map(|f| f.as_slice())).unwrap());
+        assert!(!matches(&assertion, fragments[..2].iter().map(|f| f.as_slice())).unwrap());
+
+        fragments[1][100] ^= 1;
+        assert!(!matches(&assertion, fragments.iter().map(|f| f.as_slice())).unwrap());
+    }
+
+    #[test]
+    fn test_init_segment_must_be_bmff() {
+        let mut builder = C2paBuilder::default();
+        let result = C2paFragmentedSession::new(&mut builder, "mp4", b"not an mp4".as_slice());
+        assert!(matches!(result, Err(Error::NotSupported(_))));
+    }
+}
@@ -0,0 +1,241 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Walking the ingredient graph of a Reader one node at a time.
+//!
+//! c2pa_reader_json serializes every manifest in the store, with all their
+//! ingredients, in one string. These functions address a single ingredient
+//! by the label of the manifest that holds it and its index there, so a
+//! caller can show the first level of the graph and only serialize nested
+//! manifests when they are expanded. The manifest an ingredient was made
+//! from is another manifest in the same store, named by its label.
+
+use std::os::raw::{c_char, c_int};
+
+use c2pa::{Ingredient, Manifest, Reader as C2paReader};
+
+use crate::{
+    alloc_stats,
+    c_api::to_c_string,
+    from_cstr_option, null_check, null_check_int,
+    trace::{names, Span},
+    Error, Result,
+};
+
+/// Returns the manifest with the label, or the active manifest for None.
+fn manifest<'a>(reader: &'a C2paReader, label: Option<&str>) -> Result<&'a Manifest> {
+    let manifest = match label {
+        Some(label) => reader.get_manifest(label),
+        None => reader.active_manifest(),
+    };
+    manifest.ok_or_else(|| Error::ManifestNotFound(label.unwrap_or("active").to_string()))
+}
+
+fn ingredient<'a>(
+    reader: &'a C2paReader,
+    label: Option<&str>,
+    index: usize,
+) -> Result<&'a Ingredient> {
+    manifest(reader, label)?
+        .ingredients()
+        .get(index)
+        .ok_or_else(|| Error::Other(format!("no ingredient at index {index}")))
+}
+
+/// Returns the label of the active manifest.
+///
+/// # Parameters
+/// * reader_ptr: pointer to a Reader.
+///
+/// # Errors
+/// Returns NULL if there were errors, otherwise returns the label.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// The returned value MUST be released by calling c2pa_string_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_active_label(reader_ptr: *mut C2paReader) -> *mut c_char {
+    null_check!(reader_ptr);
+    match (*reader_ptr).active_label() {
+        Some(label) => to_c_string(label.to_string()),
+        None => {
+            Error::ManifestNotFound("active".to_string()).set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Returns the number of ingredients in a manifest.
+///
+/// # Parameters
+/// * reader_ptr: pointer to a Reader.
+/// * manifest_label: pointer to a C string with a manifest label,
+///   or NULL for the active manifest.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns the number of ingredients.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_ingredient_count(
+    reader_ptr: *mut C2paReader,
+    manifest_label: *const c_char,
+) -> c_int {
+    null_check_int!(reader_ptr);
+    let label = from_cstr_option!(manifest_label);
+    match manifest(&*reader_ptr, label.as_deref()) {
+        Ok(manifest) => manifest.ingredients().len() as c_int,
+        Err(err) => {
+            err.set_last();
+            -1
+        }
+    }
+}
+
+/// Returns the JSON of one ingredient, without the manifest it was made from.
+///
+/// # Parameters
+/// * reader_ptr: pointer to a Reader.
+/// * manifest_label: pointer to a C string with a manifest label,
+///   or NULL for the active manifest.
+/// * index: the index of the ingredient in that manifest.
+///
+/// # Errors
+/// Returns NULL if there were errors, otherwise returns a JSON string.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// The returned value MUST be released by calling c2pa_string_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_ingredient_json(
+    reader_ptr: *mut C2paReader,
+    manifest_label: *const c_char,
+    index: usize,
+) -> *mut c_char {
+    null_check!(reader_ptr);
+    let label = from_cstr_option!(manifest_label);
+    let _alloc = alloc_stats::Scope::new();
+    let mut span = Span::new(names::READER_INGREDIENT);
+    let json = ingredient(&*reader_ptr, label.as_deref(), index).and_then(|ingredient| {
+        serde_json::to_string(ingredient).map_err(|e| Error::Json(e.to_string()))
+    });
+    match json {
+        Ok(json) => {
+            span.add_bytes(json.len() as u64);
+            to_c_string(json)
+        }
+        Err(err) => {
+            err.set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Returns the label of the manifest an ingredient was made from.
+///
+/// Pass the label to the other c2pa_reader_ingredient functions to visit
+/// the ingredients of that manifest.
+///
+/// # Parameters
+/// * reader_ptr: pointer to a Reader.
+/// * manifest_label: pointer to a C string with a manifest label,
+///   or NULL for the active manifest.
+/// * index: the index of the ingredient in that manifest.
+///
+/// # Errors
+/// Returns NULL if there were errors, otherwise returns the label, which is
+/// empty if the ingredient has no manifest.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// The returned value MUST be released by calling c2pa_string_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_ingredient_manifest_label(
+    reader_ptr: *mut C2paReader,
+    manifest_label: *const c_char,
+    index: usize,
+) -> *mut c_char {
+    null_check!(reader_ptr);
+    let label = from_cstr_option!(manifest_label);
+    match ingredient(&*reader_ptr, label.as_deref(), index) {
+        Ok(ingredient) => to_c_string(ingredient.active_manifest().unwrap_or("").to_string()),
+        Err(err) => {
+            err.set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Returns the validation status of an ingredient as a JSON array.
+///
+/// The array is empty if the ingredient's manifest validated.
+///
+/// # Parameters
+/// * reader_ptr: pointer to a Reader.
+/// * manifest_label: pointer to a C string with a manifest label,
+///   or NULL for the active manifest.
+/// * index: the index of the ingredient in that manifest.
+///
+/// # Errors
+/// Returns NULL if there were errors, otherwise returns a JSON string.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// The returned value MUST be released by calling c2pa_string_free
+/// and it is no longer valid after that call.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_reader_ingredient_validation_status(
+    reader_ptr: *mut C2paReader,
+    manifest_label: *const c_char,
+    index: usize,
+) -> *mut c_char {
+    null_check!(reader_ptr);
+    let label = from_cstr_option!(manifest_label);
+    let json = ingredient(&*reader_ptr, label.as_deref(), index).and_then(|ingredient| {
+        serde_json::to_string(ingredient.validation_status().unwrap_or_default())
+            .map_err(|e| Error::Json(e.to_string()))
+    });
+    match json {
+        Ok(json) => to_c_string(json),
+        Err(err) => {
+            err.set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::fs::File;
+
+    use super::*;
+
+    #[test]
+    fn test_unknown_manifest_label() {
+        let mut file =
+            File::open(concat!(env!("CARGO_MANIFEST_DIR"), "/tests/fixtures/C.jpg")).unwrap();
+        let reader = C2paReader::from_stream("image/jpeg", &mut file).unwrap();
+        assert!(matches!(
+            ingredient(&reader, Some("urn:uuid:missing"), 0),
+            Err(Error::ManifestNotFound(_))
+        ));
+    }
+}
@@ -0,0 +1,238 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Eager initialization, so the first request in a process is not slower.
+//!
+//! The first read and sign in a process pay for the lazy statics behind the
+//! format handlers, and the first sign and validation for the crypto
+//! library, the thumbnail codecs and the signer's first use. c2pa has no
+//! hooks for any of that, so it is warmed the only way it can be: by
+//! reading a tiny built-in PNG and, given a signer, signing and validating
+//! it. The unsigned PNG never reaches crypto or trust code, so without a
+//! signer only the format handlers are warmed. c2pa parses the trust
+//! anchors again for every validation, so there is nothing to warm there.
+
+use std::{
+    io::Cursor,
+    os::raw::{c_char, c_int},
+    time::Instant,
+};
+
+use c2pa::{Builder as C2paBuilder, Reader as C2paReader, Signer};
+
+use crate::{
+    alloc_stats,
+    c_api::{sign_stream, C2paSigner},
+    from_cstr_option_int, settings,
+    trace::{names, Span},
+    Error,
+};
+
+/// Set in C2paInitReport.steps when the settings were loaded.
+pub const C2PA_INIT_SETTINGS: u32 = 1;
+/// Set in C2paInitReport.steps when the format handlers were set up.
+/// This alone does not warm crypto or validation, that needs a signer.
+pub const C2PA_INIT_READER: u32 = 2;
+/// Set in C2paInitReport.steps when the signer signed the built-in image.
+pub const C2PA_INIT_SIGNER: u32 = 4;
+/// Set in C2paInitReport.steps when the signed image was validated.
+pub const C2PA_INIT_VALIDATION: u32 = 8;
+
+/// An unsigned 16x16 gray PNG.
+const WARM_UP_PNG: &[u8] = &[
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52,
+    0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x08, 0x02, 0x00, 0x00, 0x00, 0x90, 0x91, 0x68,
+    0x36, 0x00, 0x00, 0x00, 0x14, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x68, 0x20, 0x11, 0x30,
+    0x8c, 0x6a, 0x18, 0xd5, 0x30, 0x7c, 0x35, 0x00, 0x00, 0x25, 0x84, 0x80, 0x10, 0xbc, 0x6f, 0xf1,
+    0xcf, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+];
+
+const WARM_UP_MANIFEST: &str = r#"{"title": "c2pa_init.png", "format": "image/png"}"#;
+
+#[repr(C)]
+/// What c2pa_init should initialize.
+pub struct C2paInitOptions {
+    /// Settings to load, or NULL to keep the settings in effect.
+    pub settings: *const c_char,
+    /// The format of the settings, such as "json" or "toml", or NULL for json.
+    pub settings_format: *const c_char,
+    /// A signer to warm up, or NULL to skip signing and validation.
+    pub signer: *const C2paSigner,
+}
+
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+/// What c2pa_init initialized, and how long each step took.
+pub struct C2paInitReport {
+    /// The C2PA_INIT_* bits of the steps that completed.
+    pub steps: u32,
+    /// Nanoseconds spent loading the settings.
+    pub settings_ns: u64,
+    /// Nanoseconds spent setting up the format handlers.
+    pub reader_ns: u64,
+    /// Nanoseconds spent signing the built-in image.
+    pub sign_ns: u64,
+    /// Nanoseconds spent validating the signed image.
+    pub validate_ns: u64,
+}
+
+fn elapsed_ns(start: Instant) -> u64 {
+    start.elapsed().as_nanos() as u64
+}
+
+/// Runs each step, recording it in the report once it completes.
+fn init(
+    settings: Option<(&str, &str)>,
+    signer: Option<&dyn Signer>,
+    report: &mut C2paInitReport,
+) -> c2pa::Result<()> {
+    if let Some((settings, format)) = settings {
+        let start = Instant::now();
+        settings::load(settings, format)?;
+        report.settings_ns = elapsed_ns(start);
+        report.steps |= C2PA_INIT_SETTINGS;
+    }
+
+    // the image has no manifest, so this fails once the handlers are set up
+    let start = Instant::now();
+    let _ = C2paReader::from_stream("image/png", Cursor::new(WARM_UP_PNG));
+    report.reader_ns = elapsed_ns(start);
+    report.steps |= C2PA_INIT_READER;
+
+    let Some(signer) = signer else {
+        return Ok(());
+    };
+    let start = Instant::now();
+    let mut builder = C2paBuilder::from_json(WARM_UP_MANIFEST)?;
+    let mut source = Cursor::new(WARM_UP_PNG);
+    let mut dest = Cursor::new(Vec::new());
+    sign_stream(&mut builder, signer, "image/png", &mut source, &mut dest)?;
+    report.sign_ns = elapsed_ns(start);
+    report.steps |= C2PA_INIT_SIGNER;
+
+    let start = Instant::now();
+    dest.set_position(0);
+    C2paReader::from_stream("image/png", dest)?;
+    report.validate_ns = elapsed_ns(start);
+    report.steps |= C2PA_INIT_VALIDATION;
+    Ok(())
+}
+
+/// Does the one time setup of a process up front.
+///
+/// Loads the settings, sets up the format handlers and, given a signer,
+/// signs and validates a small built-in image. That sets up the crypto
+/// library, the thumbnail codecs and the signer, including a first request
+/// to its time stamp authority. Worker processes can call this before
+/// taking traffic, so their first request is as fast as later ones.
+/// Calling it again is cheap, and loading the same settings again is skipped.
+///
+/// # Parameters
+/// * options: pointer to the C2paInitOptions, or NULL to only set up reading.
+/// * report: pointer to a C2paInitReport to fill in, or NULL.
+///
+/// # Errors
+/// Returns -1 if the settings are not UTF-8 or a step failed, otherwise returns 0.
+/// The report holds the steps that completed before the failure.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// options and report must be valid pointers or NULL.
+/// The strings in options must be NULL-terminated C strings or NULL,
+/// and the signer a valid C2paSigner or NULL.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_init(
+    options: *const C2paInitOptions,
+    report: *mut C2paInitReport,
+) -> c_int {
+    if let Some(report) = report.as_mut() {
+        *report = C2paInitReport::default();
+    }
+    // settings are parsed, so they are not decoded lossily
+    let (settings, format, signer) = match options.as_ref() {
+        Some(o) => (
+            from_cstr_option_int!(o.settings),
+            from_cstr_option_int!(o.settings_format),
+            o.signer.as_ref().map(|s| s.signer.as_ref()),
+        ),
+        None => (None, None, None),
+    };
+    let format = format.unwrap_or_else(|| "json".to_string());
+
+    let _alloc = alloc_stats::Scope::new();
+    let _span = Span::new(names::INIT);
+    let mut steps = C2paInitReport::default();
+    let result = init(
+        settings.as_deref().map(|s| (s, format.as_str())),
+        signer,
+        &mut steps,
+    );
+    if let Some(report) = report.as_mut() {
+        *report = steps;
+    }
+    match result {
+        Ok(()) => 0,
+        Err(err) => {
+            Error::from_c2pa_error(err).set_last();
+            -1
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::ptr;
+
+    use super::*;
+
+    #[test]
+    fn test_init_without_options_sets_up_reading() {
+        let mut report = C2paInitReport::default();
+        assert_eq!(unsafe { c2pa_init(ptr::null(), &mut report) }, 0);
+        assert_eq!(report.steps, C2PA_INIT_READER);
+        assert_eq!(report.settings_ns, 0);
+        assert_eq!(report.sign_ns, 0);
+        assert_eq!(unsafe { c2pa_init(ptr::null(), ptr::null_mut()) }, 0);
+    }
+
+    #[test]
+    fn test_init_loads_settings() {
+        let _guard = settings::TestGuard::new();
+        let settings = std::ffi::CString::new(r#"{"verify": {"verify_trust": false}}"#).unwrap();
+        let options = C2paInitOptions {
+            settings: settings.as_ptr(),
+            settings_format: ptr::null(),
+            signer: ptr::null(),
+        };
+        let mut report = C2paInitReport::default();
+        assert_eq!(unsafe { c2pa_init(&options, &mut report) }, 0);
+        assert_eq!(report.steps, C2PA_INIT_SETTINGS | C2PA_INIT_READER);
+    }
+
+    #[test]
+    fn test_init_rejects_settings_that_are_not_utf8() {
+        let settings = std::ffi::CString::new(b"{\"verify\": \"\xff\"}".to_vec()).unwrap();
+        let options = C2paInitOptions {
+            settings: settings.as_ptr(),
+            settings_format: ptr::null(),
+            signer: ptr::null(),
+        };
+        let mut report = C2paInitReport {
+            steps: C2PA_INIT_READER,
+            ..Default::default()
+        };
+        assert_eq!(unsafe { c2pa_init(&options, &mut report) }, -1);
+        assert_eq!(report.steps, 0);
+        assert!(matches!(Error::take_last(), Some(Error::Decoding(_))));
+    }
+}
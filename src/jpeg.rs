@@ -0,0 +1,484 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! A fast path for C2PA data in JPEG files.
+//!
+//! The manifest store is JUMBF split across APP11 marker segments. Every
+//! segment before the image data carries its length, so walking the lengths
+//! reaches the APP11 segments without decoding anything else. A SIMD search
+//! for 0xFF is only needed to resync over padding or garbage between segments.
+
+use std::{
+    io::{self, BufRead, BufReader, Cursor, Read, Seek, SeekFrom, Write},
+    ops::Range,
+};
+
+use c2pa::{Builder, Reader, Signer};
+use memchr::memchr;
+
+use crate::{
+    remote,
+    splice::{self, Splice},
+};
+
+const SOI: u8 = 0xD8;
+const EOI: u8 = 0xD9;
+const SOS: u8 = 0xDA;
+const APP0: u8 = 0xE0;
+const APP1: u8 = 0xE1;
+const APP11: u8 = 0xEB;
+
+// Large enough to hold most header segments so the walk rarely calls back into the stream.
+const SCAN_BUFFER_SIZE: usize = 64 * 1024;
+
+// The first four bytes of the C2PA JUMBF type UUID, 63327061-0011-0010-8000-00AA00389B71.
+const C2PA_UUID_PREFIX: &[u8] = b"c2pa";
+
+const FORMAT: &str = "image/jpeg";
+
+/// Returns true if the format names a JPEG.
+pub(crate) fn is_jpeg(format: &str) -> bool {
+    ["image/jpeg", "jpeg", "jpg"]
+        .iter()
+        .any(|f| f.eq_ignore_ascii_case(format))
+}
+
+/// A marker segment before the image data.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub(crate) struct Segment {
+    pub marker: u8,
+    /// The offset of the 0xFF that starts the segment.
+    pub offset: u64,
+    /// The size of the segment including the marker.
+    pub len: u64,
+}
+
+// One APP11 JUMBF packet.
+struct Packet {
+    /// The index of the segment the packet came from.
+    segment: usize,
+    instance: u16,
+    sequence: u32,
+    data: Vec<u8>,
+}
+
+/// The marker segments of a JPEG and any C2PA manifest stores found in them.
+#[derive(Debug, Default)]
+pub(crate) struct Layout {
+    pub segments: Vec<Segment>,
+    pub stores: Vec<Vec<u8>>,
+    /// The bytes of the APP11 segments that hold each store.
+    pub store_ranges: Vec<Range<u64>>,
+}
+
+impl Layout {
+    /// Returns the offset where new APP11 segments are inserted.
+    ///
+    /// This is after any leading APP0 (JFIF) and APP1 (Exif) segments,
+    /// which readers expect to come straight after the start of image.
+    pub fn insert_offset(&self) -> u64 {
+        self.segments
+            .iter()
+            .skip_while(|s| s.marker == SOI)
+            .take_while(|s| s.marker == APP0 || s.marker == APP1)
+            .last()
+            .or_else(|| self.segments.first())
+            .map(|s| s.offset + s.len)
+            .unwrap_or(2)
+    }
+}
+
+/// Walks the marker segments of a JPEG stream up to the image data.
+///
+/// Returns None if the stream does not start with a JPEG start of image marker.
+pub(crate) fn scan<R: Read + Seek>(stream: &mut R) -> io::Result<Option<Layout>> {
+    stream.seek(SeekFrom::Start(0))?;
+    let mut reader = BufReader::with_capacity(SCAN_BUFFER_SIZE, stream);
+    let mut soi = [0u8; 2];
+    if reader.read_exact(&mut soi).is_err() || soi != [0xFF, SOI] {
+        return Ok(None);
+    }
+    let mut layout = Layout::default();
+    layout.segments.push(Segment {
+        marker: SOI,
+        offset: 0,
+        len: 2,
+    });
+    let packets = walk(&mut reader, 2, &mut layout.segments)?;
+    for (jumbf, segments) in reassemble(packets) {
+        let segments = segments.iter().map(|&i| &layout.segments[i]);
+        let start = segments.clone().map(|s| s.offset).min().unwrap_or(0);
+        let end = segments.map(|s| s.offset + s.len).max().unwrap_or(0);
+        layout.stores.push(jumbf);
+        layout.store_ranges.push(start..end);
+    }
+    Ok(Some(layout))
+}
+
+/// Reassembles the manifest store from a run of APP11 segments.
+pub(crate) fn jumbf_from_segments(segments: &[u8]) -> io::Result<Vec<u8>> {
+    let mut found = Vec::new();
+    let packets = walk(&mut BufReader::new(Cursor::new(segments)), 0, &mut found)?;
+    reassemble(packets)
+        .into_iter()
+        .next()
+        .map(|(jumbf, _)| jumbf)
+        .ok_or_else(|| io::Error::new(io::ErrorKind::InvalidData, "no C2PA APP11 segments"))
+}
+
+// Records each segment until the image data and returns the APP11 JUMBF packets.
+fn walk<R: Read + Seek>(
+    reader: &mut BufReader<R>,
+    mut pos: u64,
+    segments: &mut Vec<Segment>,
+) -> io::Result<Vec<Packet>> {
+    let mut packets = Vec::new();
+    while let Some(marker) = next_marker(reader, &mut pos)? {
+        let offset = pos - 2;
+        match marker {
+            SOS | EOI => break,
+            // standalone markers have no length
+            0x01 | 0xD0..=0xD7 => {
+                segments.push(Segment {
+                    marker,
+                    offset,
+                    len: 2,
+                });
+                continue;
+            }
+            _ => {}
+        }
+        let mut len = [0u8; 2];
+        reader.read_exact(&mut len)?;
+        let len = u16::from_be_bytes(len) as u64;
+        if len < 2 {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidData,
+                "invalid JPEG segment length",
+            ));
+        }
+        let body = len - 2;
+        if marker == APP11 && body >= 8 {
+            let mut data = vec![0u8; body as usize];
+            reader.read_exact(&mut data)?;
+            if let Some(mut packet) = parse_packet(data) {
+                packet.segment = segments.len();
+                packets.push(packet);
+            }
+        } else {
+            // keeps the buffer when the next segment is already in it
+            reader.seek_relative(body as i64)?;
+        }
+        segments.push(Segment {
+            marker,
+            offset,
+            len: len + 2,
+        });
+        pos = offset + len + 2;
+    }
+    Ok(packets)
+}
+
+// Finds the next marker, skipping fill bytes and anything that is not a marker.
+fn next_marker<R: BufRead>(reader: &mut R, pos: &mut u64) -> io::Result<Option<u8>> {
+    let mut after_ff = false;
+    loop {
+        let buf = reader.fill_buf()?;
+        if buf.is_empty() {
+            return Ok(None);
+        }
+        if !after_ff {
+            // segments normally follow each other, so this usually finds 0xFF at index 0
+            let skip = match memchr(0xFF, buf) {
+                Some(index) => {
+                    after_ff = true;
+                    index + 1
+                }
+                None => buf.len(),
+            };
+            reader.consume(skip);
+            *pos += skip as u64;
+            continue;
+        }
+        let byte = buf[0];
+        reader.consume(1);
+        *pos += 1;
+        match byte {
+            0xFF => {}                // fill byte
+            0x00 => after_ff = false, // stuffed zero, not a marker
+            marker => return Ok(Some(marker)),
+        }
+    }
+}
+
+// Parses the JPEG XT box header of an APP11 segment.
+fn parse_packet(mut data: Vec<u8>) -> Option<Packet> {
+    if &data[0..2] != b"JP" {
+        return None;
+    }
+    let instance = u16::from_be_bytes([data[2], data[3]]);
+    let sequence = u32::from_be_bytes([data[4], data[5], data[6], data[7]]);
+    data.drain(0..8);
+    Some(Packet {
+        segment: 0,
+        instance,
+        sequence,
+        data,
+    })
+}
+
+// Joins packets into JUMBF boxes and keeps the C2PA manifest stores,
+// each with the indexes of the segments it came from.
+fn reassemble(mut packets: Vec<Packet>) -> Vec<(Vec<u8>, Vec<usize>)> {
+    packets.sort_by_key(|p| (p.instance, p.sequence));
+    let mut stores = Vec::new();
+    let mut current: Option<(u16, Vec<u8>, Vec<usize>)> = None;
+    for packet in packets {
+        match current.as_mut() {
+            Some((instance, jumbf, segments)) if *instance == packet.instance => {
+                // each continuation repeats the box header, which is 16 bytes with an XLBox
+                let header = if packet.data.starts_with(&[0, 0, 0, 1]) {
+                    16
+                } else {
+                    8
+                };
+                if packet.data.len() > header {
+                    jumbf.extend_from_slice(&packet.data[header..]);
+                }
+                segments.push(packet.segment);
+            }
+            _ => {
+                if let Some((_, jumbf, segments)) = current.take() {
+                    stores.push((jumbf, segments));
+                }
+                current = Some((packet.instance, packet.data, vec![packet.segment]));
+            }
+        }
+    }
+    if let Some((_, jumbf, segments)) = current {
+        stores.push((jumbf, segments));
+    }
+    stores.retain(|(jumbf, _)| is_c2pa_store(jumbf));
+    stores
+}
+
+/// Checks for a jumb superbox whose description box has the C2PA type.
+pub(crate) fn is_c2pa_store(jumbf: &[u8]) -> bool {
+    let header = if jumbf.starts_with(&[0, 0, 0, 1]) {
+        16
+    } else {
+        8
+    };
+    // superbox header, then the jumd box header, then its type UUID
+    let uuid = header + 8;
+    jumbf.len() >= uuid + 16
+        && &jumbf[4..8] == b"jumb"
+        && &jumbf[header + 4..header + 8] == b"jumd"
+        && &jumbf[uuid..uuid + 4] == C2PA_UUID_PREFIX
+}
+
+/// Creates a Reader from a JPEG, handing c2pa the manifest store found by scan.
+///
+/// Without an embedded store, a remote manifest referenced from XMP is read
+/// through the fetch callback and cache when they are set. Falls back to
+/// the general parser otherwise.
+pub(crate) fn read<R: Read + Seek + Send>(format: &str, stream: &mut R) -> c2pa::Result<Reader> {
+    let layout = scan(stream)?;
+    stream.seek(SeekFrom::Start(0))?;
+    match layout {
+        Some(layout) if layout.stores.len() == 1 => {
+            Reader::from_manifest_data_and_stream(&layout.stores[0], format, stream)
+        }
+        Some(layout) if layout.stores.is_empty() => {
+            remote::read(format, stream).unwrap_or_else(|| Reader::from_stream(format, stream))
+        }
+        _ => Reader::from_stream(format, stream),
+    }
+}
+
+/// Returns true if only APP11 segments lie in the range, so it can be cut out.
+fn only_app11(layout: &Layout, range: &Range<u64>) -> bool {
+    layout
+        .segments
+        .iter()
+        .filter(|s| range.contains(&s.offset))
+        .all(|s| s.marker == APP11)
+}
+
+/// Signs a JPEG by splicing the manifest into one copy of the source.
+///
+/// A manifest store the source already has is replaced where it is.
+/// Returns None, having written nothing, if the source has more than one
+/// store, its store is interleaved with other segments, or the builder
+/// needs Builder::sign.
+/// Otherwise returns the manifest store bytes, as Builder::sign does.
+pub(crate) fn sign<R, W>(
+    builder: &mut Builder,
+    signer: &dyn Signer,
+    source: &mut R,
+    dest: &mut W,
+) -> c2pa::Result<Option<Vec<u8>>>
+where
+    R: Read + Seek,
+    W: Write + Seek,
+{
+    let layout = match scan(source)? {
+        Some(layout) if layout.stores.len() <= 1 && splice::can_splice(builder) => layout,
+        _ => return Ok(None),
+    };
+    // a signed source has its old store replaced in place
+    let splice = match layout.store_ranges.first() {
+        Some(range) if only_app11(&layout, range) => Splice {
+            format: FORMAT,
+            offset: range.start,
+            remove: range.end - range.start,
+        },
+        Some(_) => return Ok(None),
+        None => Splice {
+            format: FORMAT,
+            offset: layout.insert_offset(),
+            remove: 0,
+        },
+    };
+    // c2pa already wraps the manifest in APP11 segments
+    let segments = splice::sign(
+        builder,
+        signer,
+        &splice,
+        |bytes| bytes.to_vec(),
+        source,
+        dest,
+    )?;
+    Ok(Some(jumbf_from_segments(&segments)?))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // a minimal C2PA superbox, the content after the description box is never parsed
+    fn c2pa_jumbf(content_len: usize) -> Vec<u8> {
+        let mut jumd = Vec::new();
+        jumd.extend_from_slice(&[0, 0, 0, 0]);
+        jumd.extend_from_slice(b"jumd");
+        jumd.extend_from_slice(b"c2pa");
+        jumd.extend_from_slice(&[0x00, 0x11, 0x00, 0x10, 0x80, 0x00, 0x00, 0xAA]);
+        jumd.extend_from_slice(&[0x00, 0x38, 0x9B, 0x71, 0x03]);
+        jumd.extend_from_slice(b"c2pa\0");
+        let jumd_len = jumd.len() as u32;
+        jumd[0..4].copy_from_slice(&jumd_len.to_be_bytes());
+
+        let mut jumbf = Vec::new();
+        let total = (8 + jumd.len() + content_len) as u32;
+        jumbf.extend_from_slice(&total.to_be_bytes());
+        jumbf.extend_from_slice(b"jumb");
+        jumbf.extend_from_slice(&jumd);
+        jumbf.extend((0..content_len).map(|i| i as u8));
+        jumbf
+    }
+
+    // splits JUMBF into APP11 segments the way writers do, repeating the box header
+    fn app11_segments(jumbf: &[u8], chunk: usize) -> Vec<u8> {
+        let mut out = Vec::new();
+        let (header, body) = jumbf.split_at(8);
+        for (index, part) in body.chunks(chunk).enumerate() {
+            let len = (2 + 8 + 8 + part.len()) as u16;
+            out.extend_from_slice(&[0xFF, APP11]);
+            out.extend_from_slice(&len.to_be_bytes());
+            out.extend_from_slice(b"JP");
+            out.extend_from_slice(&1u16.to_be_bytes());
+            out.extend_from_slice(&(index as u32 + 1).to_be_bytes());
+            out.extend_from_slice(header);
+            out.extend_from_slice(part);
+        }
+        out
+    }
+
+    fn segment(marker: u8, body: &[u8]) -> Vec<u8> {
+        let mut out = vec![0xFF, marker];
+        out.extend_from_slice(&((body.len() + 2) as u16).to_be_bytes());
+        out.extend_from_slice(body);
+        out
+    }
+
+    fn jpeg(app11: &[u8]) -> Vec<u8> {
+        let mut out = vec![0xFF, SOI];
+        out.extend(segment(APP0, b"JFIF\0\x01\x02\0\0\x01\0\x01\0\0"));
+        out.extend_from_slice(app11);
+        // padding between segments is allowed and forces a resync
+        out.extend_from_slice(&[0xFF, 0xFF, 0xFF]);
+        out.extend(segment(0xDB, &[0u8; 65]));
+        out.extend(segment(SOS, &[0u8; 10]));
+        out.extend_from_slice(&[0x12, 0xFF, 0x00, 0x34, 0xFF, EOI]);
+        out
+    }
+
+    #[test]
+    fn test_scan_reassembles_store() {
+        let jumbf = c2pa_jumbf(1000);
+        let app11 = app11_segments(&jumbf, 300);
+        let bytes = jpeg(&app11);
+        let layout = scan(&mut Cursor::new(&bytes)).unwrap().unwrap();
+
+        assert_eq!(layout.stores, vec![jumbf.clone()]);
+        let markers: Vec<u8> = layout.segments.iter().map(|s| s.marker).collect();
+        assert_eq!(markers, vec![SOI, APP0, APP11, APP11, APP11, APP11, 0xDB]);
+        assert_eq!(layout.insert_offset(), 2 + 18);
+        assert_eq!(layout.store_ranges, vec![20..20 + app11.len() as u64]);
+        assert_eq!(jumbf_from_segments(&app11).unwrap(), jumbf);
+    }
+
+    #[test]
+    fn test_only_app11() {
+        let jumbf = c2pa_jumbf(1000);
+        let app11 = app11_segments(&jumbf, 300);
+        let layout = scan(&mut Cursor::new(jpeg(&app11))).unwrap().unwrap();
+        assert!(only_app11(&layout, &layout.store_ranges[0]));
+
+        // a comment between the packets would be cut out with the old store
+        let split = 4 + 8 + 8 + 300;
+        let mut interleaved = app11[..split].to_vec();
+        interleaved.extend(segment(0xFE, b"comment"));
+        interleaved.extend_from_slice(&app11[split..]);
+        let layout = scan(&mut Cursor::new(jpeg(&interleaved))).unwrap().unwrap();
+        assert_eq!(layout.stores.len(), 1);
+        assert!(!only_app11(&layout, &layout.store_ranges[0]));
+    }
+
+    #[test]
+    fn test_scan_without_store() {
+        let bytes = jpeg(&segment(APP11, b"JP\0\x01\0\0\0\x01not jumbf"));
+        let layout = scan(&mut Cursor::new(&bytes)).unwrap().unwrap();
+        assert!(layout.stores.is_empty());
+        assert!(scan(&mut Cursor::new(b"\x89PNG")).unwrap().is_none());
+    }
+
+    #[test]
+    fn test_scan_fixtures() {
+        let signed =
+            std::fs::read(concat!(env!("CARGO_MANIFEST_DIR"), "/tests/fixtures/C.jpg")).unwrap();
+        let layout = scan(&mut Cursor::new(&signed)).unwrap().unwrap();
+        assert_eq!(layout.stores.len(), 1);
+        let store = &layout.stores[0];
+        assert_eq!(
+            u32::from_be_bytes(store[0..4].try_into().unwrap()) as usize,
+            store.len()
+        );
+
+        let unsigned =
+            std::fs::read(concat!(env!("CARGO_MANIFEST_DIR"), "/tests/fixtures/A.jpg")).unwrap();
+        let layout = scan(&mut Cursor::new(&unsigned)).unwrap().unwrap();
+        assert!(layout.stores.is_empty());
+        assert!(layout.insert_offset() > 2);
+    }
+}
@@ -10,9 +10,11 @@
 // specific language governing permissions and limitations under
 // each license.
 
+use std::{fs::File, path::Path};
+
 use c2pa::{Ingredient, Manifest, Reader};
 
-use crate::{Error, Result, SignerInfo};
+use crate::{parent, trace::TracedSigner, Error, Result, SignerInfo};
 
 /// Returns the version of the c2pa SDK used in this library
 pub fn sdk_version() -> String {
@@ -67,9 +69,17 @@ pub fn sign_file(
     }
 
     // If the source file has a manifest store, and no parent is specified, treat the source's manifest store as the parent.
-    if manifest.parent().is_none() {
+    if manifest.parent().is_none() && may_have_manifest_store(source)? {
         let source_ingredient = Ingredient::from_file(source).map_err(Error::from_c2pa_error)?;
         if source_ingredient.manifest_data().is_some() {
+            // embed would generate the same thumbnail again from the same source
+            if manifest.thumbnail_ref().is_none() {
+                if let Some((format, bytes)) = parent::thumbnail(&source_ingredient) {
+                    manifest
+                        .set_thumbnail(format, bytes)
+                        .map_err(Error::from_c2pa_error)?;
+                }
+            }
             manifest
                 .set_parent(source_ingredient)
                 .map_err(Error::from_c2pa_error)?;
@@ -79,10 +89,29 @@ pub fn sign_file(
     let signer = signer_info.signer()?;
     #[allow(deprecated)]
     manifest
-        .embed(&source, &dest, &*signer)
+        .embed(&source, &dest, &TracedSigner::new(&*signer))
         .map_err(Error::from_c2pa_error)
 }
 
+/// Returns false if a header scan shows the source has no manifest store.
+///
+/// Ingredient::from_file reads, hashes and thumbnails the whole source, and
+/// embed then does it all again, so unsigned sources skip the first pass.
+/// A sidecar manifest next to the source also makes it a parent.
+fn may_have_manifest_store(source: &str) -> Result<bool> {
+    let path = Path::new(source);
+    if path.with_extension("c2pa").exists() {
+        return Ok(true);
+    }
+    let Some(format) = path.extension().and_then(|ext| ext.to_str()) else {
+        return Ok(true);
+    };
+    let mut file = File::open(path).map_err(|e| Error::Io(e.to_string()))?;
+    let found =
+        parent::has_manifest_store(format, &mut file).map_err(|e| Error::Io(e.to_string()))?;
+    Ok(found != Some(false))
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -120,4 +149,10 @@ mod tests {
         assert!(PathBuf::from(data_dir).exists());
         assert!(json_report.contains("thumbnail"));
     }
+
+    #[test]
+    fn test_may_have_manifest_store() {
+        assert!(may_have_manifest_store(&test_path("tests/fixtures/C.jpg")).unwrap());
+        assert!(!may_have_manifest_store(&test_path("tests/fixtures/A.jpg")).unwrap());
+    }
 }
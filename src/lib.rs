@@ -10,18 +10,61 @@
 // specific language governing permissions and limitations under
 // each license.
 
+mod alloc_stats;
+mod binding;
 mod c_api;
 /// This module exports a C2PA library
 mod c_stream;
 mod error;
+mod fragmented;
+mod ingredients;
+mod init;
+mod jpeg;
 mod json_api;
+mod merkle;
+mod metrics;
+mod parent;
+mod png;
+mod remote;
+mod settings;
 mod signer_info;
+mod splice;
+mod tiff;
+mod trace;
 
+pub use alloc_stats::{c2pa_alloc_tracking_enable, c2pa_last_alloc_stats, C2paAllocStats};
+pub use binding::{
+    c2pa_compute_binding_hash, c2pa_reader_binding_hash, c2pa_verify_binding_hashes,
+};
 pub use c2pa::{
     AsyncSigner, Builder, Error as C2paError, Reader, Result as C2paResult, Signer, SigningAlg,
 };
 pub use c_api::*;
 pub use c_stream::*;
 pub use error::{Error, Result};
+pub use fragmented::{
+    c2pa_fragmented_session_add_fragment, c2pa_fragmented_session_free,
+    c2pa_fragmented_session_new, c2pa_fragmented_session_sign, c2pa_reader_verify_fragments,
+    C2paFragmentedSession,
+};
+pub use ingredients::{
+    c2pa_reader_ingredient_count, c2pa_reader_ingredient_json,
+    c2pa_reader_ingredient_manifest_label, c2pa_reader_ingredient_validation_status,
+};
+pub use init::{
+    c2pa_init, C2paInitOptions, C2paInitReport, C2PA_INIT_READER, C2PA_INIT_SETTINGS,
+    C2PA_INIT_SIGNER, C2PA_INIT_VALIDATION,
+};
 pub use json_api::{read_file, read_ingredient_file, sdk_version, sign_file};
+pub use metrics::{
+    c2pa_metrics_reset, c2pa_metrics_snapshot, C2paErrorCounts, C2paHistogram, C2paMetrics,
+    C2PA_HISTOGRAM_BUCKETS,
+};
+pub use remote::{
+    c2pa_fetch_response_write, c2pa_prefetch_remote_manifests, c2pa_set_fetch_callback,
+    c2pa_set_remote_cache, c2pa_set_remote_url_rewrite, C2paFetchResponse, FetchCallback,
+};
 pub use signer_info::SignerInfo;
+pub use trace::{
+    c2pa_set_trace_callback, c2pa_set_trace_file, c2pa_trace_stop, C2paTraceSpan, TraceCallback,
+};
@@ -0,0 +1,148 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Merkle trees of SHA-256 hashes, and helpers shared by the BMFF code.
+//!
+//! Fragmented BMFF signing hashes each fragment as a leaf as it is added,
+//! so the tree is built one leaf at a time.
+
+use sha2::{Digest, Sha256};
+
+/// Returns true if the format names a BMFF file such as MP4, MOV or HEIF.
+pub(crate) fn is_bmff(format: &str) -> bool {
+    [
+        "mp4",
+        "video/mp4",
+        "application/mp4",
+        "m4a",
+        "audio/mp4",
+        "m4v",
+        "video/x-m4v",
+        "mov",
+        "video/quicktime",
+        "heic",
+        "image/heic",
+        "heif",
+        "image/heif",
+        "avif",
+        "image/avif",
+    ]
+    .iter()
+    .any(|f| f.eq_ignore_ascii_case(format))
+}
+
+fn node(left: &[u8; 32], right: &[u8; 32]) -> [u8; 32] {
+    let mut hasher = Sha256::new();
+    hasher.update(left);
+    hasher.update(right);
+    hasher.finalize().into()
+}
+
+/// Builds a Merkle tree one leaf at a time.
+///
+/// Only the roots of the complete subtrees are kept, at most one per level,
+/// so appending a leaf and computing the root never revisit earlier leaves.
+/// The root is the same as for a tree built from all the leaves at once.
+#[derive(Debug, Clone, Default)]
+pub(crate) struct MerkleAccumulator {
+    // (height, hash) from the largest subtree down to the smallest
+    peaks: Vec<(u32, [u8; 32])>,
+    count: u64,
+}
+
+impl MerkleAccumulator {
+    pub fn push(&mut self, leaf: [u8; 32]) {
+        let mut peak = (0, leaf);
+        while let Some(&(height, left)) = self.peaks.last() {
+            if height != peak.0 {
+                break;
+            }
+            self.peaks.pop();
+            peak = (height + 1, node(&left, &peak.1));
+        }
+        self.peaks.push(peak);
+        self.count += 1;
+    }
+
+    /// Returns the number of leaves.
+    pub fn count(&self) -> u64 {
+        self.count
+    }
+
+    /// Returns the roots of the complete subtrees, largest first.
+    pub fn peaks(&self) -> impl Iterator<Item = &[u8; 32]> {
+        self.peaks.iter().map(|(_, hash)| hash)
+    }
+
+    pub fn root(&self) -> [u8; 32] {
+        let mut peaks = self.peaks.iter().rev().map(|(_, hash)| *hash);
+        match peaks.next() {
+            Some(last) => peaks.fold(last, |right, left| node(&left, &right)),
+            None => Sha256::digest([]).into(),
+        }
+    }
+}
+
+pub(crate) fn hex(bytes: &[u8]) -> String {
+    bytes.iter().map(|b| format!("{b:02x}")).collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Combines pairs of nodes level by level, an odd node is promoted unchanged.
+    fn root(leaves: &[[u8; 32]]) -> [u8; 32] {
+        let mut level = leaves.to_vec();
+        if level.is_empty() {
+            return Sha256::digest([]).into();
+        }
+        while level.len() > 1 {
+            level = level
+                .chunks(2)
+                .map(|pair| match pair {
+                    [left, right] => node(left, right),
+                    [single] => *single,
+                    _ => unreachable!(),
+                })
+                .collect();
+        }
+        level[0]
+    }
+
+    #[test]
+    fn test_accumulator_matches_root() {
+        let leaves: Vec<[u8; 32]> = (0..40u8).map(|i| [i; 32]).collect();
+        let mut accumulator = MerkleAccumulator::default();
+        assert_eq!(accumulator.root(), root(&[]));
+        for (count, leaf) in leaves.iter().enumerate() {
+            accumulator.push(*leaf);
+            assert_eq!(accumulator.root(), root(&leaves[..=count]), "{count}");
+        }
+        // 40 leaves are complete subtrees of 32 and 8
+        assert_eq!(accumulator.peaks().count(), 2);
+    }
+
+    #[test]
+    fn test_root_promotes_odd_node() {
+        let leaves = [[1u8; 32], [2u8; 32], [3u8; 32]];
+        let mut hasher = Sha256::new();
+        hasher.update(leaves[0]);
+        hasher.update(leaves[1]);
+        let left: [u8; 32] = hasher.finalize().into();
+        let mut hasher = Sha256::new();
+        hasher.update(left);
+        hasher.update(leaves[2]);
+        assert_eq!(root(&leaves), <[u8; 32]>::from(hasher.finalize()));
+    }
+}
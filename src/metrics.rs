@@ -0,0 +1,331 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+use std::{
+    sync::atomic::{AtomicU64, Ordering},
+    time::{Duration, Instant},
+};
+
+use crate::Error;
+
+/// The number of buckets in a C2paHistogram.
+pub const C2PA_HISTOGRAM_BUCKETS: usize = 24;
+
+#[repr(C)]
+#[derive(Debug, Clone, Default)]
+/// A latency histogram with power of two microsecond buckets.
+///
+/// Bucket 0 counts samples under 1µs and bucket n counts samples
+/// from 2^(n-1) up to 2^n µs. The last bucket also counts everything slower.
+pub struct C2paHistogram {
+    /// The number of samples recorded.
+    pub count: u64,
+    /// The sum of all samples in microseconds.
+    pub sum_us: u64,
+    /// The slowest sample in microseconds.
+    pub max_us: u64,
+    /// The number of samples in each bucket.
+    pub buckets: [u64; C2PA_HISTOGRAM_BUCKETS],
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Default)]
+/// The number of errors reported through c2pa_error, by kind.
+pub struct C2paErrorCounts {
+    pub assertion: u64,
+    pub assertion_not_found: u64,
+    pub decoding: u64,
+    pub encoding: u64,
+    pub file_not_found: u64,
+    pub io: u64,
+    pub json: u64,
+    pub manifest: u64,
+    pub manifest_not_found: u64,
+    pub not_supported: u64,
+    pub other: u64,
+    pub null_parameter: u64,
+    pub remote_manifest: u64,
+    pub resource_not_found: u64,
+    pub signature: u64,
+    pub verify: u64,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Default)]
+/// A snapshot of the process wide counters kept by this library.
+pub struct C2paMetrics {
+    /// The number of Readers created successfully.
+    pub readers_opened: u64,
+    /// The number of manifests signed successfully.
+    pub signs_completed: u64,
+    /// The number of asset bytes read while signing.
+    pub bytes_hashed: u64,
+    /// The number of read and sign operations running right now.
+    pub in_flight: u64,
+    /// The most read and sign operations that have run at the same time.
+    pub peak_in_flight: u64,
+    /// The errors reported, by kind.
+    pub errors: C2paErrorCounts,
+    /// The time taken to create a Reader.
+    pub read_latency: C2paHistogram,
+    /// The time taken to sign and embed a manifest, including the signer and TSA.
+    pub sign_latency: C2paHistogram,
+    /// The time spent in the signer.
+    pub signer_latency: C2paHistogram,
+    /// The time spent waiting on the time stamp authority.
+    pub tsa_latency: C2paHistogram,
+}
+
+// Needed to build arrays of atomics in a const context.
+#[allow(clippy::declare_interior_mutable_const)]
+const ZERO: AtomicU64 = AtomicU64::new(0);
+
+const ERROR_KINDS: usize = 16;
+
+struct Histogram {
+    count: AtomicU64,
+    sum_us: AtomicU64,
+    max_us: AtomicU64,
+    buckets: [AtomicU64; C2PA_HISTOGRAM_BUCKETS],
+}
+
+impl Histogram {
+    const fn new() -> Self {
+        Self {
+            count: ZERO,
+            sum_us: ZERO,
+            max_us: ZERO,
+            buckets: [ZERO; C2PA_HISTOGRAM_BUCKETS],
+        }
+    }
+
+    fn record(&self, elapsed: Duration) {
+        let us = elapsed.as_micros().min(u64::MAX as u128) as u64;
+        let bucket = ((u64::BITS - us.leading_zeros()) as usize).min(C2PA_HISTOGRAM_BUCKETS - 1);
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.sum_us.fetch_add(us, Ordering::Relaxed);
+        self.max_us.fetch_max(us, Ordering::Relaxed);
+        self.buckets[bucket].fetch_add(1, Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> C2paHistogram {
+        let mut buckets = [0; C2PA_HISTOGRAM_BUCKETS];
+        for (value, bucket) in buckets.iter_mut().zip(self.buckets.iter()) {
+            *value = bucket.load(Ordering::Relaxed);
+        }
+        C2paHistogram {
+            count: self.count.load(Ordering::Relaxed),
+            sum_us: self.sum_us.load(Ordering::Relaxed),
+            max_us: self.max_us.load(Ordering::Relaxed),
+            buckets,
+        }
+    }
+
+    fn reset(&self) {
+        self.count.store(0, Ordering::Relaxed);
+        self.sum_us.store(0, Ordering::Relaxed);
+        self.max_us.store(0, Ordering::Relaxed);
+        for bucket in self.buckets.iter() {
+            bucket.store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+static READERS_OPENED: AtomicU64 = ZERO;
+static SIGNS_COMPLETED: AtomicU64 = ZERO;
+static BYTES_HASHED: AtomicU64 = ZERO;
+static IN_FLIGHT: AtomicU64 = ZERO;
+static PEAK_IN_FLIGHT: AtomicU64 = ZERO;
+static ERRORS: [AtomicU64; ERROR_KINDS] = [ZERO; ERROR_KINDS];
+static READ_LATENCY: Histogram = Histogram::new();
+static SIGN_LATENCY: Histogram = Histogram::new();
+static SIGNER_LATENCY: Histogram = Histogram::new();
+static TSA_LATENCY: Histogram = Histogram::new();
+
+/// The kinds of operation counted as in flight.
+pub(crate) enum Kind {
+    Read,
+    Sign,
+}
+
+/// Counts an operation as in flight until it is dropped.
+///
+/// Call complete when the operation succeeds to count it and record its latency.
+pub(crate) struct Operation {
+    kind: Kind,
+    start: Instant,
+}
+
+impl Operation {
+    pub fn begin(kind: Kind) -> Self {
+        let in_flight = IN_FLIGHT.fetch_add(1, Ordering::Relaxed) + 1;
+        PEAK_IN_FLIGHT.fetch_max(in_flight, Ordering::Relaxed);
+        Self {
+            kind,
+            start: Instant::now(),
+        }
+    }
+
+    pub fn complete(self) {
+        let elapsed = self.start.elapsed();
+        match self.kind {
+            Kind::Read => {
+                READERS_OPENED.fetch_add(1, Ordering::Relaxed);
+                READ_LATENCY.record(elapsed);
+            }
+            Kind::Sign => {
+                SIGNS_COMPLETED.fetch_add(1, Ordering::Relaxed);
+                SIGN_LATENCY.record(elapsed);
+            }
+        }
+    }
+}
+
+impl Drop for Operation {
+    fn drop(&mut self) {
+        IN_FLIGHT.fetch_sub(1, Ordering::Relaxed);
+    }
+}
+
+/// Adds to the number of asset bytes hashed.
+pub(crate) fn add_bytes_hashed(bytes: u64) {
+    BYTES_HASHED.fetch_add(bytes, Ordering::Relaxed);
+}
+
+/// Records the time spent in a signer.
+pub(crate) fn record_signer(elapsed: Duration) {
+    SIGNER_LATENCY.record(elapsed);
+}
+
+/// Records the time spent on a time stamp request.
+pub(crate) fn record_tsa(elapsed: Duration) {
+    TSA_LATENCY.record(elapsed);
+}
+
+/// Counts an error reported to the caller.
+pub(crate) fn record_error(err: &Error) {
+    let kind = match err {
+        Error::Assertion(_) => 0,
+        Error::AssertionNotFound(_) => 1,
+        Error::Decoding(_) => 2,
+        Error::Encoding(_) => 3,
+        Error::FileNotFound(_) => 4,
+        Error::Io(_) => 5,
+        Error::Json(_) => 6,
+        Error::Manifest(_) => 7,
+        Error::ManifestNotFound(_) => 8,
+        Error::NotSupported(_) => 9,
+        Error::Other(_) => 10,
+        Error::NullParameter(_) => 11,
+        Error::RemoteManifest(_) => 12,
+        Error::ResourceNotFound(_) => 13,
+        Error::Signature(_) => 14,
+        Error::Verify(_) => 15,
+    };
+    ERRORS[kind].fetch_add(1, Ordering::Relaxed);
+}
+
+/// Returns a snapshot of the process wide metrics.
+///
+/// Counters are read one at a time, so a snapshot taken while other
+/// threads are working may be slightly inconsistent between fields.
+#[no_mangle]
+pub extern "C" fn c2pa_metrics_snapshot() -> C2paMetrics {
+    let errors = |kind: usize| ERRORS[kind].load(Ordering::Relaxed);
+    C2paMetrics {
+        readers_opened: READERS_OPENED.load(Ordering::Relaxed),
+        signs_completed: SIGNS_COMPLETED.load(Ordering::Relaxed),
+        bytes_hashed: BYTES_HASHED.load(Ordering::Relaxed),
+        in_flight: IN_FLIGHT.load(Ordering::Relaxed),
+        peak_in_flight: PEAK_IN_FLIGHT.load(Ordering::Relaxed),
+        errors: C2paErrorCounts {
+            assertion: errors(0),
+            assertion_not_found: errors(1),
+            decoding: errors(2),
+            encoding: errors(3),
+            file_not_found: errors(4),
+            io: errors(5),
+            json: errors(6),
+            manifest: errors(7),
+            manifest_not_found: errors(8),
+            not_supported: errors(9),
+            other: errors(10),
+            null_parameter: errors(11),
+            remote_manifest: errors(12),
+            resource_not_found: errors(13),
+            signature: errors(14),
+            verify: errors(15),
+        },
+        read_latency: READ_LATENCY.snapshot(),
+        sign_latency: SIGN_LATENCY.snapshot(),
+        signer_latency: SIGNER_LATENCY.snapshot(),
+        tsa_latency: TSA_LATENCY.snapshot(),
+    }
+}
+
+/// Resets all counters and histograms to zero.
+///
+/// The in flight count is left alone so operations running now are still
+/// subtracted when they finish. The peak is reset to the current count.
+#[no_mangle]
+pub extern "C" fn c2pa_metrics_reset() {
+    READERS_OPENED.store(0, Ordering::Relaxed);
+    SIGNS_COMPLETED.store(0, Ordering::Relaxed);
+    BYTES_HASHED.store(0, Ordering::Relaxed);
+    PEAK_IN_FLIGHT.store(IN_FLIGHT.load(Ordering::Relaxed), Ordering::Relaxed);
+    for count in ERRORS.iter() {
+        count.store(0, Ordering::Relaxed);
+    }
+    READ_LATENCY.reset();
+    SIGN_LATENCY.reset();
+    SIGNER_LATENCY.reset();
+    TSA_LATENCY.reset();
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_histogram_buckets() {
+        let histogram = Histogram::new();
+        histogram.record(Duration::from_nanos(500));
+        histogram.record(Duration::from_micros(1));
+        histogram.record(Duration::from_micros(3));
+        histogram.record(Duration::from_secs(3600));
+        let snapshot = histogram.snapshot();
+        assert_eq!(snapshot.count, 4);
+        assert_eq!(snapshot.max_us, 3_600_000_000);
+        assert_eq!(snapshot.buckets[0], 1);
+        assert_eq!(snapshot.buckets[1], 1);
+        assert_eq!(snapshot.buckets[2], 1);
+        assert_eq!(snapshot.buckets[C2PA_HISTOGRAM_BUCKETS - 1], 1);
+    }
+
+    #[test]
+    fn test_operations_and_errors() {
+        // other tests may run operations at the same time, so only check deltas
+        let before = c2pa_metrics_snapshot();
+        {
+            let _first = Operation::begin(Kind::Sign);
+            let second = Operation::begin(Kind::Sign);
+            assert!(c2pa_metrics_snapshot().peak_in_flight >= 2);
+            second.complete();
+        }
+        Error::Signature("test".to_string()).set_last();
+        let after = c2pa_metrics_snapshot();
+        assert!(after.signs_completed > before.signs_completed);
+        assert!(after.sign_latency.count > before.sign_latency.count);
+        assert!(after.errors.signature > before.errors.signature);
+    }
+}
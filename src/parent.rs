@@ -0,0 +1,142 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Finding the parent ingredient of an asset that is about to be signed.
+//!
+//! A source that already has a manifest store becomes the parent of the new
+//! manifest. Building that ingredient reads, hashes and thumbnails the whole
+//! source, which is wasted on the common case of an unsigned source. The
+//! JPEG, PNG and TIFF scanners only read headers, so they decide first, and
+//! the ingredient is only built when there is a store or the XMP points
+//! to a remote one. Its thumbnail is the same picture as the source, so
+//! the new manifest reuses it rather than generating another.
+
+use std::io::{self, Read, Seek, SeekFrom};
+
+use c2pa::Ingredient;
+
+use crate::{jpeg, png, remote, tiff};
+
+/// Returns whether a stream has a manifest store, embedded or remote.
+///
+/// A source without an embedded store may still reference a remote one
+/// from the dcterms:provenance property of its XMP, which c2pa follows.
+/// Returns None when the format has no fast scan or the scan could not
+/// tell, in which case c2pa has to look.
+pub(crate) fn has_manifest_store<R: Read + Seek>(
+    format: &str,
+    stream: &mut R,
+) -> io::Result<Option<bool>> {
+    match has_embedded_store(format, stream)? {
+        Some(false) => Ok(Some(remote::provenance_url(stream)?.is_some())),
+        found => Ok(found),
+    }
+}
+
+/// Returns whether a stream has an embedded manifest store.
+///
+/// Returns None when the format has no fast scan or the scan could not
+/// tell, in which case c2pa has to look.
+pub(crate) fn has_embedded_store<R: Read + Seek>(
+    format: &str,
+    stream: &mut R,
+) -> io::Result<Option<bool>> {
+    // a scan error means a damaged file, c2pa decides what that means
+    let found = if jpeg::is_jpeg(format) {
+        jpeg::scan(stream)
+            .ok()
+            .flatten()
+            .map(|layout| !layout.stores.is_empty())
+    } else if png::is_png(format) {
+        png::scan(stream)
+            .ok()
+            .flatten()
+            .map(|layout| !layout.stores.is_empty())
+    } else if tiff::is_tiff(format) {
+        tiff::find_manifest(stream)
+            .ok()
+            .map(|store| store.is_some())
+    } else {
+        None
+    };
+    stream.seek(SeekFrom::Start(0))?;
+    Ok(found)
+}
+
+/// Returns the stream as a parent ingredient if it has a manifest store.
+///
+/// The stream is left at the start.
+pub(crate) fn from_stream<R: Read + Seek + Send>(
+    format: &str,
+    stream: &mut R,
+) -> c2pa::Result<Option<Ingredient>> {
+    if has_manifest_store(format, stream)? == Some(false) {
+        return Ok(None);
+    }
+    let ingredient = Ingredient::from_stream(format, stream);
+    stream.seek(SeekFrom::Start(0))?;
+    let mut ingredient = ingredient?;
+    if ingredient.manifest_data().is_none() {
+        return Ok(None);
+    }
+    ingredient.set_is_parent();
+    Ok(Some(ingredient))
+}
+
+/// Returns the format and bytes of an ingredient's thumbnail.
+pub(crate) fn thumbnail(ingredient: &Ingredient) -> Option<(String, Vec<u8>)> {
+    let format = ingredient.thumbnail_ref()?.format.clone();
+    let bytes = ingredient.thumbnail_bytes().ok()?;
+    Some((format, bytes.into_owned()))
+}
+
+#[cfg(test)]
+mod tests {
+    use std::io::Cursor;
+
+    use super::*;
+
+    #[test]
+    fn test_has_manifest_store() {
+        let signed =
+            std::fs::read(concat!(env!("CARGO_MANIFEST_DIR"), "/tests/fixtures/C.jpg")).unwrap();
+        let mut stream = Cursor::new(&signed);
+        assert_eq!(
+            has_manifest_store("image/jpeg", &mut stream).unwrap(),
+            Some(true)
+        );
+        assert_eq!(stream.position(), 0);
+
+        // an unsigned JPEG, just the start and end of image
+        let unsigned = [0xFF, 0xD8, 0xFF, 0xD9];
+        assert_eq!(
+            has_manifest_store("jpg", &mut Cursor::new(&unsigned)).unwrap(),
+            Some(false)
+        );
+        assert_eq!(
+            has_manifest_store("mp4", &mut Cursor::new(&unsigned)).unwrap(),
+            None
+        );
+
+        // a remote manifest is referenced from the XMP in an APP1 segment
+        let xmp = br#"<rdf:Description dcterms:provenance="https://example.com/m.c2pa"/>"#;
+        let mut remote = vec![0xFF, 0xD8, 0xFF, 0xE1];
+        remote.extend_from_slice(&(xmp.len() as u16 + 2).to_be_bytes());
+        remote.extend_from_slice(xmp);
+        remote.extend_from_slice(&[0xFF, 0xD9]);
+        let mut stream = Cursor::new(&remote);
+        assert_eq!(has_embedded_store("jpg", &mut stream).unwrap(), Some(false));
+        assert_eq!(has_manifest_store("jpg", &mut stream).unwrap(), Some(true));
+        assert_eq!(stream.position(), 0);
+    }
+}
@@ -0,0 +1,263 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! A fast path for C2PA data in PNG files.
+//!
+//! The manifest store is the payload of a caBX chunk. Every chunk starts
+//! with its length and type, so the walk seeks over IDAT and other payloads
+//! without reading them. Chunk CRCs are computed with crc32fast, which uses
+//! the PCLMULQDQ or ARMv8 CRC instructions when the CPU has them.
+
+use std::io::{self, BufReader, Read, Seek, SeekFrom, Write};
+
+use c2pa::{Builder, Reader, Signer};
+
+use crate::{
+    remote,
+    splice::{self, Splice},
+};
+
+const SIGNATURE: [u8; 8] = [0x89, b'P', b'N', b'G', b'\r', b'\n', 0x1A, b'\n'];
+const C2PA_CHUNK: &[u8; 4] = b"caBX";
+const SCAN_BUFFER_SIZE: usize = 64 * 1024;
+// the largest chunk length the PNG specification allows
+const MAX_CHUNK_LEN: u64 = (1 << 31) - 1;
+
+/// Returns true if the format names a PNG.
+pub(crate) fn is_png(format: &str) -> bool {
+    ["image/png", "png"]
+        .iter()
+        .any(|f| f.eq_ignore_ascii_case(format))
+}
+
+/// A chunk of a PNG file.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub(crate) struct Chunk {
+    pub kind: [u8; 4],
+    /// The offset of the chunk's length field.
+    pub offset: u64,
+    /// The length of the chunk data.
+    pub len: u64,
+}
+
+impl Chunk {
+    /// The size of the whole chunk, including length, type and CRC.
+    pub fn size(&self) -> u64 {
+        self.len + 12
+    }
+}
+
+/// The chunks of a PNG and the contents of any caBX chunks.
+#[derive(Debug, Default)]
+pub(crate) struct Layout {
+    pub chunks: Vec<Chunk>,
+    pub stores: Vec<(Chunk, Vec<u8>)>,
+}
+
+/// Walks the chunks of a PNG stream, reading only the caBX payloads.
+///
+/// Returns None if the stream does not start with the PNG signature.
+pub(crate) fn scan<R: Read + Seek>(stream: &mut R) -> io::Result<Option<Layout>> {
+    let stream_len = stream.seek(SeekFrom::End(0))?;
+    stream.seek(SeekFrom::Start(0))?;
+    let mut reader = BufReader::with_capacity(SCAN_BUFFER_SIZE, stream);
+    let mut signature = [0u8; 8];
+    if reader.read_exact(&mut signature).is_err() || signature != SIGNATURE {
+        return Ok(None);
+    }
+    let mut layout = Layout::default();
+    let mut offset = SIGNATURE.len() as u64;
+    let mut header = [0u8; 8];
+    loop {
+        match reader.read_exact(&mut header) {
+            Ok(()) => {}
+            // a truncated file ends the walk, c2pa reports it if it matters
+            Err(e) if e.kind() == io::ErrorKind::UnexpectedEof => break,
+            Err(e) => return Err(e),
+        }
+        let chunk = Chunk {
+            kind: [header[4], header[5], header[6], header[7]],
+            offset,
+            len: u32::from_be_bytes([header[0], header[1], header[2], header[3]]) as u64,
+        };
+        if &chunk.kind == C2PA_CHUNK {
+            // the length comes from the file, check it before allocating
+            if chunk.len > MAX_CHUNK_LEN || chunk.offset + chunk.size() > stream_len {
+                return Err(io::Error::new(
+                    io::ErrorKind::InvalidData,
+                    "caBX chunk extends past the end of the file",
+                ));
+            }
+            let mut data = vec![0u8; chunk.len as usize];
+            let mut crc = [0u8; 4];
+            reader.read_exact(&mut data)?;
+            reader.read_exact(&mut crc)?;
+            if u32::from_be_bytes(crc) != chunk_crc(&chunk.kind, &data) {
+                return Err(io::Error::new(
+                    io::ErrorKind::InvalidData,
+                    "caBX chunk CRC mismatch",
+                ));
+            }
+            layout.stores.push((chunk.clone(), data));
+        } else {
+            reader.seek_relative(chunk.len as i64 + 4)?;
+        }
+        offset += chunk.size();
+        let end = &chunk.kind == b"IEND";
+        layout.chunks.push(chunk);
+        if end {
+            break;
+        }
+    }
+    Ok(Some(layout))
+}
+
+fn chunk_crc(kind: &[u8; 4], data: &[u8]) -> u32 {
+    let mut hasher = crc32fast::Hasher::new();
+    hasher.update(kind);
+    hasher.update(data);
+    hasher.finalize()
+}
+
+/// Wraps a manifest store in a caBX chunk.
+pub(crate) fn c2pa_chunk(data: &[u8]) -> Vec<u8> {
+    let mut chunk = Vec::with_capacity(data.len() + 12);
+    chunk.extend_from_slice(&(data.len() as u32).to_be_bytes());
+    chunk.extend_from_slice(C2PA_CHUNK);
+    chunk.extend_from_slice(data);
+    chunk.extend_from_slice(&chunk_crc(C2PA_CHUNK, data).to_be_bytes());
+    chunk
+}
+
+/// Creates a Reader from a PNG, handing c2pa the manifest store found by scan.
+///
+/// Without a caBX chunk, a remote manifest referenced from XMP is read
+/// through the fetch callback and cache when they are set. Falls back to
+/// the general parser otherwise.
+pub(crate) fn read<R: Read + Seek + Send>(format: &str, stream: &mut R) -> c2pa::Result<Reader> {
+    let layout = scan(stream)?;
+    stream.seek(SeekFrom::Start(0))?;
+    match layout {
+        Some(layout) if layout.stores.len() == 1 => {
+            Reader::from_manifest_data_and_stream(&layout.stores[0].1, format, stream)
+        }
+        Some(layout) if layout.stores.is_empty() => {
+            remote::read(format, stream).unwrap_or_else(|| Reader::from_stream(format, stream))
+        }
+        _ => Reader::from_stream(format, stream),
+    }
+}
+
+/// Signs a PNG by splicing a caBX chunk into one copy of the source.
+///
+/// An existing caBX chunk is replaced in place, otherwise the chunk goes
+/// right after IHDR. Returns None, having written nothing, if the builder
+/// needs Builder::sign. Otherwise returns the manifest store bytes.
+pub(crate) fn sign<R, W>(
+    builder: &mut Builder,
+    signer: &dyn Signer,
+    source: &mut R,
+    dest: &mut W,
+) -> c2pa::Result<Option<Vec<u8>>>
+where
+    R: Read + Seek,
+    W: Write + Seek,
+{
+    let layout = match scan(source)? {
+        Some(layout) if layout.stores.len() <= 1 && splice::can_splice(builder) => layout,
+        _ => return Ok(None),
+    };
+    let splice = match (layout.stores.first(), layout.chunks.first()) {
+        (Some((store, _)), _) => Splice {
+            format: "c2pa",
+            offset: store.offset,
+            remove: store.size(),
+        },
+        (None, Some(ihdr)) if &ihdr.kind == b"IHDR" => Splice {
+            format: "c2pa",
+            offset: ihdr.offset + ihdr.size(),
+            remove: 0,
+        },
+        _ => return Ok(None),
+    };
+    let manifest = splice::sign(builder, signer, &splice, c2pa_chunk, source, dest)?;
+    Ok(Some(manifest))
+}
+
+#[cfg(test)]
+mod tests {
+    use std::io::Cursor;
+
+    use super::*;
+
+    fn chunk(kind: &[u8; 4], data: &[u8]) -> Vec<u8> {
+        let mut out = (data.len() as u32).to_be_bytes().to_vec();
+        out.extend_from_slice(kind);
+        out.extend_from_slice(data);
+        out.extend_from_slice(&chunk_crc(kind, data).to_be_bytes());
+        out
+    }
+
+    fn png(store: Option<&[u8]>) -> Vec<u8> {
+        let mut out = SIGNATURE.to_vec();
+        out.extend(chunk(b"IHDR", &[0u8; 13]));
+        if let Some(store) = store {
+            out.extend(c2pa_chunk(store));
+        }
+        out.extend(chunk(b"IDAT", &[7u8; 100_000]));
+        out.extend(chunk(b"IDAT", &[8u8; 1000]));
+        out.extend(chunk(b"IEND", &[]));
+        out
+    }
+
+    #[test]
+    fn test_scan_rejects_oversized_store() {
+        let mut bytes = png(None);
+        let at = bytes.len() - 12;
+        // a caBX chunk claiming 4 GiB in a small file
+        let mut chunk = u32::MAX.to_be_bytes().to_vec();
+        chunk.extend_from_slice(C2PA_CHUNK);
+        chunk.extend_from_slice(&[0u8; 16]);
+        bytes.splice(at..at, chunk);
+        let error = scan(&mut Cursor::new(&bytes)).unwrap_err();
+        assert_eq!(error.kind(), io::ErrorKind::InvalidData);
+    }
+
+    #[test]
+    fn test_scan_finds_store() {
+        let bytes = png(Some(b"jumbf bytes"));
+        let layout = scan(&mut Cursor::new(&bytes)).unwrap().unwrap();
+        let kinds: Vec<&[u8; 4]> = layout.chunks.iter().map(|c| &c.kind).collect();
+        assert_eq!(kinds, vec![b"IHDR", b"caBX", b"IDAT", b"IDAT", b"IEND"]);
+        assert_eq!(layout.stores.len(), 1);
+        assert_eq!(layout.stores[0].0.offset, 8 + 25);
+        assert_eq!(layout.stores[0].1, b"jumbf bytes");
+
+        let layout = scan(&mut Cursor::new(png(None))).unwrap().unwrap();
+        assert!(layout.stores.is_empty());
+        assert!(scan(&mut Cursor::new(b"\xFF\xD8\xFF")).unwrap().is_none());
+    }
+
+    #[test]
+    fn test_scan_rejects_bad_crc() {
+        let mut bytes = png(Some(b"jumbf bytes"));
+        bytes[8 + 25 + 8] ^= 1;
+        assert!(scan(&mut Cursor::new(&bytes)).is_err());
+    }
+
+    #[test]
+    fn test_chunk_crc() {
+        // the CRC of an empty IEND chunk is fixed by the PNG spec
+        assert_eq!(chunk_crc(b"IEND", &[]), 0xAE42_6082);
+    }
+}
@@ -0,0 +1,756 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Fetching and caching remote manifests.
+//!
+//! An asset without an embedded manifest store may name one by URL in the
+//! dcterms:provenance property of its XMP. c2pa fetches that URL with a
+//! blocking request on every read. When an application registers a fetch
+//! callback or a cache directory, readers of JPEG, PNG and TIFF assets
+//! take the URL from the XMP themselves, serve the manifest from the cache
+//! or the callback, and hand it to c2pa, which validates it as usual.
+//!
+//! Cache entries are files named by the SHA-256 of their URL. A fetched
+//! store is only cached once it has parsed, when a reader was built from it
+//! or, for prefetches, when it is one whole C2PA JUMBF box. Entries expire
+//! after the TTL, and the least recently written are removed once the
+//! directory grows past its size limit.
+//!
+//! The URL in an asset is covered by its hard binding, so when manifests
+//! move to another host the assets cannot be edited to point there without
+//! signing them again. Instead, URL rewrites replace the old prefix when
+//! the URL is read, and c2pa_prefetch_remote_manifests fetches the stores
+//! for a list of assets through them to fill the cache and find assets
+//! whose manifest is missing at the new location.
+
+use std::{
+    fs::{self, File},
+    io::{self, Read, Seek, SeekFrom},
+    os::raw::{c_char, c_int, c_uchar, c_uint, c_void},
+    path::{Path, PathBuf},
+    sync::{
+        atomic::{AtomicBool, AtomicUsize, Ordering},
+        Mutex,
+    },
+    thread,
+    time::{Duration, SystemTime},
+};
+
+use c2pa::Reader;
+use memchr::memmem;
+use sha2::{Digest, Sha256};
+
+use crate::{
+    from_cstr_null_check_int, from_cstr_option, jpeg,
+    merkle::hex,
+    parent, png, tiff,
+    trace::{names, Span},
+    Error, Result,
+};
+
+/// How far into an asset to look for the XMP packet.
+const XMP_SEARCH_LIMIT: u64 = 1024 * 1024;
+const PROVENANCE: &[u8] = b"dcterms:provenance";
+const CACHE_EXTENSION: &str = "c2pa";
+
+/// The body of a fetch, filled in by a fetch callback.
+#[derive(Debug, Default)]
+pub struct C2paFetchResponse {
+    data: Vec<u8>,
+}
+
+/// Defines a callback to fetch a remote manifest store.
+///
+/// # Parameters
+/// * context: the context value passed to c2pa_set_fetch_callback.
+/// * url: the NULL-terminated URL of the manifest store.
+/// * response: the response to write the body to with c2pa_fetch_response_write.
+///
+/// Returns 0 if the body was fetched, or a negative value if it was not.
+pub type FetchCallback = unsafe extern "C" fn(
+    context: *const c_void,
+    url: *const c_char,
+    response: *mut C2paFetchResponse,
+) -> c_int;
+
+#[derive(Clone, Copy)]
+struct Fetcher {
+    context: usize,
+    callback: FetchCallback,
+}
+
+pub(crate) struct Cache {
+    dir: PathBuf,
+    ttl: Option<Duration>,
+    max_bytes: Option<u64>,
+}
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+/// Numbers the files cache entries are written to before they are renamed.
+static PARTIAL_COUNTER: AtomicUsize = AtomicUsize::new(0);
+static FETCHER: Mutex<Option<Fetcher>> = Mutex::new(None);
+static CACHE: Mutex<Option<Cache>> = Mutex::new(None);
+/// URL prefixes to replace, and what to replace them with.
+static REWRITES: Mutex<Vec<(String, String)>> = Mutex::new(Vec::new());
+
+fn update_enabled() {
+    let enabled = FETCHER.lock().map(|f| f.is_some()).unwrap_or(false)
+        || CACHE.lock().map(|c| c.is_some()).unwrap_or(false);
+    ENABLED.store(enabled, Ordering::Relaxed);
+}
+
+impl Cache {
+    pub(crate) fn new(dir: PathBuf, ttl: Option<Duration>, max_bytes: Option<u64>) -> Self {
+        Self {
+            dir,
+            ttl,
+            max_bytes,
+        }
+    }
+
+    fn path(&self, url: &str) -> PathBuf {
+        self.dir
+            .join(hex(&Sha256::digest(url.as_bytes())))
+            .with_extension(CACHE_EXTENSION)
+    }
+
+    fn expired(&self, modified: SystemTime) -> bool {
+        match (self.ttl, modified.elapsed()) {
+            (Some(ttl), Ok(age)) => age > ttl,
+            _ => false,
+        }
+    }
+
+    /// Returns the cached manifest store for a URL, if it has not expired.
+    pub(crate) fn get(&self, url: &str) -> Option<Vec<u8>> {
+        let path = self.path(url);
+        let modified = fs::metadata(&path).and_then(|m| m.modified()).ok()?;
+        if self.expired(modified) {
+            let _ = fs::remove_file(&path);
+            return None;
+        }
+        fs::read(&path).ok()
+    }
+
+    /// Stores a manifest store, then trims the cache to its size limit.
+    pub(crate) fn put(&self, url: &str, data: &[u8]) -> io::Result<()> {
+        fs::create_dir_all(&self.dir)?;
+        let path = self.path(url);
+        // written aside and renamed, so readers never see part of an entry,
+        // under a name no other thread or process writes to
+        let partial = path.with_extension(format!(
+            "{}-{}.partial",
+            std::process::id(),
+            PARTIAL_COUNTER.fetch_add(1, Ordering::Relaxed)
+        ));
+        fs::write(&partial, data)?;
+        fs::rename(&partial, &path)?;
+        self.trim()
+    }
+
+    fn trim(&self) -> io::Result<()> {
+        let mut entries = Vec::new();
+        for entry in fs::read_dir(&self.dir)? {
+            let path = entry?.path();
+            if path.extension().and_then(|e| e.to_str()) != Some(CACHE_EXTENSION) {
+                continue;
+            }
+            let Ok(metadata) = fs::metadata(&path) else {
+                continue;
+            };
+            let modified = metadata.modified().unwrap_or(SystemTime::UNIX_EPOCH);
+            if self.expired(modified) {
+                let _ = fs::remove_file(&path);
+            } else {
+                entries.push((modified, metadata.len(), path));
+            }
+        }
+        let Some(max_bytes) = self.max_bytes else {
+            return Ok(());
+        };
+        let mut total: u64 = entries.iter().map(|(_, len, _)| len).sum();
+        entries.sort();
+        for (_, len, path) in entries {
+            if total <= max_bytes {
+                break;
+            }
+            if fs::remove_file(&path).is_ok() {
+                total -= len;
+            }
+        }
+        Ok(())
+    }
+}
+
+/// Returns true if a fetch callback or a cache is set.
+#[inline]
+pub(crate) fn enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+/// Returns the dcterms:provenance URL from the XMP near the start of a stream.
+///
+/// The stream is left at the start.
+pub(crate) fn provenance_url<R: Read + Seek>(stream: &mut R) -> io::Result<Option<String>> {
+    stream.seek(SeekFrom::Start(0))?;
+    let mut head = Vec::new();
+    stream
+        .by_ref()
+        .take(XMP_SEARCH_LIMIT)
+        .read_to_end(&mut head)?;
+    stream.seek(SeekFrom::Start(0))?;
+    Ok(memmem::find_iter(&head, PROVENANCE)
+        .find_map(|at| property_value(&head[at + PROVENANCE.len()..])))
+}
+
+// Reads an XMP property value written as an attribute or as an element.
+fn property_value(rest: &[u8]) -> Option<String> {
+    let start = rest.iter().position(|b| !b.is_ascii_whitespace())?;
+    let (value, end) = match rest[start] {
+        b'=' => {
+            let rest = &rest[start + 1..];
+            let quote = *rest.iter().find(|b| !b.is_ascii_whitespace())?;
+            if quote != b'"' && quote != b'\'' {
+                return None;
+            }
+            let open = rest.iter().position(|b| *b == quote)? + 1;
+            (&rest[open..], quote)
+        }
+        b'>' => (&rest[start + 1..], b'<'),
+        _ => return None,
+    };
+    let value = &value[..value.iter().position(|b| *b == end)?];
+    let value = std::str::from_utf8(value).ok()?.trim();
+    if value.is_empty() {
+        return None;
+    }
+    Some(
+        value
+            .replace("&quot;", "\"")
+            .replace("&apos;", "'")
+            .replace("&lt;", "<")
+            .replace("&gt;", ">")
+            .replace("&amp;", "&"),
+    )
+}
+
+/// Applies the first URL rewrite whose prefix matches.
+pub(crate) fn rewrite(url: &str) -> String {
+    let rewrites = REWRITES.lock().unwrap_or_else(|e| e.into_inner());
+    rewrites
+        .iter()
+        .find_map(|(from, to)| {
+            url.strip_prefix(from.as_str())
+                .map(|rest| format!("{to}{rest}"))
+        })
+        .unwrap_or_else(|| url.to_string())
+}
+
+/// A remote manifest store and where it came from.
+pub(crate) struct Fetched {
+    url: String,
+    pub data: Vec<u8>,
+    cached: bool,
+}
+
+impl Fetched {
+    /// Writes a store from the fetch callback to the cache, if one is set.
+    ///
+    /// Call it once the store has parsed, so a bad body is fetched again.
+    pub(crate) fn keep(&self) {
+        if self.cached {
+            return;
+        }
+        if let Ok(cache) = CACHE.lock() {
+            if let Some(cache) = cache.as_ref() {
+                // a cache that cannot be written only costs the next fetch
+                let _ = cache.put(&self.url, &self.data);
+            }
+        }
+    }
+}
+
+/// Returns true if the bytes are one whole C2PA JUMBF superbox.
+fn is_manifest_store(data: &[u8]) -> bool {
+    let size = match data
+        .get(0..4)
+        .map(|b| u32::from_be_bytes(b.try_into().unwrap()))
+    {
+        Some(1) => data
+            .get(8..16)
+            .map(|b| u64::from_be_bytes(b.try_into().unwrap())),
+        size => size.map(u64::from),
+    };
+    size == Some(data.len() as u64) && jpeg::is_c2pa_store(data)
+}
+
+/// Returns a remote manifest store from the cache or the fetch callback.
+///
+/// Returns None when neither has it, so c2pa fetches the URL itself.
+/// Stores from the callback are not cached until Fetched::keep is called.
+pub(crate) fn fetch(url: &str) -> Option<c2pa::Result<Fetched>> {
+    if let Some(data) = CACHE.lock().ok()?.as_ref().and_then(|cache| cache.get(url)) {
+        return Some(Ok(Fetched {
+            url: url.to_string(),
+            data,
+            cached: true,
+        }));
+    }
+    let fetched = {
+        // copied out so slow fetches do not hold the lock
+        let fetcher = (*FETCHER.lock().ok()?)?;
+        let mut span = Span::new(names::REMOTE_FETCH);
+        let c_url = std::ffi::CString::new(url).ok()?;
+        let mut response = C2paFetchResponse::default();
+        // SAFETY: the callback and context were registered together
+        let status = unsafe {
+            (fetcher.callback)(
+                fetcher.context as *const c_void,
+                c_url.as_ptr(),
+                &mut response,
+            )
+        };
+        span.add_bytes(response.data.len() as u64);
+        if status < 0 {
+            return Some(Err(c2pa::Error::RemoteManifestFetch(url.to_string())));
+        }
+        response.data
+    };
+    Some(Ok(Fetched {
+        url: url.to_string(),
+        data: fetched,
+        cached: false,
+    }))
+}
+
+/// Reads an asset that has no embedded store through its remote manifest.
+///
+/// The JPEG, PNG and TIFF readers call this once their scan found no store,
+/// so the headers are not scanned again. Returns None if remote fetching is
+/// not configured, or there is no URL or manifest for the asset, in which
+/// case the stream should be read as usual. The stream is left at the start.
+pub(crate) fn read<R: Read + Seek + Send>(
+    format: &str,
+    stream: &mut R,
+) -> Option<c2pa::Result<Reader>> {
+    if !enabled() {
+        return None;
+    }
+    let url = provenance_url(stream).ok()??;
+    let fetched = fetch(&rewrite(&url))?;
+    Some(fetched.and_then(|fetched| {
+        let reader = Reader::from_manifest_data_and_stream(&fetched.data, format, stream)?;
+        fetched.keep();
+        Ok(reader)
+    }))
+}
+
+// Fetches the remote manifest of one file, returning whether it had one.
+fn prefetch(path: &Path) -> Result<bool> {
+    let format = path
+        .extension()
+        .and_then(|e| e.to_str())
+        .unwrap_or_default();
+    // other formats have no header scan, so they cannot be reported as 0
+    if !(jpeg::is_jpeg(format) || png::is_png(format) || tiff::is_tiff(format)) {
+        return Err(Error::NotSupported(format!(
+            "remote manifests in files of type \"{format}\""
+        )));
+    }
+    let mut file = File::open(path).map_err(|e| match e.kind() {
+        io::ErrorKind::NotFound => Error::FileNotFound(path.display().to_string()),
+        _ => Error::Io(e.to_string()),
+    })?;
+    match parent::has_embedded_store(format, &mut file).map_err(|e| Error::Io(e.to_string()))? {
+        Some(false) => {}
+        Some(true) => return Ok(false),
+        // a damaged header, there is no telling whether it has a manifest
+        None => {
+            return Err(Error::Io(format!(
+                "could not scan the headers of {}",
+                path.display()
+            )))
+        }
+    }
+    let Some(url) = provenance_url(&mut file).map_err(|e| Error::Io(e.to_string()))? else {
+        return Ok(false);
+    };
+    match fetch(&rewrite(&url)) {
+        Some(Ok(fetched)) if is_manifest_store(&fetched.data) => {
+            fetched.keep();
+            Ok(true)
+        }
+        Some(Ok(_)) => Err(Error::RemoteManifest(url)),
+        Some(Err(e)) => Err(Error::from_c2pa_error(e)),
+        None => Err(Error::RemoteManifest(url)),
+    }
+}
+
+/// Registers a callback to fetch remote manifest stores.
+///
+/// Fetched stores are written to the cache set by c2pa_set_remote_cache.
+/// Pass a NULL callback to let c2pa fetch them itself.
+///
+/// # Parameters
+/// * context: a value passed back to the callback, often a pointer to an HTTP client.
+/// * callback: the callback to invoke for each fetch, or NULL.
+///
+/// # Safety
+/// The context must remain valid until the callback is cleared.
+/// The callback may be called from any thread that reads an asset.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_set_fetch_callback(
+    context: *const c_void,
+    callback: Option<FetchCallback>,
+) {
+    let fetcher = callback.map(|callback| Fetcher {
+        context: context as usize,
+        callback,
+    });
+    if let Ok(mut current) = FETCHER.lock() {
+        *current = fetcher;
+    }
+    update_enabled();
+}
+
+/// Appends bytes to the body of a fetch response.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns 0.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// response must be the pointer passed to a fetch callback, during that call.
+/// data must point to at least len readable bytes.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_fetch_response_write(
+    response: *mut C2paFetchResponse,
+    data: *const c_uchar,
+    len: usize,
+) -> c_int {
+    if response.is_null() || (data.is_null() && len > 0) {
+        Error::set_last(Error::NullParameter("response or data".to_string()));
+        return -1;
+    }
+    if len > 0 {
+        (*response)
+            .data
+            .extend_from_slice(std::slice::from_raw_parts(data, len));
+    }
+    0
+}
+
+/// Sets a directory to cache remote manifest stores in.
+///
+/// Cached stores are used before the fetch callback, so assets with
+/// remote manifests can be read again offline.
+///
+/// # Parameters
+/// * dir: pointer to a C string with the cache directory, or NULL to turn caching off.
+/// * ttl_seconds: how long an entry is used for, or 0 to keep entries until evicted.
+/// * max_bytes: the size the cache is trimmed to after each write, or 0 for no limit.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns 0.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_set_remote_cache(
+    dir: *const c_char,
+    ttl_seconds: u64,
+    max_bytes: u64,
+) -> c_int {
+    let cache = match from_cstr_option!(dir) {
+        Some(dir) => {
+            if let Err(e) = fs::create_dir_all(&dir) {
+                Error::Io(e.to_string()).set_last();
+                return -1;
+            }
+            Some(Cache::new(
+                Path::new(&dir).to_path_buf(),
+                (ttl_seconds > 0).then(|| Duration::from_secs(ttl_seconds)),
+                (max_bytes > 0).then_some(max_bytes),
+            ))
+        }
+        None => None,
+    };
+    if let Ok(mut current) = CACHE.lock() {
+        *current = cache;
+    }
+    update_enabled();
+    0
+}
+
+/// Rewrites remote manifest URLs that start with a prefix.
+///
+/// Rewrites apply to URLs read by this library, which happens when a fetch
+/// callback or a cache is set. URLs fetched by c2pa itself are not rewritten.
+///
+/// # Parameters
+/// * from_prefix: pointer to a C string with the prefix to replace, such as
+///   the scheme and host of the old server.
+/// * to_prefix: pointer to a C string to replace it with, or NULL to remove
+///   the rewrite for from_prefix.
+///
+/// # Errors
+/// Returns -1 if there were errors, otherwise returns 0.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_set_remote_url_rewrite(
+    from_prefix: *const c_char,
+    to_prefix: *const c_char,
+) -> c_int {
+    let from_prefix = from_cstr_null_check_int!(from_prefix);
+    let to_prefix = from_cstr_option!(to_prefix);
+    let mut rewrites = REWRITES.lock().unwrap_or_else(|e| e.into_inner());
+    rewrites.retain(|(from, _)| *from != from_prefix);
+    if let Some(to_prefix) = to_prefix {
+        // longer prefixes first, so the most specific rewrite wins
+        let at = rewrites
+            .iter()
+            .position(|(from, _)| from.len() < from_prefix.len())
+            .unwrap_or(rewrites.len());
+        rewrites.insert(at, (from_prefix, to_prefix));
+    }
+    0
+}
+
+/// Fetches the remote manifest stores of a list of files on several threads.
+///
+/// Each URL is rewritten and fetched through the fetch callback, and the
+/// store is written to the cache if one is set. Run it after moving
+/// manifests to a new server to warm the cache and to find the assets
+/// whose manifest did not make it.
+///
+/// # Parameters
+/// * paths: pointer to an array of count C strings with file paths.
+/// * count: the number of paths.
+/// * threads: the number of threads to fetch with, or 0 for one per core.
+/// * results: pointer to an array of count ints, each set to 1 if the
+///   manifest was fetched, 0 if the file has no remote manifest, or -1 if
+///   the file could not be read, is not a JPEG, PNG or TIFF, or its
+///   manifest could not be fetched.
+///
+/// # Errors
+/// Returns -1 if there were errors, including when no fetch callback is set,
+/// otherwise returns the number of manifests fetched.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+/// paths and results must point to at least count elements.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_prefetch_remote_manifests(
+    paths: *const *const c_char,
+    count: usize,
+    threads: c_uint,
+    results: *mut c_int,
+) -> c_int {
+    if count > 0 && (paths.is_null() || results.is_null()) {
+        Error::set_last(Error::NullParameter("paths or results".to_string()));
+        return -1;
+    }
+    if FETCHER.lock().map(|f| f.is_none()).unwrap_or(true) {
+        Error::NotSupported("prefetch needs a fetch callback".to_string()).set_last();
+        return -1;
+    }
+    if count == 0 {
+        return 0;
+    }
+    let paths: Vec<Option<PathBuf>> = std::slice::from_raw_parts(paths, count)
+        .iter()
+        .map(|path| {
+            (!path.is_null()).then(|| {
+                PathBuf::from(
+                    std::ffi::CStr::from_ptr(*path)
+                        .to_string_lossy()
+                        .into_owned(),
+                )
+            })
+        })
+        .collect();
+    let threads = match threads {
+        0 => thread::available_parallelism().map_or(1, |n| n.get()),
+        n => n as usize,
+    }
+    .min(count);
+
+    // each result plus one, so a slot no thread reached reads as failed
+    let outcomes: Vec<AtomicUsize> = (0..count).map(|_| AtomicUsize::new(0)).collect();
+    let next = AtomicUsize::new(0);
+    thread::scope(|scope| {
+        for _ in 0..threads {
+            scope.spawn(|| loop {
+                let index = next.fetch_add(1, Ordering::Relaxed);
+                if index >= count {
+                    break;
+                }
+                let outcome = match paths[index].as_deref().map(prefetch) {
+                    Some(Ok(true)) => 2,
+                    Some(Ok(false)) => 1,
+                    _ => 0,
+                };
+                outcomes[index].store(outcome, Ordering::Relaxed);
+            });
+        }
+    });
+
+    let results = std::slice::from_raw_parts_mut(results, count);
+    let mut fetched = 0;
+    for (result, outcome) in results.iter_mut().zip(&outcomes) {
+        *result = outcome.load(Ordering::Relaxed) as c_int - 1;
+        if *result == 1 {
+            fetched += 1;
+        }
+    }
+    fetched
+}
+
+#[cfg(test)]
+mod tests {
+    use std::{ffi::CString, io::Cursor};
+
+    use super::*;
+
+    // sets the time an entry was written, rather than sleeping between writes
+    fn set_age(cache: &Cache, url: &str, age: Duration) {
+        File::options()
+            .write(true)
+            .open(cache.path(url))
+            .unwrap()
+            .set_modified(SystemTime::now() - age)
+            .unwrap();
+    }
+
+    fn temp_dir(name: &str) -> PathBuf {
+        let dir = std::env::temp_dir().join(format!("c2pa_c_{}_{}", name, std::process::id()));
+        let _ = fs::remove_dir_all(&dir);
+        dir
+    }
+
+    #[test]
+    fn test_provenance_url() {
+        let attribute = b"<rdf:Description xmlns:dcterms=\"http://purl.org/dc/terms/\" \
+            dcterms:provenance=\"https://example.com/m.c2pa?a=1&amp;b=2\"/>";
+        assert_eq!(
+            provenance_url(&mut Cursor::new(&attribute[..])).unwrap(),
+            Some("https://example.com/m.c2pa?a=1&b=2".to_string())
+        );
+        let element = b"junk<dcterms:provenance> https://example.com/e.c2pa </dcterms:provenance>";
+        assert_eq!(
+            provenance_url(&mut Cursor::new(&element[..])).unwrap(),
+            Some("https://example.com/e.c2pa".to_string())
+        );
+        assert_eq!(
+            provenance_url(&mut Cursor::new(&b"no xmp here"[..])).unwrap(),
+            None
+        );
+    }
+
+    #[test]
+    fn test_rewrite_longest_prefix() {
+        let old = CString::new("https://old.example.com/").unwrap();
+        let old_c2pa = CString::new("https://old.example.com/c2pa/").unwrap();
+        let new = CString::new("https://cdn.example.net/").unwrap();
+        let new_c2pa = CString::new("https://cdn.example.net/manifests/").unwrap();
+        unsafe {
+            assert_eq!(c2pa_set_remote_url_rewrite(old.as_ptr(), new.as_ptr()), 0);
+            assert_eq!(
+                c2pa_set_remote_url_rewrite(old_c2pa.as_ptr(), new_c2pa.as_ptr()),
+                0
+            );
+        }
+        assert_eq!(
+            rewrite("https://old.example.com/c2pa/m.c2pa"),
+            "https://cdn.example.net/manifests/m.c2pa"
+        );
+        assert_eq!(
+            rewrite("https://old.example.com/other/m.c2pa"),
+            "https://cdn.example.net/other/m.c2pa"
+        );
+        assert_eq!(
+            rewrite("https://elsewhere/m.c2pa"),
+            "https://elsewhere/m.c2pa"
+        );
+        unsafe {
+            c2pa_set_remote_url_rewrite(old.as_ptr(), std::ptr::null());
+            c2pa_set_remote_url_rewrite(old_c2pa.as_ptr(), std::ptr::null());
+        }
+        assert_eq!(
+            rewrite("https://old.example.com/m.c2pa"),
+            "https://old.example.com/m.c2pa"
+        );
+    }
+
+    #[test]
+    fn test_cache_round_trip_and_trim() {
+        let dir = temp_dir("cache");
+        let cache = Cache::new(dir.clone(), None, Some(250));
+        cache.put("https://a", &[1u8; 100]).unwrap();
+        cache.put("https://b", &[2u8; 100]).unwrap();
+        set_age(&cache, "https://a", Duration::from_secs(20));
+        set_age(&cache, "https://b", Duration::from_secs(10));
+        assert_eq!(cache.get("https://a"), Some(vec![1u8; 100]));
+        assert_eq!(cache.get("https://c"), None);
+
+        // the oldest entry goes first once the limit is passed
+        cache.put("https://c", &[3u8; 100]).unwrap();
+        assert_eq!(cache.get("https://a"), None);
+        assert_eq!(cache.get("https://b"), Some(vec![2u8; 100]));
+        assert_eq!(cache.get("https://c"), Some(vec![3u8; 100]));
+        fs::remove_dir_all(dir).unwrap();
+    }
+
+    #[test]
+    fn test_prefetch_rejects_unscanned_formats() {
+        let dir = temp_dir("prefetch");
+        fs::create_dir_all(&dir).unwrap();
+        let unsigned = dir.join("unsigned.jpg");
+        fs::write(&unsigned, [0xFF, 0xD8, 0xFF, 0xD9]).unwrap();
+        assert!(!prefetch(&unsigned).unwrap());
+        let video = dir.join("video.mp4");
+        fs::write(&video, b"\0\0\0\x08free").unwrap();
+        assert!(matches!(prefetch(&video), Err(Error::NotSupported(_))));
+        fs::remove_dir_all(dir).unwrap();
+    }
+
+    #[test]
+    fn test_is_manifest_store() {
+        let mut store = 40u32.to_be_bytes().to_vec();
+        store.extend_from_slice(b"jumb");
+        store.extend_from_slice(&32u32.to_be_bytes());
+        store.extend_from_slice(b"jumd");
+        store.extend_from_slice(b"c2pa");
+        store.resize(40, 0);
+        assert!(is_manifest_store(&store));
+        assert!(!is_manifest_store(&store[..39]));
+        assert!(!is_manifest_store(b""));
+        assert!(!is_manifest_store(b"<html>not found</html>"));
+    }
+
+    #[test]
+    fn test_cache_expires() {
+        let dir = temp_dir("ttl");
+        let cache = Cache::new(dir.clone(), Some(Duration::from_secs(60)), None);
+        cache.put("https://a", b"store").unwrap();
+        assert_eq!(cache.get("https://a"), Some(b"store".to_vec()));
+        set_age(&cache, "https://a", Duration::from_secs(61));
+        assert_eq!(cache.get("https://a"), None);
+        fs::remove_dir_all(dir).unwrap();
+    }
+}
@@ -0,0 +1,119 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Skipping settings loads that would change nothing.
+//!
+//! Services tend to load the same settings before every read or for every
+//! worker. c2pa settings are process wide, so a load of exactly the text
+//! that is already in effect is skipped. That saves parsing the settings
+//! text, nothing more: c2pa keeps the trust anchors as PEM text and parses
+//! them again whenever it validates a signature.
+
+use std::sync::Mutex;
+
+/// The format and text of the settings in effect, None before the first
+/// load or after a failed one.
+static LOADED: Mutex<Option<(String, String)>> = Mutex::new(None);
+
+fn loaded() -> std::sync::MutexGuard<'static, Option<(String, String)>> {
+    LOADED.lock().unwrap_or_else(|e| e.into_inner())
+}
+
+/// Loads settings unless the same text in the same format is in effect.
+///
+/// Returns true if the settings were parsed, false if the load was skipped.
+pub(crate) fn load(settings: &str, format: &str) -> c2pa::Result<bool> {
+    // held while loading so concurrent loads of new text are not skipped
+    let mut loaded = loaded();
+    if matches!(&*loaded, Some((f, s)) if f == format && s == settings) {
+        return Ok(false);
+    }
+    // a failed load may have applied part of the text
+    *loaded = None;
+    c2pa::settings::load_settings_from_str(settings, format)?;
+    *loaded = Some((format.to_string(), settings.to_string()));
+    Ok(true)
+}
+
+/// Serializes the tests that change the process wide settings, and puts
+/// back the settings that were in effect when it was made.
+#[cfg(test)]
+pub(crate) struct TestGuard {
+    previous: Option<(String, String)>,
+    _lock: std::sync::MutexGuard<'static, ()>,
+}
+
+#[cfg(test)]
+impl TestGuard {
+    /// Waits for other settings tests, then forgets the settings in effect
+    /// so the test's first load is not skipped.
+    pub(crate) fn new() -> Self {
+        static LOCK: Mutex<()> = Mutex::new(());
+        let guard = LOCK.lock().unwrap_or_else(|e| e.into_inner());
+        Self {
+            previous: loaded().take(),
+            _lock: guard,
+        }
+    }
+}
+
+#[cfg(test)]
+impl Drop for TestGuard {
+    fn drop(&mut self) {
+        restore(self.previous.take());
+    }
+}
+
+/// Puts back settings taken from LOADED, or c2pa's defaults for None.
+#[cfg(test)]
+fn restore(previous: Option<(String, String)>) {
+    let mut loaded = loaded();
+    *loaded = None;
+    let restored = match &previous {
+        Some((format, settings)) => c2pa::settings::load_settings_from_str(settings, format),
+        // nothing was loaded through this library, so the defaults were in effect
+        None => c2pa::settings::reset_default_settings(),
+    };
+    if restored.is_ok() {
+        *loaded = previous;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_load_skips_same_text() {
+        let _guard = TestGuard::new();
+        let settings = r#"{"verify": {"verify_trust": false}}"#;
+        assert!(load(settings, "json").unwrap());
+        assert!(!load(settings, "json").unwrap());
+        // any change to the text loads it again
+        let reformatted = r#"{"verify": {"verify_trust":false}}"#;
+        assert!(load(reformatted, "json").unwrap());
+        assert!(load(settings, "json").unwrap());
+    }
+
+    #[test]
+    fn test_guard_restores_previous_settings() {
+        let _guard = TestGuard::new();
+        let settings = r#"{"verify": {"verify_trust": false}}"#;
+        assert!(load(settings, "json").unwrap());
+        let previous = loaded().take();
+        assert!(load(r#"{"verify": {"verify_trust": true}}"#, "json").unwrap());
+        restore(previous);
+        // the earlier text is in effect again
+        assert!(!load(settings, "json").unwrap());
+    }
+}
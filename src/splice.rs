@@ -0,0 +1,153 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Single pass signing for formats whose manifest is one contiguous block.
+//!
+//! The source is copied to the destination in two bulk copies around the
+//! insertion point, hashing as it goes, with a placeholder the size of the
+//! manifest in between. The signed manifest then overwrites the placeholder,
+//! so the source is read once and never parsed by c2pa.
+
+use std::io::{self, Read, Seek, SeekFrom, Write};
+
+use c2pa::{
+    assertions::{DataHash, HashRange},
+    Builder, Signer,
+};
+use sha2::{Digest, Sha256};
+
+const COPY_BUFFER_SIZE: usize = 256 * 1024;
+
+/// Where a manifest goes in the source.
+pub(crate) struct Splice<'a> {
+    /// The format c2pa formats the manifest for, "c2pa" for raw JUMBF.
+    pub format: &'a str,
+    /// The offset in the source to insert the manifest at.
+    pub offset: u64,
+    /// The number of source bytes at offset to leave out, such as an old manifest.
+    pub remove: u64,
+}
+
+/// Returns true if sign gives the same manifest as Builder::sign would.
+///
+/// The builder must embed its manifest and already have a thumbnail,
+/// since the data hashed signing path does not generate one.
+pub(crate) fn can_splice(builder: &Builder) -> bool {
+    !builder.no_embed && builder.remote_url.is_none() && builder.definition.thumbnail.is_some()
+}
+
+/// Signs by splicing the manifest into a single copy of the source.
+///
+/// frame wraps the bytes c2pa makes for splice.format in whatever the file
+/// format needs around them; its output must only depend on their length
+/// and content. Returns the bytes c2pa made, without the framing.
+pub(crate) fn sign<R, W, F>(
+    builder: &mut Builder,
+    signer: &dyn Signer,
+    splice: &Splice,
+    frame: F,
+    source: &mut R,
+    dest: &mut W,
+) -> c2pa::Result<Vec<u8>>
+where
+    R: Read + Seek,
+    W: Write + Seek,
+    F: Fn(&[u8]) -> Vec<u8>,
+{
+    // data_hashed_placeholder adds a DataHash assertion, which must not
+    // leak into later signs with this builder
+    let assertions = builder.definition.assertions.len();
+    let result = sign_once(builder, signer, splice, frame, source, dest);
+    builder.definition.assertions.truncate(assertions);
+    result
+}
+
+fn sign_once<R, W, F>(
+    builder: &mut Builder,
+    signer: &dyn Signer,
+    splice: &Splice,
+    frame: F,
+    source: &mut R,
+    dest: &mut W,
+) -> c2pa::Result<Vec<u8>>
+where
+    R: Read + Seek,
+    W: Write + Seek,
+    F: Fn(&[u8]) -> Vec<u8>,
+{
+    let placeholder =
+        frame(&builder.data_hashed_placeholder(signer.reserve_size(), splice.format)?);
+
+    let mut hasher = Sha256::new();
+    let mut buffer = vec![0u8; COPY_BUFFER_SIZE];
+    source.seek(SeekFrom::Start(0))?;
+    copy_hashed(
+        &mut source.take(splice.offset),
+        dest,
+        &mut hasher,
+        &mut buffer,
+    )?;
+    dest.write_all(&placeholder)?;
+    source.seek(SeekFrom::Start(splice.offset + splice.remove))?;
+    copy_hashed(source, dest, &mut hasher, &mut buffer)?;
+
+    let mut data_hash = DataHash::new("jumbf manifest", "sha256");
+    data_hash.add_exclusion(HashRange::new(splice.offset as usize, placeholder.len()));
+    data_hash.set_hash(hasher.finalize().to_vec());
+    let manifest = builder.sign_data_hashed_embeddable(signer, &data_hash, splice.format)?;
+    let framed = frame(&manifest);
+    if framed.len() != placeholder.len() {
+        return Err(c2pa::Error::BadParam(
+            "signed manifest does not match the reserved size".to_string(),
+        ));
+    }
+    dest.seek(SeekFrom::Start(splice.offset))?;
+    dest.write_all(&framed)?;
+    dest.seek(SeekFrom::End(0))?;
+    dest.flush()?;
+    Ok(manifest)
+}
+
+fn copy_hashed<R: Read + ?Sized, W: Write>(
+    source: &mut R,
+    dest: &mut W,
+    hasher: &mut Sha256,
+    buffer: &mut [u8],
+) -> io::Result<()> {
+    loop {
+        let len = match source.read(buffer) {
+            Ok(0) => return Ok(()),
+            Ok(len) => len,
+            Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+            Err(e) => return Err(e),
+        };
+        hasher.update(&buffer[..len]);
+        dest.write_all(&buffer[..len])?;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_copy_hashed_matches_digest() {
+        let data: Vec<u8> = (0..100_000u32).map(|i| i as u8).collect();
+        let mut hasher = Sha256::new();
+        let mut dest = Vec::new();
+        let mut buffer = vec![0u8; 4096];
+        copy_hashed(&mut data.as_slice(), &mut dest, &mut hasher, &mut buffer).unwrap();
+        assert_eq!(dest, data);
+        assert_eq!(hasher.finalize().to_vec(), Sha256::digest(&data).to_vec());
+    }
+}
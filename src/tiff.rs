@@ -0,0 +1,467 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! A fast path for C2PA data in TIFF based files such as DNG and camera RAW.
+//!
+//! The manifest store is the value of tag 0xCD41 in the first IFD, so
+//! finding it only needs the file header and that IFD's entries, never the
+//! strip or tile data. Everything else c2pa does with these files goes
+//! through ReadAhead, which turns its many small reads and seeks into large
+//! sequential reads.
+
+use std::io::{self, Read, Seek, SeekFrom};
+
+use c2pa::Reader;
+
+use crate::remote;
+
+/// The TIFF tag holding the C2PA manifest store.
+pub const C2PA_TAG: u16 = 0xCD41;
+
+// Large enough that hashing a file is a run of sequential reads the OS can prefetch.
+const READ_AHEAD_SIZE: usize = 1024 * 1024;
+
+// TIFF field types that hold a manifest store, BYTE and UNDEFINED.
+const TYPE_BYTE: u16 = 1;
+const TYPE_UNDEFINED: u16 = 7;
+
+/// Returns true if the format names a TIFF based file that c2pa supports.
+pub(crate) fn is_tiff(format: &str) -> bool {
+    [
+        "tif",
+        "tiff",
+        "image/tiff",
+        "dng",
+        "image/dng",
+        "image/x-adobe-dng",
+        "arw",
+        "image/x-sony-arw",
+        "nef",
+        "image/x-nikon-nef",
+    ]
+    .iter()
+    .any(|f| f.eq_ignore_ascii_case(format))
+}
+
+#[derive(Debug, Clone, Copy)]
+struct Header {
+    little_endian: bool,
+    big_tiff: bool,
+    first_ifd: u64,
+}
+
+impl Header {
+    fn u16(&self, bytes: &[u8]) -> u16 {
+        let bytes = [bytes[0], bytes[1]];
+        if self.little_endian {
+            u16::from_le_bytes(bytes)
+        } else {
+            u16::from_be_bytes(bytes)
+        }
+    }
+
+    fn u32(&self, bytes: &[u8]) -> u32 {
+        let bytes = [bytes[0], bytes[1], bytes[2], bytes[3]];
+        if self.little_endian {
+            u32::from_le_bytes(bytes)
+        } else {
+            u32::from_be_bytes(bytes)
+        }
+    }
+
+    fn u64(&self, bytes: &[u8]) -> u64 {
+        let mut buf = [0u8; 8];
+        buf.copy_from_slice(&bytes[..8]);
+        if self.little_endian {
+            u64::from_le_bytes(buf)
+        } else {
+            u64::from_be_bytes(buf)
+        }
+    }
+
+    // The sizes of the entry count, an entry, and the inline value field.
+    fn sizes(&self) -> (usize, usize, usize) {
+        if self.big_tiff {
+            (8, 20, 8)
+        } else {
+            (2, 12, 4)
+        }
+    }
+}
+
+fn invalid(message: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message.to_string())
+}
+
+fn read_header<R: Read>(stream: &mut R) -> io::Result<Option<Header>> {
+    let mut bytes = [0u8; 16];
+    if stream.read_exact(&mut bytes[..8]).is_err() {
+        return Ok(None);
+    }
+    let little_endian = match &bytes[0..2] {
+        b"II" => true,
+        b"MM" => false,
+        _ => return Ok(None),
+    };
+    let mut header = Header {
+        little_endian,
+        big_tiff: false,
+        first_ifd: 0,
+    };
+    match header.u16(&bytes[2..4]) {
+        42 => header.first_ifd = header.u32(&bytes[4..8]) as u64,
+        43 => {
+            stream.read_exact(&mut bytes[8..16])?;
+            header.big_tiff = true;
+            header.first_ifd = header.u64(&bytes[8..16]);
+        }
+        _ => return Ok(None),
+    }
+    Ok(Some(header))
+}
+
+/// Returns the manifest store from the first IFD of a TIFF stream.
+///
+/// Returns None if the stream is not a TIFF or has no C2PA tag.
+pub(crate) fn find_manifest<R: Read + Seek>(stream: &mut R) -> io::Result<Option<Vec<u8>>> {
+    stream.seek(SeekFrom::Start(0))?;
+    let Some(header) = read_header(stream)? else {
+        return Ok(None);
+    };
+    let stream_len = stream.seek(SeekFrom::End(0))?;
+    let (count_size, entry_size, value_size) = header.sizes();
+
+    stream.seek(SeekFrom::Start(header.first_ifd))?;
+    let mut count = [0u8; 8];
+    stream.read_exact(&mut count[..count_size])?;
+    let count = if header.big_tiff {
+        header.u64(&count)
+    } else {
+        header.u16(&count) as u64
+    };
+    // the count comes from the file, check it before allocating
+    let entries_len = count
+        .checked_mul(entry_size as u64)
+        .filter(|len| {
+            header
+                .first_ifd
+                .checked_add(count_size as u64)
+                .and_then(|start| start.checked_add(*len))
+                .is_some_and(|end| end <= stream_len)
+        })
+        .ok_or_else(|| invalid("TIFF IFD extends past the end of the file"))?;
+    // all the entries in one read, they are small and contiguous
+    let mut entries = vec![0u8; entries_len as usize];
+    stream.read_exact(&mut entries)?;
+
+    for entry in entries.chunks_exact(entry_size) {
+        if header.u16(&entry[0..2]) != C2PA_TAG {
+            continue;
+        }
+        let field_type = header.u16(&entry[2..4]);
+        if field_type != TYPE_BYTE && field_type != TYPE_UNDEFINED {
+            return Err(invalid("C2PA TIFF tag has the wrong type"));
+        }
+        let (len, value) = if header.big_tiff {
+            (header.u64(&entry[4..12]), &entry[12..20])
+        } else {
+            (header.u32(&entry[4..8]) as u64, &entry[8..12])
+        };
+        if len <= value_size as u64 {
+            return Ok(Some(value[..len as usize].to_vec()));
+        }
+        let offset = if header.big_tiff {
+            header.u64(value)
+        } else {
+            header.u32(value) as u64
+        };
+        if offset
+            .checked_add(len)
+            .filter(|end| *end <= stream_len)
+            .is_none()
+        {
+            return Err(invalid("C2PA TIFF tag extends past the end of the file"));
+        }
+        let mut manifest = vec![0u8; len as usize];
+        stream.seek(SeekFrom::Start(offset))?;
+        stream.read_exact(&mut manifest)?;
+        return Ok(Some(manifest));
+    }
+    Ok(None)
+}
+
+/// Creates a Reader from a TIFF, handing c2pa the manifest store from the first IFD.
+///
+/// Without a C2PA tag, a remote manifest referenced from XMP is read
+/// through the fetch callback and cache when they are set. Falls back to
+/// the general parser otherwise.
+pub(crate) fn read<R: Read + Seek + Send>(format: &str, stream: &mut R) -> c2pa::Result<Reader> {
+    let mut stream = ReadAhead::new(stream);
+    let manifest = find_manifest(&mut stream)?;
+    stream.seek(SeekFrom::Start(0))?;
+    match manifest {
+        Some(manifest) => Reader::from_manifest_data_and_stream(&manifest, format, stream),
+        None => {
+            remote::read(format, &mut stream).unwrap_or_else(|| Reader::from_stream(format, stream))
+        }
+    }
+}
+
+/// A read only stream that serves small reads and seeks from a large buffer.
+///
+/// Seeking within the buffer costs nothing, and refills read a whole buffer
+/// at a time, so a parser hopping around the metadata and then hashing the
+/// file makes a few large sequential reads of the underlying stream.
+pub(crate) struct ReadAhead<S> {
+    inner: S,
+    buffer: Vec<u8>,
+    // the stream offset of buffer[0]
+    buffer_start: u64,
+    filled: usize,
+    // the logical position and the position of inner
+    pos: u64,
+    inner_pos: Option<u64>,
+}
+
+impl<S: Read + Seek> ReadAhead<S> {
+    pub fn new(inner: S) -> Self {
+        Self::with_capacity(READ_AHEAD_SIZE, inner)
+    }
+
+    pub fn with_capacity(capacity: usize, inner: S) -> Self {
+        Self {
+            inner,
+            buffer: vec![0u8; capacity],
+            buffer_start: 0,
+            filled: 0,
+            pos: 0,
+            inner_pos: None,
+        }
+    }
+
+    fn seek_inner(&mut self, pos: u64) -> io::Result<()> {
+        if self.inner_pos != Some(pos) {
+            self.inner.seek(SeekFrom::Start(pos))?;
+            self.inner_pos = Some(pos);
+        }
+        Ok(())
+    }
+
+    // Reads as much as fits in buf, stopping early only at the end of the stream.
+    fn read_inner(&mut self, pos: u64, buf: &mut [u8]) -> io::Result<usize> {
+        self.seek_inner(pos)?;
+        let mut total = 0;
+        while total < buf.len() {
+            match self.inner.read(&mut buf[total..]) {
+                Ok(0) => break,
+                Ok(len) => total += len,
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+                Err(e) => {
+                    self.inner_pos = None;
+                    return Err(e);
+                }
+            }
+        }
+        self.inner_pos = Some(pos + total as u64);
+        Ok(total)
+    }
+}
+
+impl<S: Read + Seek> Read for ReadAhead<S> {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let buffer_end = self.buffer_start + self.filled as u64;
+        if self.pos < self.buffer_start || self.pos >= buffer_end {
+            if buf.len() >= self.buffer.len() {
+                // too big to be worth buffering
+                let len = self.read_inner(self.pos, buf)?;
+                self.pos += len as u64;
+                return Ok(len);
+            }
+            let mut buffer = std::mem::take(&mut self.buffer);
+            let filled = self.read_inner(self.pos, &mut buffer);
+            self.buffer = buffer;
+            self.buffer_start = self.pos;
+            self.filled = 0;
+            self.filled = filled?;
+            if self.filled == 0 {
+                return Ok(0);
+            }
+        }
+        let start = (self.pos - self.buffer_start) as usize;
+        let len = buf.len().min(self.filled - start);
+        buf[..len].copy_from_slice(&self.buffer[start..start + len]);
+        self.pos += len as u64;
+        Ok(len)
+    }
+}
+
+impl<S: Read + Seek> Seek for ReadAhead<S> {
+    fn seek(&mut self, pos: SeekFrom) -> io::Result<u64> {
+        self.pos = match pos {
+            SeekFrom::Start(offset) => offset,
+            SeekFrom::Current(delta) => self
+                .pos
+                .checked_add_signed(delta)
+                .ok_or_else(|| invalid("seek before the start of the stream"))?,
+            SeekFrom::End(delta) => {
+                let pos = self.inner.seek(SeekFrom::End(delta))?;
+                self.inner_pos = Some(pos);
+                pos
+            }
+        };
+        Ok(self.pos)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::io::Cursor;
+
+    use super::*;
+
+    // a classic TIFF with the manifest after a block of fake strip data
+    fn tiff(little_endian: bool, manifest: &[u8]) -> Vec<u8> {
+        let u16b = |v: u16| {
+            if little_endian {
+                v.to_le_bytes()
+            } else {
+                v.to_be_bytes()
+            }
+        };
+        let u32b = |v: u32| {
+            if little_endian {
+                v.to_le_bytes()
+            } else {
+                v.to_be_bytes()
+            }
+        };
+        let mut out = Vec::new();
+        out.extend_from_slice(if little_endian { b"II" } else { b"MM" });
+        out.extend_from_slice(&u16b(42));
+        out.extend_from_slice(&u32b(8));
+        // IFD0 with ImageWidth and the C2PA tag
+        out.extend_from_slice(&u16b(2));
+        out.extend_from_slice(&u16b(256));
+        out.extend_from_slice(&u16b(3));
+        out.extend_from_slice(&u32b(1));
+        out.extend_from_slice(&u32b(640));
+        out.extend_from_slice(&u16b(C2PA_TAG));
+        out.extend_from_slice(&u16b(TYPE_UNDEFINED));
+        out.extend_from_slice(&u32b(manifest.len() as u32));
+        if manifest.len() <= 4 {
+            let mut value = manifest.to_vec();
+            value.resize(4, 0);
+            out.extend_from_slice(&value);
+        } else {
+            out.extend_from_slice(&u32b(8 + 2 + 24 + 4 + 5000));
+        }
+        out.extend_from_slice(&u32b(0));
+        out.extend_from_slice(&[0xAB; 5000]);
+        out.extend_from_slice(manifest);
+        out
+    }
+
+    #[test]
+    fn test_find_manifest() {
+        let manifest: Vec<u8> = (0..300u16).map(|i| i as u8).collect();
+        for little_endian in [true, false] {
+            let bytes = tiff(little_endian, &manifest);
+            let found = find_manifest(&mut Cursor::new(&bytes)).unwrap();
+            assert_eq!(found, Some(manifest.clone()));
+        }
+        let bytes = tiff(true, b"abc");
+        assert_eq!(
+            find_manifest(&mut Cursor::new(&bytes)).unwrap(),
+            Some(b"abc".to_vec())
+        );
+        assert_eq!(
+            find_manifest(&mut Cursor::new(b"\xFF\xD8\xFF\xE0")).unwrap(),
+            None
+        );
+    }
+
+    #[test]
+    fn test_find_manifest_rejects_oversized_ifd() {
+        // a BigTIFF whose entry count overflows when multiplied by the entry size
+        let mut bytes = b"II".to_vec();
+        bytes.extend_from_slice(&43u16.to_le_bytes());
+        bytes.extend_from_slice(&8u16.to_le_bytes());
+        bytes.extend_from_slice(&0u16.to_le_bytes());
+        bytes.extend_from_slice(&16u64.to_le_bytes());
+        for count in [u64::MAX / 20 + 1, 1000] {
+            let mut file = bytes.clone();
+            file.extend_from_slice(&count.to_le_bytes());
+            file.extend_from_slice(&[0u8; 40]);
+            let error = find_manifest(&mut Cursor::new(&file)).unwrap_err();
+            assert_eq!(error.kind(), io::ErrorKind::InvalidData);
+        }
+    }
+
+    // counts the reads and seeks that reach the underlying stream
+    struct Counting {
+        inner: Cursor<Vec<u8>>,
+        reads: usize,
+        seeks: usize,
+    }
+
+    impl Read for Counting {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            self.reads += 1;
+            self.inner.read(buf)
+        }
+    }
+
+    impl Seek for Counting {
+        fn seek(&mut self, pos: SeekFrom) -> io::Result<u64> {
+            self.seeks += 1;
+            self.inner.seek(pos)
+        }
+    }
+
+    #[test]
+    fn test_read_ahead_matches_stream() {
+        let data: Vec<u8> = (0..50_000u32).map(|i| (i * 31) as u8).collect();
+        let mut plain = Cursor::new(data.clone());
+        let mut counting = Counting {
+            inner: Cursor::new(data.clone()),
+            reads: 0,
+            seeks: 0,
+        };
+        let mut ahead = ReadAhead::with_capacity(16 * 1024, &mut counting);
+
+        // small hops forward and back, as a parser walking metadata does
+        for (offset, len) in [
+            (10, 4),
+            (2, 8),
+            (4000, 12),
+            (3990, 100),
+            (49_990, 20),
+            (100, 20_000),
+        ] {
+            let mut expected = vec![0u8; len];
+            let mut actual = vec![0u8; len];
+            plain.seek(SeekFrom::Start(offset)).unwrap();
+            let expected_len = plain.read(&mut expected).unwrap();
+            ahead.seek(SeekFrom::Start(offset)).unwrap();
+            let mut actual_len = 0;
+            while actual_len < expected_len {
+                actual_len += ahead.read(&mut actual[actual_len..]).unwrap();
+            }
+            assert_eq!(actual[..actual_len], expected[..expected_len]);
+        }
+        assert_eq!(ahead.seek(SeekFrom::End(-10)).unwrap(), 49_990);
+        assert_eq!(ahead.seek(SeekFrom::Current(5)).unwrap(), 49_995);
+        drop(ahead);
+        assert!(counting.reads <= 10, "{} reads", counting.reads);
+    }
+}
@@ -0,0 +1,566 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+use std::{
+    cell::Cell,
+    fs::File,
+    io::{Read, Seek, SeekFrom, Write},
+    os::raw::{c_char, c_int, c_void},
+    sync::{
+        atomic::{AtomicBool, AtomicU64, Ordering},
+        Mutex, OnceLock, RwLock,
+    },
+    time::Instant,
+};
+
+use c2pa::{Signer, SigningAlg};
+
+use crate::{from_cstr_null_check_int, metrics, Error};
+
+/// The names of the spans emitted by this library.
+///
+/// Names are NULL-terminated so they can be handed to C without copying.
+/// The pointers stay valid for the lifetime of the process.
+pub(crate) mod names {
+    pub const READER_FROM_STREAM: &str = "reader.from_stream\0";
+    pub const READER_JSON: &str = "reader.json\0";
+    pub const READER_CBOR: &str = "reader.cbor\0";
+    pub const READER_RESOURCE: &str = "reader.resource_to_stream\0";
+    pub const READER_INGREDIENT: &str = "reader.ingredient\0";
+    pub const BUILDER_ADD_RESOURCE: &str = "builder.add_resource\0";
+    pub const BUILDER_ADD_INGREDIENT: &str = "builder.add_ingredient\0";
+    pub const BUILDER_ADD_INGREDIENTS: &str = "builder.add_ingredients\0";
+    pub const BUILDER_SIGN: &str = "builder.sign\0";
+    pub const BUILDER_SIGN_DATA_HASHED: &str = "builder.sign_data_hashed\0";
+    pub const BUILDER_SIGN_SIDECAR: &str = "builder.sign_sidecar\0";
+    pub const BUILDER_SIGN_WITH_PARENT: &str = "builder.sign_with_parent\0";
+    pub const SIGN_FILE: &str = "sign_file\0";
+    pub const SIGN_READ_SOURCE: &str = "sign.read_source\0";
+    pub const SIGN_WRITE_DEST: &str = "sign.write_dest\0";
+    pub const SIGN_HASH: &str = "sign.hash\0";
+    pub const SIGN_SIGNER: &str = "sign.signer\0";
+    pub const SIGN_TSA: &str = "sign.tsa\0";
+    pub const FRAGMENTS_ADD: &str = "fragments.add\0";
+    pub const FRAGMENTS_SIGN: &str = "fragments.sign\0";
+    pub const FRAGMENTS_VERIFY: &str = "fragments.verify\0";
+    pub const REMOTE_FETCH: &str = "remote.fetch\0";
+    pub const BINDING_HASH: &str = "binding.hash\0";
+    pub const BINDING_VERIFY: &str = "binding.verify\0";
+    pub const INIT: &str = "init\0";
+}
+
+#[repr(C)]
+#[derive(Debug, Clone)]
+/// A completed span of work reported to a trace callback.
+///
+/// Timestamps are in nanoseconds from a process wide monotonic epoch.
+pub struct C2paTraceSpan {
+    /// The NULL-terminated name of the phase, such as "builder.sign".
+    pub name: *const c_char,
+    /// The time the phase started.
+    pub start_ns: u64,
+    /// The time the phase ended.
+    pub end_ns: u64,
+    /// The number of bytes processed by the phase, or 0 if not applicable.
+    pub bytes: u64,
+    /// A small integer identifying the thread that ran the phase.
+    pub thread_id: u64,
+}
+
+/// Defines a callback to receive trace spans.
+///
+/// # Parameters
+/// * context: the context value passed to c2pa_set_trace_callback.
+/// * span: the completed span, only valid for the duration of the call.
+pub type TraceCallback = unsafe extern "C" fn(context: *const c_void, span: *const C2paTraceSpan);
+
+// Where finished spans are sent.
+enum Sink {
+    Callback {
+        context: usize,
+        callback: TraceCallback,
+    },
+    Chrome(ChromeWriter),
+}
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static SINK: Mutex<Option<Sink>> = Mutex::new(None);
+// Read while a callback runs, so replacing the sink can wait for those calls.
+static CALLING: RwLock<()> = RwLock::new(());
+static EPOCH: OnceLock<Instant> = OnceLock::new();
+static NEXT_THREAD_ID: AtomicU64 = AtomicU64::new(1);
+
+thread_local! {
+    static THREAD_ID: u64 = NEXT_THREAD_ID.fetch_add(1, Ordering::Relaxed);
+    static IN_CALLBACK: Cell<bool> = const { Cell::new(false) };
+}
+
+/// Returns nanoseconds since the trace epoch.
+pub(crate) fn now_ns() -> u64 {
+    EPOCH.get_or_init(Instant::now).elapsed().as_nanos() as u64
+}
+
+/// Returns true if a trace sink is installed.
+#[inline]
+pub(crate) fn enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+// Replaces the current sink, finishing any Chrome trace file in progress.
+//
+// Returns once calls to a replaced callback have returned, so its context
+// can be released.
+fn set_sink(sink: Option<Sink>) -> std::io::Result<()> {
+    let previous = {
+        let mut guard = SINK.lock().unwrap_or_else(|e| e.into_inner());
+        ENABLED.store(sink.is_some(), Ordering::Relaxed);
+        std::mem::replace(&mut *guard, sink)
+    };
+    // a callback replacing the sink would wait for itself
+    if !IN_CALLBACK.with(Cell::get) {
+        drop(CALLING.write().unwrap_or_else(|e| e.into_inner()));
+    }
+    match previous {
+        Some(Sink::Chrome(writer)) => writer.finish(),
+        _ => Ok(()),
+    }
+}
+
+// Sends a finished span to the installed sink.
+fn emit(name: &'static str, start_ns: u64, end_ns: u64, bytes: u64) {
+    let span = C2paTraceSpan {
+        name: name.as_ptr() as *const c_char,
+        start_ns,
+        end_ns,
+        bytes,
+        thread_id: THREAD_ID.with(|id| *id),
+    };
+    // spans from within a callback are covered by its guard
+    let nested = IN_CALLBACK.with(Cell::get);
+    let _calling = (!nested).then(|| CALLING.read().unwrap_or_else(|e| e.into_inner()));
+    let mut guard = SINK.lock().unwrap_or_else(|e| e.into_inner());
+    match guard.as_mut() {
+        Some(Sink::Callback { context, callback }) => {
+            let (context, callback) = (*context, *callback);
+            // don't hold the lock while calling out, the callback may call back into us
+            drop(guard);
+            IN_CALLBACK.with(|c| c.set(true));
+            unsafe { (callback)(context as *const c_void, &span) };
+            IN_CALLBACK.with(|c| c.set(nested));
+        }
+        Some(Sink::Chrome(writer)) => {
+            // tracing must never fail the traced operation
+            let _ = writer.write_span(name.trim_end_matches('\0'), &span);
+        }
+        None => {}
+    }
+}
+
+/// Measures one phase of work and reports it when dropped.
+pub(crate) struct Span {
+    name: &'static str,
+    start_ns: u64,
+    bytes: u64,
+    active: bool,
+}
+
+impl Span {
+    /// Starts a span, this is nearly free when tracing is off.
+    pub fn new(name: &'static str) -> Self {
+        let active = enabled();
+        Self {
+            name,
+            start_ns: if active { now_ns() } else { 0 },
+            bytes: 0,
+            active,
+        }
+    }
+
+    /// Adds to the number of bytes processed in this span.
+    pub fn add_bytes(&mut self, bytes: u64) {
+        self.bytes += bytes;
+    }
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        if self.active {
+            emit(self.name, self.start_ns, now_ns(), self.bytes);
+        }
+    }
+}
+
+// The window of time between the first and last I/O call in one direction.
+#[derive(Debug, Default)]
+struct IoWindow {
+    start_ns: Option<u64>,
+    end_ns: u64,
+    bytes: u64,
+}
+
+impl IoWindow {
+    fn record(&mut self, start_ns: u64, end_ns: u64, bytes: usize) {
+        self.start_ns.get_or_insert(start_ns);
+        self.end_ns = end_ns;
+        self.bytes += bytes as u64;
+    }
+
+    fn emit(&self, name: &'static str) {
+        if let Some(start_ns) = self.start_ns {
+            emit(name, start_ns, self.end_ns, self.bytes);
+        }
+    }
+}
+
+/// Wraps a stream to count the bytes moved through it.
+///
+/// When tracing is on it also records the window from the first to
+/// the last read and write so they can be reported as spans.
+pub(crate) struct TracedStream<S> {
+    inner: S,
+    timed: bool,
+    reads: IoWindow,
+    writes: IoWindow,
+}
+
+impl<S> TracedStream<S> {
+    pub fn new(inner: S) -> Self {
+        Self {
+            inner,
+            timed: enabled(),
+            reads: IoWindow::default(),
+            writes: IoWindow::default(),
+        }
+    }
+
+    /// Returns the number of bytes read from the stream.
+    pub fn bytes_read(&self) -> u64 {
+        self.reads.bytes
+    }
+
+    /// Emits a span covering all reads from the stream.
+    pub fn emit_reads(&self, name: &'static str) {
+        self.reads.emit(name);
+    }
+
+    /// Emits a span covering all writes to the stream.
+    pub fn emit_writes(&self, name: &'static str) {
+        self.writes.emit(name);
+    }
+}
+
+impl<S: Read> Read for TracedStream<S> {
+    fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+        if !self.timed {
+            let len = self.inner.read(buf)?;
+            self.reads.bytes += len as u64;
+            return Ok(len);
+        }
+        let start = now_ns();
+        let len = self.inner.read(buf)?;
+        self.reads.record(start, now_ns(), len);
+        Ok(len)
+    }
+}
+
+impl<S: Write> Write for TracedStream<S> {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        if !self.timed {
+            let len = self.inner.write(buf)?;
+            self.writes.bytes += len as u64;
+            return Ok(len);
+        }
+        let start = now_ns();
+        let len = self.inner.write(buf)?;
+        self.writes.record(start, now_ns(), len);
+        Ok(len)
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        self.inner.flush()
+    }
+}
+
+impl<S: Seek> Seek for TracedStream<S> {
+    fn seek(&mut self, pos: SeekFrom) -> std::io::Result<u64> {
+        self.inner.seek(pos)
+    }
+}
+
+/// Wraps a Signer to report the signing callback and time stamp requests
+/// as spans and to record their latency in the metrics.
+pub(crate) struct TracedSigner<'a> {
+    inner: &'a dyn Signer,
+}
+
+impl<'a> TracedSigner<'a> {
+    pub fn new(inner: &'a dyn Signer) -> Self {
+        Self { inner }
+    }
+}
+
+impl Signer for TracedSigner<'_> {
+    fn sign(&self, data: &[u8]) -> c2pa::Result<Vec<u8>> {
+        let mut span = Span::new(names::SIGN_SIGNER);
+        span.add_bytes(data.len() as u64);
+        let start = Instant::now();
+        let result = self.inner.sign(data);
+        metrics::record_signer(start.elapsed());
+        result
+    }
+
+    fn alg(&self) -> SigningAlg {
+        self.inner.alg()
+    }
+
+    fn certs(&self) -> c2pa::Result<Vec<Vec<u8>>> {
+        self.inner.certs()
+    }
+
+    fn reserve_size(&self) -> usize {
+        self.inner.reserve_size()
+    }
+
+    fn ocsp_val(&self) -> Option<Vec<u8>> {
+        self.inner.ocsp_val()
+    }
+
+    fn time_authority_url(&self) -> Option<String> {
+        self.inner.time_authority_url()
+    }
+
+    fn timestamp_request_headers(&self) -> Option<Vec<(String, String)>> {
+        self.inner.timestamp_request_headers()
+    }
+
+    fn timestamp_request_body(&self, message: &[u8]) -> c2pa::Result<Vec<u8>> {
+        self.inner.timestamp_request_body(message)
+    }
+
+    fn send_timestamp_request(&self, message: &[u8]) -> Option<c2pa::Result<Vec<u8>>> {
+        let mut span = Span::new(names::SIGN_TSA);
+        let start = Instant::now();
+        let result = self.inner.send_timestamp_request(message);
+        if result.is_some() {
+            metrics::record_tsa(start.elapsed());
+        }
+        if let Some(Ok(response)) = result.as_ref() {
+            span.add_bytes(response.len() as u64);
+        }
+        result
+    }
+
+    fn direct_cose_handling(&self) -> bool {
+        self.inner.direct_cose_handling()
+    }
+}
+
+/// Writes spans to a file in the Chrome trace-event JSON array format.
+///
+/// The output can be loaded in chrome://tracing or https://ui.perfetto.dev.
+struct ChromeWriter {
+    file: File,
+    pid: u32,
+    first: bool,
+}
+
+impl ChromeWriter {
+    fn create(path: &str) -> std::io::Result<Self> {
+        let mut file = File::create(path)?;
+        file.write_all(b"[")?;
+        Ok(Self {
+            file,
+            pid: std::process::id(),
+            first: true,
+        })
+    }
+
+    // Each event is written with a single call so a crash leaves a loadable file.
+    fn write_span(&mut self, name: &str, span: &C2paTraceSpan) -> std::io::Result<()> {
+        let event = format!(
+            "{}\n{{\"name\":\"{}\",\"cat\":\"c2pa\",\"ph\":\"X\",\"ts\":{:.3},\"dur\":{:.3},\"pid\":{},\"tid\":{},\"args\":{{\"bytes\":{}}}}}",
+            if self.first { "" } else { "," },
+            name,
+            span.start_ns as f64 / 1000.0,
+            span.end_ns.saturating_sub(span.start_ns) as f64 / 1000.0,
+            self.pid,
+            span.thread_id,
+            span.bytes
+        );
+        self.first = false;
+        self.file.write_all(event.as_bytes())
+    }
+
+    fn finish(mut self) -> std::io::Result<()> {
+        self.file.write_all(b"\n]\n")?;
+        self.file.flush()
+    }
+}
+
+/// Registers a callback to receive a span for each phase of reading and signing.
+///
+/// Replaces any trace callback or trace file set previously.
+/// Pass a NULL callback to turn tracing off.
+///
+/// # Parameters
+/// * context: a value passed back to the callback, often a pointer to a collector.
+/// * callback: the callback to invoke for each completed span, or NULL.
+///
+/// # Safety
+/// The context must remain valid until tracing is turned off. Turning it
+/// off returns once calls to the callback in progress on other threads
+/// have returned.
+/// The callback may be called from any thread that calls into this library.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_set_trace_callback(
+    context: *const c_void,
+    callback: Option<TraceCallback>,
+) {
+    let sink = callback.map(|callback| Sink::Callback {
+        context: context as usize,
+        callback,
+    });
+    // only a previous trace file can fail to close, and there is no one to report it to
+    let _ = set_sink(sink);
+}
+
+/// Writes all spans to a file as Chrome trace-event JSON.
+///
+/// Replaces any trace callback or trace file set previously.
+/// Call c2pa_trace_stop to complete the file.
+///
+/// # Errors
+/// Returns -1 if the file could not be created, otherwise returns 0.
+/// The error string can be retrieved by calling c2pa_error.
+///
+/// # Safety
+/// Reads from NULL-terminated C strings.
+#[no_mangle]
+pub unsafe extern "C" fn c2pa_set_trace_file(path: *const c_char) -> c_int {
+    let path = from_cstr_null_check_int!(path);
+    match ChromeWriter::create(&path).and_then(|writer| set_sink(Some(Sink::Chrome(writer)))) {
+        Ok(_) => 0,
+        Err(e) => {
+            Error::Io(e.to_string()).set_last();
+            -1
+        }
+    }
+}
+
+/// Turns tracing off and completes any trace file in progress.
+///
+/// # Errors
+/// Returns -1 if the trace file could not be completed, otherwise returns 0.
+/// The error string can be retrieved by calling c2pa_error.
+#[no_mangle]
+pub extern "C" fn c2pa_trace_stop() -> c_int {
+    match set_sink(None) {
+        Ok(_) => 0,
+        Err(e) => {
+            Error::Io(e.to_string()).set_last();
+            -1
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::ffi::CStr;
+
+    use super::*;
+
+    // the trace sink is process wide, so tests that install one must not overlap
+    static TEST_LOCK: Mutex<()> = Mutex::new(());
+    static SPANS: Mutex<Vec<(String, u64)>> = Mutex::new(Vec::new());
+
+    unsafe extern "C" fn collect(_context: *const c_void, span: *const C2paTraceSpan) {
+        let span = &*span;
+        let name = CStr::from_ptr(span.name).to_string_lossy().into_owned();
+        assert!(span.end_ns >= span.start_ns);
+        SPANS.lock().unwrap().push((name, span.bytes));
+    }
+
+    #[test]
+    fn test_trace_callback() {
+        let _lock = TEST_LOCK.lock().unwrap();
+        SPANS.lock().unwrap().clear();
+        unsafe { c2pa_set_trace_callback(std::ptr::null(), Some(collect)) };
+        {
+            let mut span = Span::new(names::BUILDER_SIGN);
+            span.add_bytes(42);
+        }
+        let mut stream = TracedStream::new(std::io::Cursor::new(vec![0u8; 100]));
+        let mut buf = [0u8; 60];
+        stream.read_exact(&mut buf).unwrap();
+        stream.emit_reads(names::SIGN_READ_SOURCE);
+        stream.emit_writes(names::SIGN_WRITE_DEST);
+        unsafe { c2pa_set_trace_callback(std::ptr::null(), None) };
+        // nothing is reported once tracing is off
+        drop(Span::new(names::READER_JSON));
+
+        let spans = SPANS.lock().unwrap();
+        assert_eq!(
+            *spans,
+            vec![
+                ("builder.sign".to_string(), 42),
+                ("sign.read_source".to_string(), 60)
+            ]
+        );
+    }
+
+    static SLOW_CALLS: AtomicU64 = AtomicU64::new(0);
+
+    unsafe extern "C" fn slow(_context: *const c_void, _span: *const C2paTraceSpan) {
+        std::thread::sleep(std::time::Duration::from_millis(50));
+        SLOW_CALLS.fetch_add(1, Ordering::SeqCst);
+    }
+
+    #[test]
+    fn test_trace_stop_waits_for_callbacks() {
+        let _lock = TEST_LOCK.lock().unwrap();
+        SLOW_CALLS.store(0, Ordering::SeqCst);
+        unsafe { c2pa_set_trace_callback(std::ptr::null(), Some(slow)) };
+        let worker = std::thread::spawn(|| drop(Span::new(names::SIGN_HASH)));
+        // let the worker reach the callback
+        while CALLING.try_write().is_ok() && !worker.is_finished() {
+            std::thread::yield_now();
+        }
+        unsafe { c2pa_set_trace_callback(std::ptr::null(), None) };
+        let calls = SLOW_CALLS.load(Ordering::SeqCst);
+        worker.join().unwrap();
+        // no call was still running or delivered after tracing stopped
+        assert_eq!(SLOW_CALLS.load(Ordering::SeqCst), calls);
+    }
+
+    #[test]
+    fn test_trace_file() {
+        let _lock = TEST_LOCK.lock().unwrap();
+        std::fs::create_dir_all("target/tmp").unwrap();
+        let path = "target/tmp/trace_test.json";
+        let c_path = std::ffi::CString::new(path).unwrap();
+        assert_eq!(unsafe { c2pa_set_trace_file(c_path.as_ptr()) }, 0);
+        for _ in 0..3 {
+            let mut span = Span::new(names::SIGN_HASH);
+            span.add_bytes(1024);
+        }
+        assert_eq!(c2pa_trace_stop(), 0);
+
+        let trace: serde_json::Value =
+            serde_json::from_str(&std::fs::read_to_string(path).unwrap()).unwrap();
+        let events = trace.as_array().unwrap();
+        assert_eq!(events.len(), 3);
+        assert_eq!(events[0]["name"], "sign.hash");
+        assert_eq!(events[0]["ph"], "X");
+        assert_eq!(events[0]["args"]["bytes"], 1024);
+    }
+}
@@ -15,6 +15,7 @@
 #include <gtest/gtest.h>
 
 #include <fstream>
+#include <nlohmann/json.hpp>
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -31,6 +32,16 @@ string read_text_file(const fs::path &path) {
   return contents.data();
 }
 
+/// @brief Encode a BMFF box
+string bmff_box(const string &type, const string &body) {
+  const auto size = static_cast<uint32_t>(body.size() + 8);
+  string box;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    box += static_cast<char>((size >> shift) & 0xff);
+  }
+  return box + type + body;
+}
+
 TEST(Builder, SignFile) {
 
   fs::path current_dir = fs::path(__FILE__).parent_path();
@@ -250,3 +261,238 @@ TEST(Builder, SignDataHashedEmbeddedWithAsset) {
     FAIL() << "Failed: C2pa::Builder: " << e.what() << endl;
   };
 }
+
+TEST(Builder, SignSidecar) {
+  fs::path current_dir = fs::path(__FILE__).parent_path();
+
+  fs::path manifest_path = current_dir / "../tests/fixtures/training.json";
+  fs::path certs_path = current_dir / "../tests/fixtures/es256_certs.pem";
+  fs::path image_path = current_dir / "../tests/fixtures/A.jpg";
+  fs::path other_image_path = current_dir / "../tests/fixtures/C.jpg";
+  fs::path sidecar_path = current_dir / "../target/example/A.c2pa";
+
+  try {
+    auto manifest = read_text_file(manifest_path);
+    auto certs = read_text_file(certs_path);
+    auto signer = c2pa::Signer(&test_signer, Es256, certs, nullopt);
+
+    fs::create_directories(sidecar_path.parent_path());
+    const auto source_size = fs::file_size(image_path);
+
+    auto builder = c2pa::Builder(manifest);
+    auto manifest_data = builder.sign_sidecar(image_path, sidecar_path, signer);
+    ASSERT_FALSE(manifest_data.empty());
+    ASSERT_EQ(fs::file_size(sidecar_path), manifest_data.size());
+    // the original is only read
+    ASSERT_EQ(fs::file_size(image_path), source_size);
+
+    // the sidecar validates against the source it was made for
+    std::ifstream original(image_path, std::ios::binary);
+    auto store = nlohmann::json::parse(
+        c2pa::Reader("image/jpeg", original, manifest_data).json());
+    ASSERT_TRUE(store["active_manifest"].is_string());
+    const auto active = store["active_manifest"].get<string>();
+    ASSERT_TRUE(store["manifests"].contains(active));
+    for (const auto &status :
+         store.value("validation_status", nlohmann::json::array())) {
+      // the test certificate is not in a trust list
+      EXPECT_EQ(status["code"], "signingCredential.untrusted") << status;
+    }
+
+    // and not against another asset
+    std::ifstream other(other_image_path, std::ios::binary);
+    auto mismatched = c2pa::Reader("image/jpeg", other, manifest_data).json();
+    EXPECT_NE(mismatched.find("assertion.dataHash.mismatch"),
+              std::string::npos);
+
+    // the same builder can sign again
+    std::ifstream source(image_path, std::ios::binary);
+    auto again = builder.sign_sidecar("image/jpeg", source, signer);
+    ASSERT_FALSE(again.empty());
+
+    std::istringstream video("not read");
+    ASSERT_THROW(builder.sign_sidecar("video/mp4", video, signer),
+                 c2pa::Exception);
+  } catch (c2pa::Exception const &e) {
+    FAIL() << "Failed: C2pa::Builder: " << e.what() << endl;
+  };
+}
+
+TEST(Builder, SignWithParent) {
+  fs::path current_dir = fs::path(__FILE__).parent_path();
+
+  fs::path manifest_path = current_dir / "../tests/fixtures/training.json";
+  fs::path certs_path = current_dir / "../tests/fixtures/es256_certs.pem";
+  fs::path signed_image_path = current_dir / "../tests/fixtures/C.jpg";
+  fs::path unsigned_image_path = current_dir / "../tests/fixtures/A.jpg";
+
+  try {
+    auto manifest = read_text_file(manifest_path);
+    auto certs = read_text_file(certs_path);
+    auto signer = c2pa::Signer(&test_signer, Es256, certs, nullopt);
+    auto builder = c2pa::Builder(manifest);
+
+    // a signed source becomes the parent
+    std::ifstream source(signed_image_path, std::ios::binary);
+    std::stringstream dest(std::ios::in | std::ios::out | std::ios::binary);
+    builder.sign_with_parent("image/jpeg", source, dest, signer);
+    dest.seekg(0, std::ios::beg);
+    auto json = c2pa::Reader("image/jpeg", dest).json();
+    ASSERT_TRUE(json.find("parentOf") != std::string::npos);
+
+    // an unsigned one does not, and the parent did not stay on the builder
+    std::ifstream unsigned_source(unsigned_image_path, std::ios::binary);
+    std::stringstream unsigned_dest(std::ios::in | std::ios::out |
+                                    std::ios::binary);
+    builder.sign_with_parent("image/jpeg", unsigned_source, unsigned_dest,
+                             signer);
+    unsigned_dest.seekg(0, std::ios::beg);
+    json = c2pa::Reader("image/jpeg", unsigned_dest).json();
+    ASSERT_TRUE(json.find("parentOf") == std::string::npos);
+  } catch (c2pa::Exception const &e) {
+    FAIL() << "Failed: C2pa::Builder: " << e.what() << endl;
+  };
+}
+
+TEST(Builder, AddIngredients) {
+  fs::path current_dir = fs::path(__FILE__).parent_path();
+
+  fs::path manifest_path = current_dir / "../tests/fixtures/training.json";
+  fs::path certs_path = current_dir / "../tests/fixtures/es256_certs.pem";
+  fs::path image_path = current_dir / "../tests/fixtures/A.jpg";
+  fs::path signed_image_path = current_dir / "../tests/fixtures/C.jpg";
+
+  try {
+    auto manifest = read_text_file(manifest_path);
+    auto certs = read_text_file(certs_path);
+    auto signer = c2pa::Signer(&test_signer, Es256, certs, nullopt);
+    auto builder = c2pa::Builder(manifest);
+
+    std::ifstream first(image_path, std::ios::binary);
+    std::ifstream second(signed_image_path, std::ios::binary);
+    std::ifstream third(image_path, std::ios::binary);
+    builder.add_ingredients(std::vector<c2pa::IngredientSource>{
+        {"{\"title\":\"First\"}", "image/jpeg", &first},
+        {"{\"title\":\"Second\"}", "image/jpeg", &second},
+        {"{\"title\":\"Third\"}", "image/jpeg", &third}});
+
+    std::ifstream source(image_path, std::ios::binary);
+    std::stringstream dest(std::ios::in | std::ios::out | std::ios::binary);
+    auto _ = builder.sign("image/jpeg", source, dest, signer);
+    dest.seekg(0, std::ios::beg);
+    auto json = c2pa::Reader("image/jpeg", dest).json();
+
+    // attached in the order given, whichever finished first
+    auto first_at = json.find("\"First\"");
+    auto second_at = json.find("\"Second\"");
+    auto third_at = json.find("\"Third\"");
+    ASSERT_NE(third_at, std::string::npos);
+    EXPECT_LT(first_at, second_at);
+    EXPECT_LT(second_at, third_at);
+  } catch (c2pa::Exception const &e) {
+    FAIL() << "Failed: C2pa::Builder: " << e.what() << endl;
+  };
+}
+
+TEST(Builder, AddIngredientsWithoutStreamThrows) {
+  auto builder = c2pa::Builder(R"({"title": "no stream"})");
+  std::ifstream image(fs::path(__FILE__).parent_path() / "fixtures/A.jpg",
+                      std::ios::binary);
+  EXPECT_THROW(builder.add_ingredients(std::vector<c2pa::IngredientSource>{
+                   {"{\"title\":\"First\"}", "image/jpeg", &image},
+                   {"{\"title\":\"Second\"}", "image/jpeg", nullptr}}),
+               c2pa::Exception);
+}
+
+TEST(Builder, FromCbor) {
+  fs::path current_dir = fs::path(__FILE__).parent_path();
+
+  fs::path manifest_path = current_dir / "../tests/fixtures/training.json";
+  fs::path certs_path = current_dir / "../tests/fixtures/es256_certs.pem";
+  fs::path image_path = current_dir / "../tests/fixtures/A.jpg";
+
+  try {
+    auto manifest = read_text_file(manifest_path);
+    auto certs = read_text_file(certs_path);
+    auto signer = c2pa::Signer(&test_signer, Es256, certs, nullopt);
+
+    auto cbor = nlohmann::json::to_cbor(nlohmann::json::parse(manifest));
+    auto builder = c2pa::Builder(cbor, c2pa::ManifestEncoding::Cbor);
+
+    std::ifstream source(image_path, std::ios::binary);
+    std::stringstream dest(std::ios::in | std::ios::out | std::ios::binary);
+    auto _ = builder.sign("image/jpeg", source, dest, signer);
+    dest.seekg(0, std::ios::beg);
+    auto json = c2pa::Reader("image/jpeg", dest).json();
+    ASSERT_TRUE(json.find("cawg.training-mining") != std::string::npos);
+
+    // checked like JSON, a definition must be a map
+    auto not_a_map = nlohmann::json::to_cbor("not a manifest");
+    EXPECT_THROW(c2pa::Builder(not_a_map, c2pa::ManifestEncoding::Cbor),
+                 c2pa::Exception);
+  } catch (c2pa::Exception const &e) {
+    FAIL() << "Failed: C2pa::Builder: " << e.what() << endl;
+  };
+}
+
+TEST(Builder, SignFragmented) {
+  fs::path current_dir = fs::path(__FILE__).parent_path();
+
+  fs::path manifest_path = current_dir / "../tests/fixtures/training.json";
+  fs::path certs_path = current_dir / "../tests/fixtures/es256_certs.pem";
+
+  try {
+    auto manifest = read_text_file(manifest_path);
+    auto certs = read_text_file(certs_path);
+    auto signer = c2pa::Signer(&test_signer, Es256, certs, nullopt);
+    auto builder = c2pa::Builder(manifest);
+
+    // a version 0 movie header with an identity matrix
+    string mvhd(100, '\0');
+    mvhd[14] = 0x03; // timescale 1000
+    mvhd[15] = static_cast<char>(0xe8);
+    mvhd[21] = 0x01; // rate 1.0
+    mvhd[24] = 0x01; // volume 1.0
+    mvhd[37] = 0x01; // matrix a
+    mvhd[53] = 0x01; // matrix d
+    mvhd[68] = 0x40; // matrix w
+    mvhd[99] = 0x02; // next track id
+    const string ftyp("iso6\0\0\0\0iso6", 12);
+    std::istringstream init(bmff_box("ftyp", ftyp) +
+                            bmff_box("moov", bmff_box("mvhd", mvhd)));
+    c2pa::FragmentedSession session(builder, "video/mp4", init);
+
+    vector<string> fragments;
+    for (char i = 0; i < 3; i++) {
+      fragments.push_back(bmff_box("moof", string(100, 'a' + i)) +
+                          bmff_box("mdat", string(5000, 'x' + i)));
+      std::istringstream fragment(fragments.back());
+      ASSERT_EQ(session.add_fragment(fragment), fragments.size());
+    }
+    std::stringstream signed_init(std::ios::in | std::ios::out |
+                                  std::ios::binary);
+    auto manifest_data = session.sign(signed_init, signer);
+    ASSERT_FALSE(manifest_data.empty());
+
+    signed_init.seekg(0, std::ios::beg);
+    auto reader = c2pa::Reader("video/mp4", signed_init);
+    ASSERT_TRUE(reader.json().find("org.contentauth.fragments") !=
+                std::string::npos);
+
+    auto verify = [&reader](const vector<string> &recorded) {
+      vector<std::istringstream> streams;
+      streams.reserve(recorded.size());
+      vector<std::istream *> pointers;
+      for (const auto &fragment : recorded) {
+        pointers.push_back(&streams.emplace_back(fragment));
+      }
+      return reader.verify_fragments(pointers);
+    };
+    EXPECT_TRUE(verify(fragments));
+    EXPECT_FALSE(verify({fragments[0], fragments[1]}));
+    fragments[1][50] = 'z';
+    EXPECT_FALSE(verify(fragments));
+  } catch (c2pa::Exception const &e) {
+    FAIL() << "Failed: C2pa::FragmentedSession: " << e.what() << endl;
+  };
+}
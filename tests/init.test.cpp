@@ -0,0 +1,49 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "test_signer.hpp"
+#include <c2pa.hpp>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+TEST(Init, ReadingOnly) {
+  const auto report = c2pa::initialize();
+  EXPECT_EQ(report.steps, C2PA_INIT_READER);
+  EXPECT_EQ(report.settings_ns, 0u);
+  EXPECT_EQ(report.sign_ns, 0u);
+  EXPECT_EQ(report.validate_ns, 0u);
+}
+
+TEST(Init, WarmsUpSigner) {
+  const fs::path certs_path =
+      fs::path(__FILE__).parent_path() / "fixtures/es256_certs.pem";
+  std::ifstream file(certs_path);
+  std::stringstream certs;
+  certs << file.rdbuf();
+  const auto signer = c2pa::Signer(&test_signer, Es256, certs.str(), nullopt);
+
+  // settings are process wide, the ones in effect are kept
+  const auto report = c2pa::initialize(nullopt, "json", &signer);
+  EXPECT_EQ(report.steps,
+            C2PA_INIT_READER | C2PA_INIT_SIGNER | C2PA_INIT_VALIDATION);
+  EXPECT_GT(report.sign_ns, 0u);
+  EXPECT_GT(report.validate_ns, 0u);
+}
+
+TEST(Init, BadSettingsThrow) {
+  EXPECT_THROW(c2pa::initialize("{not json", "json"), c2pa::Exception);
+}
@@ -0,0 +1,62 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include <c2pa.hpp>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+TEST(Metrics, CountsReadersAndErrors) {
+  const fs::path current_dir = fs::path(__FILE__).parent_path();
+  const auto before = c2pa::Metrics::snapshot();
+
+  const auto reader = c2pa::Reader(current_dir / "../tests/fixtures/C.jpg");
+  EXPECT_THROW(c2pa::Reader(current_dir / "../tests/fixtures/A.jpg"),
+               c2pa::Exception);
+
+  const auto after = c2pa::Metrics::snapshot();
+  EXPECT_EQ(after.readers_opened, before.readers_opened + 1);
+  EXPECT_EQ(after.read_latency.count, before.read_latency.count + 1);
+  EXPECT_EQ(after.errors.manifest_not_found,
+            before.errors.manifest_not_found + 1);
+  EXPECT_EQ(after.in_flight, 0u);
+  EXPECT_GE(after.peak_in_flight, 1u);
+};
+
+TEST(Metrics, PercentileUsesBucketBounds) {
+  C2paHistogram histogram{};
+  histogram.count = 4;
+  histogram.max_us = 700;
+  histogram.buckets[3] = 3; // 4..8us
+  histogram.buckets[10] = 1; // 512..1024us
+
+  EXPECT_EQ(c2pa::Metrics::percentile_us(histogram, 50.0), 8u);
+  EXPECT_EQ(c2pa::Metrics::percentile_us(histogram, 99.0), 700u);
+  EXPECT_EQ(c2pa::Metrics::percentile_us(C2paHistogram{}, 50.0), 0u);
+};
+
+TEST(AllocStats, CountsReaderAllocations) {
+  const fs::path current_dir = fs::path(__FILE__).parent_path();
+  try {
+    c2pa::enable_alloc_tracking();
+  } catch (const c2pa::Exception &) {
+    GTEST_SKIP() << "library built without the alloc_tracking feature";
+  }
+
+  const auto reader = c2pa::Reader(current_dir / "../tests/fixtures/C.jpg");
+  const auto stats = c2pa::last_alloc_stats();
+  c2pa::enable_alloc_tracking(false);
+
+  EXPECT_GT(stats.allocations, 0u);
+  EXPECT_GE(stats.bytes_allocated, stats.peak_bytes);
+  EXPECT_GT(stats.peak_bytes, 0u);
+};
@@ -10,12 +10,80 @@
 // specific language governing permissions and limitations under
 // each license.
 
+#include "test_signer.hpp"
 #include <c2pa.hpp>
+#include <filesystem>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <gtest/gtest.h>
 #include <nlohmann/json.hpp>
 
 using nlohmann::json;
+namespace fs = std::filesystem;
+
+namespace {
+const fs::path fixtures = fs::path(__FILE__).parent_path() / "fixtures";
+
+std::string read_fixture(const std::string &name) {
+  std::ifstream file(fixtures / name);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+/// Signs A.jpg into dest with the files as ingredients, in order.
+void sign_with_ingredients(const fs::path &dest,
+                           const std::vector<fs::path> &ingredients) {
+  auto signer = c2pa::Signer(&test_signer, Es256,
+                             read_fixture("es256_certs.pem"), nullopt);
+  auto builder = c2pa::Builder(read_fixture("training.json"));
+  for (const auto &ingredient : ingredients) {
+    builder.add_ingredient("{}", ingredient);
+  }
+  fs::remove(dest);
+  builder.sign(fixtures / "A.jpg", dest, signer);
+}
+
+/// Counts the nodes of a walk at each depth.
+std::map<unsigned, size_t> depth_counts(c2pa::IngredientWalk walk) {
+  std::map<unsigned, size_t> counts;
+  for (const auto &node : walk) {
+    ++counts[node.depth];
+  }
+  return counts;
+}
+
+/// A file stream that records when it is destroyed.
+class TrackedStream : public std::ifstream {
+public:
+  TrackedStream(const fs::path &path, bool &closed_)
+      : std::ifstream(path, std::ios::binary), closed(closed_) {}
+  ~TrackedStream() override { closed = true; }
+
+private:
+  bool &closed;
+};
+
+// what fetch_remote_store serves, and the URLs it was asked for
+std::vector<unsigned char> remote_store;
+std::vector<std::string> fetched_urls;
+
+std::optional<std::vector<unsigned char>>
+fetch_remote_store(const std::string &url) {
+  fetched_urls.push_back(url);
+  return remote_store;
+}
+
+size_t cache_entries(const fs::path &dir) {
+  size_t entries = 0;
+  for (const auto &entry : fs::directory_iterator(dir)) {
+    entries += entry.path().extension() == ".c2pa";
+  }
+  return entries;
+}
+} // namespace
 
 TEST(Reader, StreamWithManifest) {
   // read the new manifest and display the JSON
@@ -49,3 +117,209 @@ TEST(Reader, FileNotFound) {
     FAIL() << "Expected c2pa::Exception Failed to open file";
   }
 };
+
+TEST(Reader, WalkIngredients) {
+  const auto reader = c2pa::Reader("../../tests/fixtures/C.jpg");
+  auto store = json::parse(reader.json());
+  const auto &active = store["manifests"][store["active_manifest"]];
+
+  size_t count = 0;
+  for (const auto &node : reader.ingredients()) {
+    EXPECT_EQ(node.depth, 1u);
+    EXPECT_TRUE(node.manifest_label.empty());
+    EXPECT_EQ(node.index, count);
+    auto ingredient = json::parse(reader.ingredient_json(node));
+    EXPECT_EQ(ingredient["title"], active["ingredients"][count]["title"]);
+    EXPECT_TRUE(
+        json::parse(reader.ingredient_validation_status(node)).is_array());
+    ++count;
+  }
+  EXPECT_EQ(count, active["ingredients"].size());
+
+};
+
+TEST(Reader, WalkNestedIngredients) {
+  const auto dir = fs::temp_directory_path() / "c2pa_walk_nested";
+  fs::create_directories(dir);
+
+  // C.jpg's ingredients have no manifests of their own
+  auto c_store = json::parse(c2pa::Reader(fixtures / "C.jpg").json());
+  const auto &c_ingredients =
+      c_store["manifests"][c_store["active_manifest"].get<std::string>()]
+             ["ingredients"];
+  for (const auto &ingredient : c_ingredients) {
+    ASSERT_FALSE(ingredient.contains("active_manifest"));
+  }
+  const size_t leaves = c_ingredients.size();
+  ASSERT_GT(leaves, 0u);
+
+  // nested holds C.jpg, and top holds nested and C.jpg again, so C.jpg's
+  // manifest is reached by two paths
+  sign_with_ingredients(dir / "nested.jpg", {fixtures / "C.jpg"});
+  sign_with_ingredients(dir / "top.jpg",
+                        {dir / "nested.jpg", fixtures / "C.jpg"});
+  const auto reader = c2pa::Reader(dir / "top.jpg");
+
+  using Counts = std::map<unsigned, size_t>;
+  EXPECT_EQ(depth_counts(reader.ingredients()), (Counts{{1, 2}}));
+  EXPECT_EQ(depth_counts(reader.ingredients(2)), (Counts{{1, 2}, {2, 2}}));
+  // a bounded walk expands C.jpg under both paths
+  EXPECT_EQ(depth_counts(reader.ingredients(3)),
+            (Counts{{1, 2}, {2, 1 + leaves}, {3, leaves}}));
+  // an unlimited walk expands it the first time only
+  EXPECT_EQ(depth_counts(reader.ingredients(0)),
+            (Counts{{1, 2}, {2, 1}, {3, leaves}}));
+
+  // skipping nested leaves C.jpg to be expanded under top
+  auto walk = reader.ingredients(0);
+  Counts skipped;
+  for (const auto &node : walk) {
+    ++skipped[node.depth];
+    if (node.depth == 1 && node.index == 0) {
+      walk.skip_children();
+    }
+  }
+  EXPECT_EQ(skipped, (Counts{{1, 2}, {2, leaves}}));
+  fs::remove_all(dir);
+};
+
+TEST(Reader, OwnsStream) {
+  bool closed = false;
+  // the caller's stream is only in scope while the Reader is made
+  auto reader = [&closed] {
+    auto stream = std::make_unique<TrackedStream>(fixtures / "C.jpg", closed);
+    return c2pa::Reader("image/jpeg", std::move(stream));
+  }();
+  EXPECT_FALSE(closed);
+
+  // the source stays with the Reader when it moves
+  auto moved = std::move(reader);
+  auto store = json::parse(moved.json());
+  const auto &active = store["manifests"][store["active_manifest"]];
+  std::ostringstream thumbnail;
+  EXPECT_GT(moved.get_resource(active["thumbnail"]["identifier"], thumbnail),
+            0);
+  EXPECT_FALSE(thumbnail.str().empty());
+  EXPECT_FALSE(closed);
+
+  // and is closed with it
+  {
+    auto last = std::move(moved);
+  }
+  EXPECT_TRUE(closed);
+};
+
+TEST(Reader, BindingHashFindsCopies) {
+  auto reader =
+      c2pa::Reader(std::filesystem::path("../../tests/fixtures/C.jpg"));
+  auto binding = reader.binding_hash();
+
+  std::ifstream signed_file("../../tests/fixtures/C.jpg", std::ios::binary);
+  EXPECT_EQ(json::parse(c2pa::compute_binding_hash("image/jpeg", signed_file)),
+            json::parse(binding));
+
+  signed_file.seekg(0);
+  std::ifstream other_file("../../tests/fixtures/A.jpg", std::ios::binary);
+  auto results =
+      c2pa::verify_binding_hashes(binding, {&signed_file, &other_file});
+  EXPECT_EQ(results, (std::vector<int>{1, 0}));
+};
+
+TEST(Reader, CborIsSmallerThanJson) {
+  auto reader =
+      c2pa::Reader(std::filesystem::path("../../tests/fixtures/C.jpg"));
+  auto cbor = reader.cbor();
+  ASSERT_FALSE(cbor.empty());
+  // the store is a map, CBOR major type 5
+  EXPECT_EQ(cbor[0] >> 5, 5);
+  EXPECT_LT(cbor.size(), reader.json().size());
+  // and holds the same store as the JSON
+  EXPECT_EQ(nlohmann::json::from_cbor(cbor),
+            nlohmann::json::parse(reader.json()));
+};
+
+TEST(Reader, RemoteManifestThroughCallbackAndCache) {
+  const std::string url = "https://manifests.example.com/remote.c2pa";
+  const auto cache_dir = fs::temp_directory_path() / "c2pa_remote_cache";
+  fs::remove_all(cache_dir);
+
+  // an asset whose manifest is only referenced from its XMP
+  auto signer = c2pa::Signer(&test_signer, Es256,
+                             read_fixture("es256_certs.pem"), nullopt);
+  auto builder = c2pa::Builder(read_fixture("training.json"));
+  builder.set_no_embed();
+  builder.set_remote_url(url);
+  std::ifstream source(fixtures / "A.jpg", std::ios::binary);
+  std::stringstream asset(std::ios::in | std::ios::out | std::ios::binary);
+  const auto store = builder.sign("image/jpeg", source, asset, signer);
+  auto read_label = [&asset] {
+    asset.clear();
+    asset.seekg(0);
+    auto read = json::parse(c2pa::Reader("image/jpeg", asset).json());
+    return read["active_manifest"].get<std::string>();
+  };
+
+  c2pa::set_fetch_callback(&fetch_remote_store);
+  c2pa::set_remote_cache(cache_dir);
+  fetched_urls.clear();
+
+  // a body that is not a manifest store fails the read and is not cached
+  remote_store = {'n', 'o', 't', ' ', 'c', '2', 'p', 'a'};
+  EXPECT_THROW(read_label(), c2pa::Exception);
+  EXPECT_EQ(cache_entries(cache_dir), 0u);
+
+  // the callback's store is read, then cached
+  remote_store = store;
+  const auto label = read_label();
+  EXPECT_FALSE(label.empty());
+  EXPECT_EQ(fetched_urls, (std::vector<std::string>{url, url}));
+  EXPECT_EQ(cache_entries(cache_dir), 1u);
+
+  // later reads come from the cache, even without the callback
+  c2pa::set_fetch_callback(nullptr);
+  EXPECT_EQ(read_label(), label);
+  EXPECT_EQ(fetched_urls.size(), 2u);
+
+  c2pa::disable_remote_cache();
+  fs::remove_all(cache_dir);
+};
+
+TEST(Reader, PrefetchedRewrittenRemoteManifest) {
+  const std::string old_url = "https://old.example.com/c2pa/moved.c2pa";
+  const std::string new_url = "https://new.example.com/c2pa/moved.c2pa";
+  const auto cache_dir = fs::temp_directory_path() / "c2pa_prefetch_cache";
+  const auto asset_path = fs::temp_directory_path() / "c2pa_prefetch.jpg";
+  fs::remove_all(cache_dir);
+
+  // an asset that still points at the old server
+  auto signer = c2pa::Signer(&test_signer, Es256,
+                             read_fixture("es256_certs.pem"), nullopt);
+  auto builder = c2pa::Builder(read_fixture("training.json"));
+  builder.set_no_embed();
+  builder.set_remote_url(old_url);
+  fs::remove(asset_path);
+  remote_store = builder.sign(fixtures / "A.jpg", asset_path, signer);
+
+  c2pa::set_fetch_callback(&fetch_remote_store);
+  c2pa::set_remote_cache(cache_dir);
+  c2pa::set_remote_url_rewrite("https://old.example.com/",
+                               "https://new.example.com/");
+  fetched_urls.clear();
+
+  // one thread, fetch_remote_store is not thread safe
+  EXPECT_EQ(c2pa::prefetch_remote_manifests({asset_path}, 1),
+            (std::vector<int>{1}));
+  EXPECT_EQ(fetched_urls, (std::vector<std::string>{new_url}));
+  EXPECT_EQ(cache_entries(cache_dir), 1u);
+
+  // the Reader rewrites the URL the same way and finds it in the cache
+  c2pa::set_fetch_callback(nullptr);
+  const auto read = json::parse(c2pa::Reader(asset_path).json());
+  EXPECT_FALSE(read["active_manifest"].get<std::string>().empty());
+  EXPECT_EQ(fetched_urls.size(), 1u);
+
+  c2pa::set_remote_url_rewrite("https://old.example.com/", nullopt);
+  c2pa::disable_remote_cache();
+  fs::remove_all(cache_dir);
+  fs::remove(asset_path);
+};
@@ -0,0 +1,123 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include <atomic>
+#include <c2pa.hpp>
+#include <c2pa_view.hpp>
+#include <filesystem>
+#include <fstream>
+#include <latch>
+#include <memory>
+#include <signd.hpp>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+const fs::path fixtures = fs::path(__FILE__).parent_path() / "fixtures";
+
+/// Runs a daemon with the fixture keys for the life of the test.
+class SigndTest : public testing::Test {
+protected:
+  void SetUp() override {
+    socket_path = fs::temp_directory_path() /
+                  ("c2pa-signd-" + std::to_string(getpid()) + ".sock");
+    // one signing thread, so every request shares its signing contexts
+    server = std::make_unique<c2pa::signd::Server>(
+        std::vector<c2pa::signd::KeyConfig>{
+            {"default", "es256", fixtures / "es256_private.key",
+             fixtures / "es256_certs.pem"},
+            {"ed25519", "ed25519", fixtures / "ed25519.pem",
+             fixtures / "ed25519.pub"}},
+        1);
+    thread = std::thread([this] {
+      try {
+        server->serve(socket_path);
+      } catch (const std::exception &e) {
+        ADD_FAILURE() << "serve failed: " << e.what();
+        serve_failed = true;
+      }
+    });
+    // wait for the socket
+    for (int i = 0; i < 500 && !serve_failed && !fs::exists(socket_path);
+         i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_FALSE(serve_failed);
+    ASSERT_TRUE(fs::exists(socket_path));
+    c2pa::signd::configure(socket_path);
+  }
+
+  void TearDown() override {
+    server->stop();
+    thread.join();
+    // the client configuration is process wide
+    c2pa::signd::configure({});
+  }
+
+  fs::path socket_path;
+  std::unique_ptr<c2pa::signd::Server> server;
+  std::thread thread;
+  std::atomic<bool> serve_failed{false};
+};
+} // namespace
+
+TEST_F(SigndTest, SignsForBuilder) {
+  const auto certs = c2pa::signd::certificates();
+  EXPECT_EQ(certs.rfind("-----BEGIN CERTIFICATE-----", 0), 0u);
+
+  auto signer = c2pa::Signer(&c2pa::signd::sign, Es256, certs, std::nullopt);
+  auto builder = c2pa::Builder(R"({"title": "signd.jpg"})");
+  std::ifstream source(fixtures / "A.jpg", std::ios::binary);
+  std::stringstream dest(std::ios::in | std::ios::out | std::ios::binary);
+  auto manifest = builder.sign("image/jpeg", source, dest, signer);
+  EXPECT_FALSE(manifest.empty());
+
+  dest.seekg(0);
+  const auto reader = c2pa::Reader("image/jpeg", dest);
+  EXPECT_EQ(reader.store().active_manifest().title(), "signd.jpg");
+  EXPECT_EQ(reader.json().find("claimSignature.mismatch"), std::string::npos);
+}
+
+TEST_F(SigndTest, SharesContextAcrossRequests) {
+  c2pa::signd::configure(socket_path, "ed25519");
+  const std::vector<unsigned char> data(1024, 7);
+  std::vector<std::thread> clients;
+  std::vector<size_t> sizes(16);
+  std::latch start(static_cast<std::ptrdiff_t>(sizes.size()));
+  for (size_t i = 0; i < sizes.size(); i++) {
+    clients.emplace_back([&, i] {
+      start.arrive_and_wait();
+      for (int j = 0; j < 8; j++) {
+        sizes[i] = c2pa::signd::sign(data).size();
+      }
+    });
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+  for (const size_t size : sizes) {
+    EXPECT_EQ(size, 64u);
+  }
+  EXPECT_EQ(server->signed_count(), 128u);
+  // the one signing thread set up the key once for every request
+  EXPECT_EQ(server->context_count(), 1u);
+}
+
+TEST_F(SigndTest, UnknownKey) {
+  c2pa::signd::configure(socket_path, "missing");
+  EXPECT_THROW(c2pa::signd::sign({1, 2, 3}), std::runtime_error);
+}
@@ -0,0 +1,62 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include <c2pa.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+std::vector<std::pair<std::string, uint64_t>> spans;
+
+void collect_span(const C2paTraceSpan &span) {
+  spans.emplace_back(span.name, span.bytes);
+}
+} // namespace
+
+TEST(Trace, CallbackReceivesReaderSpans) {
+  const fs::path current_dir = fs::path(__FILE__).parent_path();
+  spans.clear();
+  c2pa::set_trace_callback(&collect_span);
+
+  std::ifstream file_stream(current_dir / "../tests/fixtures/C.jpg",
+                            std::ios::binary);
+  const auto reader = c2pa::Reader("image/jpeg", file_stream);
+  const auto json = reader.json();
+  c2pa::set_trace_callback(nullptr);
+
+  ASSERT_EQ(spans.size(), 2u);
+  EXPECT_EQ(spans[0].first, "reader.from_stream");
+  EXPECT_GT(spans[0].second, 0u);
+  EXPECT_EQ(spans[1].first, "reader.json");
+  EXPECT_EQ(spans[1].second, json.size());
+};
+
+TEST(Trace, WritesChromeTraceFile) {
+  const fs::path current_dir = fs::path(__FILE__).parent_path();
+  const fs::path trace_path = current_dir / "../target/trace.json";
+  fs::create_directories(trace_path.parent_path());
+
+  c2pa::set_trace_file(trace_path);
+  const auto reader = c2pa::Reader(current_dir / "../tests/fixtures/C.jpg");
+  c2pa::stop_trace();
+
+  std::ifstream trace(trace_path);
+  const std::string contents((std::istreambuf_iterator<char>(trace)),
+                             std::istreambuf_iterator<char>());
+  EXPECT_EQ(contents.front(), '[');
+  EXPECT_TRUE(contents.find("\"name\":\"reader.from_stream\"") !=
+              std::string::npos);
+};
@@ -0,0 +1,124 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include <c2pa.hpp>
+#include <c2pa_view.hpp>
+#include <fcntl.h>
+#include <filesystem>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <verifyd.hpp>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+const fs::path fixtures = fs::path(__FILE__).parent_path() / "fixtures";
+
+/// Runs a daemon for the life of the test.
+class VerifydTest : public testing::Test {
+protected:
+  void SetUp() override {
+    socket_path = fs::temp_directory_path() /
+                  ("c2pa-verifyd-" + std::to_string(getpid()) + ".sock");
+    restart(1024, size_t{64} << 20);
+  }
+
+  void TearDown() override {
+    server->stop();
+    thread.join();
+  }
+
+  /// Replaces the daemon with one keeping results within the limits.
+  void restart(size_t cache_entries, size_t cache_bytes) {
+    if (server) {
+      server->stop();
+      thread.join();
+    }
+    server =
+        std::make_unique<c2pa::verifyd::Server>(4, cache_entries, cache_bytes);
+    thread = std::thread([this] { server->serve(socket_path); });
+    // wait for the socket
+    for (int i = 0; i < 500 && !fs::exists(socket_path); i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  fs::path socket_path;
+  std::unique_ptr<c2pa::verifyd::Server> server;
+  std::thread thread;
+};
+} // namespace
+
+TEST_F(VerifydTest, VerifiesPathsAndDescriptors) {
+  c2pa::verifyd::Client client(socket_path);
+  const auto summary = client.verify(fixtures / "C.jpg");
+  EXPECT_NE(summary.find("\"title\":\"C.jpg\""), std::string::npos);
+
+  const int fd = open((fixtures / "C.jpg").c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(client.verify(fd, "image/jpeg"), summary);
+  // the daemon reads without moving the client's offset
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+  close(fd);
+
+  const auto cbor = client.store(fixtures / "C.jpg");
+  EXPECT_EQ(c2pa::ManifestStoreView(cbor).active_manifest().title(), "C.jpg");
+
+  EXPECT_THROW(client.verify(fixtures / "A.jpg"), std::runtime_error);
+}
+
+TEST_F(VerifydTest, CoalescesRequestsForOneFile) {
+  // nothing is kept, so only waiting for a read saves one
+  restart(0, 0);
+  std::vector<std::thread> clients;
+  std::vector<std::string> summaries(16);
+  std::latch start(static_cast<std::ptrdiff_t>(summaries.size()));
+  for (size_t i = 0; i < summaries.size(); i++) {
+    clients.emplace_back([&, i] {
+      c2pa::verifyd::Client client(socket_path);
+      start.arrive_and_wait();
+      summaries[i] = client.verify(fixtures / "C.jpg");
+    });
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+  for (const auto &summary : summaries) {
+    EXPECT_EQ(summary, summaries[0]);
+  }
+  EXPECT_EQ(server->cache_hit_count(), 0u);
+  EXPECT_GT(server->coalesced_count(), 0u);
+  EXPECT_EQ(server->read_count() + server->coalesced_count(), 16u);
+}
+
+TEST_F(VerifydTest, KeepsResultsWithinByteBudget) {
+  c2pa::verifyd::Client client(socket_path);
+  const auto cbor = client.store(fixtures / "C.jpg");
+  client.store(fixtures / "C.jpg");
+  EXPECT_EQ(server->cache_hit_count(), 1u);
+
+  // a store bigger than the budget is read every time
+  restart(1024, cbor.size() - 1);
+  c2pa::verifyd::Client small(socket_path);
+  small.store(fixtures / "C.jpg");
+  small.store(fixtures / "C.jpg");
+  EXPECT_EQ(server->cache_hit_count(), 0u);
+  EXPECT_EQ(server->read_count(), 2u);
+  // while the summary fits
+  small.verify(fixtures / "C.jpg");
+  small.verify(fixtures / "C.jpg");
+  EXPECT_EQ(server->cache_hit_count(), 1u);
+}
@@ -0,0 +1,155 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include <c2pa.hpp>
+#include <c2pa_view.hpp>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+using nlohmann::json;
+
+namespace {
+const json store_json = {
+    {"active_manifest", "urn:b"},
+    {"manifests",
+     {{"urn:a", {{"title", "A.jpg"}}},
+      {"urn:b",
+       {{"title", "C.jpg"},
+        {"format", "image/jpeg"},
+        {"thumbnail", {{"identifier", "self#jumbf=thumb"}}},
+        {"assertions",
+         {{{"label", "c2pa.actions"}, {"data", {{"actions", json::array()}}}},
+          {{"label", "c2pa.training-mining"},
+           {"data",
+            {{"entries",
+              {{"c2pa.ai_training", {{"use", "notAllowed"}}}}}}}}}},
+        {"ingredients",
+         {{{"title", "A.jpg"},
+           {"relationship", "parentOf"},
+           {"active_manifest", "urn:a"}}}}}}}}};
+} // namespace
+
+TEST(View, ReadsStoreFields) {
+  const auto cbor = json::to_cbor(store_json);
+  const auto store = c2pa::ManifestStoreView(cbor);
+  ASSERT_TRUE(store.valid());
+  EXPECT_EQ(store.active_label(), "urn:b");
+  EXPECT_EQ(store.manifests().size(), 2u);
+
+  const auto manifest = store.active_manifest();
+  ASSERT_TRUE(manifest.valid());
+  EXPECT_EQ(manifest.label(), "urn:b");
+  EXPECT_EQ(manifest.title(), "C.jpg");
+  EXPECT_EQ(manifest.format(), "image/jpeg");
+  EXPECT_EQ(manifest.thumbnail_identifier(), "self#jumbf=thumb");
+
+  // the strings point into the buffer rather than copies of it
+  const auto *begin = reinterpret_cast<const char *>(cbor.data());
+  EXPECT_GE(manifest.title().data(), begin);
+  EXPECT_LT(manifest.title().data(), begin + cbor.size());
+
+  const auto assertion = manifest.assertion("c2pa.training-mining");
+  ASSERT_TRUE(assertion.valid());
+  EXPECT_EQ(
+      assertion.data()["entries"]["c2pa.ai_training"]["use"].text(),
+      "notAllowed");
+  EXPECT_FALSE(manifest.assertion("c2pa.hash.data").valid());
+
+  size_t count = 0;
+  for (const auto ingredient : manifest.ingredients()) {
+    EXPECT_EQ(ingredient.relationship(), "parentOf");
+    EXPECT_EQ(store.manifest(ingredient.active_manifest()).title(), "A.jpg");
+    count++;
+  }
+  EXPECT_EQ(count, 1u);
+}
+
+TEST(View, ReadsScalars) {
+  const json values = {
+      {"n", -5}, {"big", 1u << 31}, {"f", 1.5}, {"t", true}, {"z", nullptr}};
+  const auto cbor = json::to_cbor(values);
+  const auto root = c2pa::CborValue(cbor);
+  EXPECT_EQ(root.size(), 5u);
+  EXPECT_EQ(root["n"].integer(), -5);
+  EXPECT_EQ(root["big"].integer(), int64_t{1} << 31);
+  EXPECT_EQ(root["f"].number(), 1.5);
+  EXPECT_EQ(root["t"].boolean(), true);
+  EXPECT_EQ(root["z"].type(), c2pa::CborValue::Type::Null);
+  EXPECT_FALSE(root["missing"].valid());
+  EXPECT_FALSE(root["n"]["nested"].valid());
+  EXPECT_EQ(root.encoded().size(), cbor.size());
+}
+
+TEST(View, ReadsIndefiniteLengths) {
+  // {_ "a": [_ 1, 2], "h": 1.0 as a half float, "s": tagged "x"}
+  const std::vector<uint8_t> cbor = {0xbf, 0x61, 'a', 0x9f, 0x01, 0x02,
+                                     0xff, 0x61, 'h', 0xf9, 0x3c, 0x00,
+                                     0x61, 's',  0xc0, 0x61, 'x',  0xff};
+  const auto root = c2pa::CborValue(cbor);
+  EXPECT_EQ(root.type(), c2pa::CborValue::Type::Map);
+  EXPECT_EQ(root.size(), 3u);
+  EXPECT_EQ(root["a"].size(), 2u);
+  EXPECT_EQ(root["a"][size_t{1}].integer(), 2);
+  EXPECT_EQ(root["h"].number(), 1.0);
+  EXPECT_EQ(root["s"].text(), "x");
+  EXPECT_EQ(root.encoded().size(), cbor.size());
+}
+
+TEST(View, RejectsTruncatedInput) {
+  const auto cbor = json::to_cbor(store_json);
+  for (size_t length = 0; length < cbor.size(); length++) {
+    const auto store = c2pa::ManifestStoreView(
+        std::span<const uint8_t>(cbor.data(), length));
+    // every field is either missing or within the truncated buffer
+    const auto title = store.active_manifest().title();
+    if (!title.empty()) {
+      EXPECT_LE(title.data() + title.size(),
+                reinterpret_cast<const char *>(cbor.data()) + length);
+    }
+    EXPECT_TRUE(store.value().encoded().empty());
+  }
+}
+
+TEST(View, ReaderStore) {
+  auto reader = c2pa::Reader("../../tests/fixtures/C.jpg");
+  const auto store = reader.store();
+  ASSERT_TRUE(store.valid());
+  const auto manifest = store.active_manifest();
+  EXPECT_EQ(manifest.title(), "C.jpg");
+  EXPECT_FALSE(manifest.thumbnail_identifier().empty());
+
+  // the view stays valid when the Reader is moved
+  const auto moved = std::move(reader);
+  EXPECT_EQ(store.active_manifest().title(), "C.jpg");
+  EXPECT_EQ(moved.store().active_label(), store.active_label());
+}
+
+TEST(View, ReaderStoreFromThreads) {
+  const auto reader = c2pa::Reader("../../tests/fixtures/C.jpg");
+  // the first calls race to encode the CBOR, all must see one buffer
+  std::vector<const unsigned char *> buffers(8);
+  std::vector<std::thread> threads;
+  for (auto &buffer : buffers) {
+    threads.emplace_back([&reader, &buffer] {
+      buffer = reader.kept_cbor().data();
+      EXPECT_EQ(reader.store().active_manifest().title(), "C.jpg");
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto *buffer : buffers) {
+    EXPECT_EQ(buffer, reader.kept_cbor().data());
+  }
+}
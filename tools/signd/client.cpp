@@ -0,0 +1,110 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "signd.hpp"
+#include "unix_socket.hpp"
+
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+
+namespace c2pa::signd {
+
+namespace {
+struct Config {
+  std::filesystem::path socket_path;
+  std::string key = "default";
+  // bumped by configure() so threads drop connections to the old daemon
+  uint64_t generation = 0;
+};
+
+std::mutex config_mutex;
+Config config;
+
+struct Connection {
+  tools::Fd fd;
+  uint64_t generation = 0;
+};
+
+thread_local Connection connection;
+
+std::vector<uint8_t> request(Operation operation,
+                             std::span<const uint8_t> data) {
+  Config current;
+  {
+    const std::lock_guard lock(config_mutex);
+    current = config;
+  }
+  if (current.key.size() > 255) {
+    throw std::runtime_error("key name is too long");
+  }
+  std::vector<uint8_t> frame;
+  frame.reserve(data.size() + current.key.size() + 2);
+  frame.push_back(static_cast<uint8_t>(operation));
+  frame.push_back(static_cast<uint8_t>(current.key.size()));
+  frame.insert(frame.end(), current.key.begin(), current.key.end());
+  frame.insert(frame.end(), data.begin(), data.end());
+
+  std::vector<uint8_t> response;
+  for (int attempt = 0;; attempt++) {
+    const bool reused =
+        connection.fd.valid() && connection.generation == current.generation;
+    try {
+      if (!reused) {
+        connection.fd = tools::connect_unix(current.socket_path);
+        connection.generation = current.generation;
+      }
+      tools::write_frame(connection.fd.get(), frame);
+      if (!tools::read_frame(connection.fd.get(), response)) {
+        throw std::system_error(ECONNRESET, std::generic_category(),
+                                "signd closed the connection");
+      }
+      break;
+    } catch (const std::system_error &) {
+      connection.fd.reset();
+      // a kept connection fails once when the daemon restarts
+      if (!reused || attempt > 0) {
+        throw;
+      }
+    }
+  }
+
+  if (response.empty()) {
+    throw std::runtime_error("signd sent an empty response");
+  }
+  if (response[0] != 0) {
+    throw std::runtime_error("signd: " +
+                             std::string(response.begin() + 1, response.end()));
+  }
+  response.erase(response.begin());
+  return response;
+}
+} // namespace
+
+void configure(const std::filesystem::path &socket_path,
+               const std::string &key) {
+  const std::lock_guard lock(config_mutex);
+  config.socket_path = socket_path;
+  config.key = key;
+  config.generation++;
+}
+
+std::vector<unsigned char> sign(const std::vector<unsigned char> &data) {
+  return request(Operation::Sign, data);
+}
+
+std::string certificates() {
+  const auto pem = request(Operation::Certificates, {});
+  return {pem.begin(), pem.end()};
+}
+
+} // namespace c2pa::signd
@@ -0,0 +1,102 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "signd.hpp"
+
+#include <csignal>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace c2pa::signd;
+
+namespace {
+Server *running = nullptr;
+
+void handle_signal(int /*signal*/) {
+  if (running != nullptr) {
+    running->stop();
+  }
+}
+
+void usage() {
+  std::cerr << "usage: c2pa-signd --socket PATH [--threads N] [--batch N]\n"
+               "                  --key NAME:ALG:KEY.pem:CERTS.pem ...\n"
+               "ALG is es256, es384, es512, ps256, ps384, ps512 or ed25519.\n"
+               "Clients use the key named default unless they name another.\n";
+}
+
+KeyConfig parse_key(const std::string &arg) {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  for (size_t colon; (colon = arg.find(':', start)) != std::string::npos;
+       start = colon + 1) {
+    parts.push_back(arg.substr(start, colon - start));
+  }
+  parts.push_back(arg.substr(start));
+  if (parts.size() != 4) {
+    throw std::invalid_argument("--key " + arg);
+  }
+  return {parts[0], parts[1], parts[2], parts[3]};
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string socket_path;
+  unsigned threads = 0;
+  size_t batch = 64;
+  std::vector<KeyConfig> keys;
+  try {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (i + 1 >= argc) {
+        usage();
+        return 2;
+      }
+      const std::string value = argv[++i];
+      if (arg == "--socket") {
+        socket_path = value;
+      } else if (arg == "--threads") {
+        threads = static_cast<unsigned>(std::stoul(value));
+      } else if (arg == "--batch") {
+        batch = std::stoul(value);
+      } else if (arg == "--key") {
+        keys.push_back(parse_key(value));
+      } else {
+        usage();
+        return 2;
+      }
+    }
+    if (socket_path.empty() || keys.empty()) {
+      usage();
+      return 2;
+    }
+
+    Server server(keys, threads, batch);
+    running = &server;
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cerr << "c2pa-signd listening on " << socket_path << '\n';
+    server.serve(socket_path);
+    running = nullptr;
+    std::cerr << "c2pa-signd signed " << server.signed_count() << " in "
+              << server.batch_count() << " batches with "
+              << server.context_count() << " signing contexts\n";
+  } catch (const std::exception &e) {
+    std::cerr << "c2pa-signd: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,327 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "signd.hpp"
+#include "unix_socket.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+
+namespace c2pa::signd {
+
+namespace {
+struct PkeyFree {
+  void operator()(EVP_PKEY *pkey) const { EVP_PKEY_free(pkey); }
+};
+
+struct MdCtxFree {
+  void operator()(EVP_MD_CTX *ctx) const { EVP_MD_CTX_free(ctx); }
+};
+
+struct Key {
+  std::unique_ptr<EVP_PKEY, PkeyFree> pkey;
+  // nullptr for ed25519, which hashes internally
+  const EVP_MD *md = nullptr;
+  bool pss = false;
+  std::string certificates;
+};
+
+Key load_key(const KeyConfig &config) {
+  static const std::map<std::string, std::pair<const char *, const EVP_MD *>,
+                        std::less<>>
+      algs = {{"es256", {"EC", EVP_sha256()}},
+              {"es384", {"EC", EVP_sha384()}},
+              {"es512", {"EC", EVP_sha512()}},
+              {"ps256", {"RSA", EVP_sha256()}},
+              {"ps384", {"RSA", EVP_sha384()}},
+              {"ps512", {"RSA", EVP_sha512()}},
+              {"ed25519", {"ED25519", nullptr}}};
+  const auto alg = algs.find(config.alg);
+  if (alg == algs.end()) {
+    throw std::runtime_error("key " + config.name + ": unknown algorithm " +
+                             config.alg);
+  }
+
+  Key key;
+  FILE *file = fopen(config.private_key.string().c_str(), "r");
+  if (file == nullptr) {
+    throw std::runtime_error("key " + config.name + ": failed to open " +
+                             config.private_key.string());
+  }
+  key.pkey.reset(PEM_read_PrivateKey(file, nullptr, nullptr, nullptr));
+  fclose(file);
+  if (!key.pkey) {
+    throw std::runtime_error("key " + config.name +
+                             ": failed to read private key");
+  }
+  const auto [type, md] = alg->second;
+  if (EVP_PKEY_is_a(key.pkey.get(), type) == 0) {
+    throw std::runtime_error("key " + config.name + ": not a " + type +
+                             " key");
+  }
+  key.md = md;
+  key.pss = config.alg.starts_with("ps");
+
+  std::ifstream certs(config.certificates, std::ios::binary);
+  if (!certs) {
+    throw std::runtime_error("key " + config.name + ": failed to open " +
+                             config.certificates.string());
+  }
+  key.certificates.assign(std::istreambuf_iterator<char>(certs),
+                          std::istreambuf_iterator<char>());
+  return key;
+}
+
+using MdCtx = std::unique_ptr<EVP_MD_CTX, MdCtxFree>;
+
+// looks up the algorithms and sets up the key, the costly part of a signature
+MdCtx init_context(const Key &key) {
+  MdCtx ctx(EVP_MD_CTX_new());
+  if (!ctx) {
+    throw std::runtime_error("failed to create signing context");
+  }
+  EVP_PKEY_CTX *pctx = nullptr;
+  if (EVP_DigestSignInit(ctx.get(), &pctx, key.md, nullptr,
+                         key.pkey.get()) <= 0) {
+    throw std::runtime_error("failed to initialize signing");
+  }
+  if (key.pss && (EVP_PKEY_CTX_set_rsa_padding(pctx,
+                                               RSA_PKCS1_PSS_PADDING) <= 0 ||
+                  EVP_PKEY_CTX_set_rsa_pss_saltlen(
+                      pctx, RSA_PSS_SALTLEN_DIGEST) <= 0 ||
+                  EVP_PKEY_CTX_set_rsa_mgf1_md(pctx, key.md) <= 0)) {
+    throw std::runtime_error("failed to set PSS padding");
+  }
+  return ctx;
+}
+
+// signs with a copy of an initialized context, which a signature finalizes
+std::vector<uint8_t> sign_with(EVP_MD_CTX *ctx, const EVP_MD_CTX *initialized,
+                               std::span<const uint8_t> data) {
+  if (EVP_MD_CTX_copy_ex(ctx, initialized) <= 0) {
+    throw std::runtime_error("failed to copy signing context");
+  }
+  size_t size = 0;
+  if (EVP_DigestSign(ctx, nullptr, &size, data.data(), data.size()) <= 0) {
+    throw std::runtime_error("failed to size signature");
+  }
+  std::vector<uint8_t> signature(size);
+  if (EVP_DigestSign(ctx, signature.data(), &size, data.data(),
+                     data.size()) <= 0) {
+    throw std::runtime_error("failed to sign");
+  }
+  signature.resize(size);
+  return signature;
+}
+
+std::vector<uint8_t> reply(bool ok, std::span<const uint8_t> body) {
+  std::vector<uint8_t> response;
+  response.reserve(body.size() + 1);
+  response.push_back(ok ? 0 : 1);
+  response.insert(response.end(), body.begin(), body.end());
+  return response;
+}
+
+std::vector<uint8_t> reply(bool ok, std::string_view body) {
+  return reply(ok, std::span(reinterpret_cast<const uint8_t *>(body.data()),
+                             body.size()));
+}
+} // namespace
+
+struct Server::State {
+  struct Job {
+    const Key *key = nullptr;
+    std::span<const uint8_t> data;
+    std::promise<std::vector<uint8_t>> result;
+  };
+
+  std::map<std::string, Key, std::less<>> keys;
+  unsigned threads = 0;
+  size_t max_batch = 0;
+
+  std::mutex queue_mutex;
+  std::condition_variable queue_ready;
+  std::deque<Job *> queue;
+  bool stopping = false;
+
+  std::atomic<uint64_t> signed_count{0};
+  std::atomic<uint64_t> batch_count{0};
+  std::atomic<uint64_t> context_count{0};
+
+  // written to by stop(), watched by serve()
+  int stop_pipe[2] = {-1, -1};
+
+  void work();
+  std::vector<uint8_t> respond(std::span<const uint8_t> request);
+  void connection(int fd);
+};
+
+void Server::State::work() {
+  // set up on first use of each key and kept for the life of the thread
+  std::map<const Key *, MdCtx> initialized;
+  const MdCtx ctx(EVP_MD_CTX_new());
+  std::unique_lock lock(queue_mutex);
+  std::vector<Job *> batch;
+  while (true) {
+    queue_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (queue.empty()) {
+      return;
+    }
+    const size_t count = std::min(queue.size(), max_batch);
+    batch.assign(queue.begin(), queue.begin() + static_cast<long>(count));
+    queue.erase(queue.begin(), queue.begin() + static_cast<long>(count));
+    lock.unlock();
+    // counted first, so a client that has its signature sees it counted
+    signed_count += batch.size();
+    batch_count++;
+
+    for (Job *job : batch) {
+      try {
+        if (!ctx) {
+          throw std::runtime_error("failed to create signing context");
+        }
+        auto &key_ctx = initialized[job->key];
+        if (!key_ctx) {
+          key_ctx = init_context(*job->key);
+          context_count++;
+        }
+        job->result.set_value(sign_with(ctx.get(), key_ctx.get(), job->data));
+      } catch (...) {
+        job->result.set_exception(std::current_exception());
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+std::vector<uint8_t>
+Server::State::respond(std::span<const uint8_t> request) {
+  if (request.size() < 2 || request.size() < size_t{2} + request[1]) {
+    return reply(false, "malformed request");
+  }
+  const auto operation = static_cast<Operation>(request[0]);
+  const auto *name_data = reinterpret_cast<const char *>(request.data() + 2);
+  const std::string_view name(name_data, request[1]);
+  const auto key = keys.find(name);
+  if (key == keys.end()) {
+    return reply(false, "unknown key " + std::string(name));
+  }
+
+  switch (operation) {
+  case Operation::Certificates:
+    return reply(true, key->second.certificates);
+  case Operation::Sign: {
+    Job job;
+    job.key = &key->second;
+    job.data = request.subspan(size_t{2} + request[1]);
+    auto result = job.result.get_future();
+    {
+      const std::lock_guard lock(queue_mutex);
+      queue.push_back(&job);
+    }
+    queue_ready.notify_one();
+    try {
+      return reply(true, result.get());
+    } catch (const std::exception &e) {
+      return reply(false, e.what());
+    }
+  }
+  default:
+    return reply(false, "unknown operation");
+  }
+}
+
+void Server::State::connection(int fd) {
+  std::vector<uint8_t> request;
+  try {
+    while (tools::read_frame(fd, request)) {
+      tools::write_frame(fd, respond(request));
+    }
+  } catch (const std::exception &) {
+    // the client went away or broke the framing, drop the connection
+  }
+}
+
+Server::Server(const std::vector<KeyConfig> &keys, unsigned threads,
+               size_t max_batch)
+    : state_(std::make_unique<State>()) {
+  for (const auto &config : keys) {
+    state_->keys.insert_or_assign(config.name, load_key(config));
+  }
+  state_->threads = threads != 0
+                        ? threads
+                        : std::max(1u, std::thread::hardware_concurrency());
+  state_->max_batch = std::max<size_t>(1, max_batch);
+  if (pipe(state_->stop_pipe) != 0) {
+    throw std::system_error(errno, std::generic_category(), "pipe");
+  }
+}
+
+Server::~Server() {
+  close(state_->stop_pipe[0]);
+  close(state_->stop_pipe[1]);
+}
+
+void Server::serve(const std::filesystem::path &socket_path) {
+  State &state = *state_;
+  const tools::Fd listener = tools::listen_unix(socket_path);
+
+  std::vector<std::thread> workers;
+  state.stopping = false;
+  for (unsigned i = 0; i < state.threads; i++) {
+    workers.emplace_back([&state] { state.work(); });
+  }
+
+  // requests in the queue are still answered while the connections close
+  tools::serve_connections(listener.get(), state.stop_pipe[0],
+                           [&state](int fd) { state.connection(fd); });
+  std::error_code ignored;
+  std::filesystem::remove(socket_path, ignored);
+  {
+    const std::lock_guard lock(state.queue_mutex);
+    state.stopping = true;
+  }
+  state.queue_ready.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void Server::stop() {
+  const char wake = 1;
+  (void)write(state_->stop_pipe[1], &wake, 1);
+}
+
+uint64_t Server::signed_count() const { return state_->signed_count; }
+
+uint64_t Server::batch_count() const { return state_->batch_count; }
+
+uint64_t Server::context_count() const { return state_->context_count; }
+
+} // namespace c2pa::signd
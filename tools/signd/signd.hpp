@@ -0,0 +1,123 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+/// @file   signd.hpp
+/// @brief  A local signing daemon and its client.
+/// @details c2pa-signd loads the signing keys once and signs for any number
+///          of processes over a Unix domain socket. Clients pass sign() to
+///          c2pa::Signer in place of a signer of their own:
+///
+///              c2pa::signd::configure("/run/c2pa-signd.sock", "es256");
+///              auto signer = c2pa::Signer(&c2pa::signd::sign, Es256,
+///                                         c2pa::signd::certificates(), tsa);
+///
+///          A request is a frame holding an operation byte, the length of
+///          the key name as a byte, the key name and the data to sign. A
+///          response is a status byte, 0 for success, followed by the result
+///          or an error message.
+
+#ifndef C2PA_SIGND_H
+#define C2PA_SIGND_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace c2pa::signd {
+
+/// Operations a client can request.
+enum class Operation : uint8_t {
+  /// Sign the data with the key.
+  Sign = 1,
+  /// Get the certificate chain of the key as PEM.
+  Certificates = 2,
+};
+
+/// @brief A key the daemon signs with.
+struct KeyConfig {
+  /// The name clients ask for the key by.
+  std::string name;
+  /// es256, es384, es512, ps256, ps384, ps512 or ed25519.
+  std::string alg;
+  /// The PEM private key.
+  std::filesystem::path private_key;
+  /// The PEM certificate chain, served to clients for c2pa::Signer.
+  std::filesystem::path certificates;
+};
+
+/// @brief Serves signing requests on a Unix domain socket.
+/// @details Each connection is read on a thread of its own, and the requests
+/// from all of them are queued for a pool of signing threads. A signing
+/// thread takes every queued request up to the batch size at once. It sets
+/// up a signing context for a key, looking up the algorithms and loading the
+/// key into it, the first time it signs with that key, and signs each
+/// request with a copy of it.
+class Server {
+public:
+  /// @brief Load the keys and certificates.
+  /// @param keys the keys to serve.
+  /// @param threads the number of signing threads, 0 for one per core.
+  /// @param max_batch the most requests a signing thread takes at once.
+  /// @throws std::runtime_error if a key or certificate can't be loaded.
+  explicit Server(const std::vector<KeyConfig> &keys, unsigned threads = 0,
+                  size_t max_batch = 64);
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+  ~Server();
+
+  /// @brief Serve requests until stop() is called.
+  /// @param socket_path the socket to listen on, replaced if it exists.
+  /// @throws std::system_error if the socket can't be opened.
+  void serve(const std::filesystem::path &socket_path);
+
+  /// @brief Make serve() return once the requests being signed are answered.
+  /// @details Safe to call from a signal handler.
+  void stop();
+
+  /// @brief The number of requests signed so far.
+  [[nodiscard]] uint64_t signed_count() const;
+
+  /// @brief The number of batches the requests were signed in.
+  [[nodiscard]] uint64_t batch_count() const;
+
+  /// @brief The number of signing contexts set up, at most one per key for
+  /// each signing thread.
+  [[nodiscard]] uint64_t context_count() const;
+
+private:
+  struct State;
+  std::unique_ptr<State> state_;
+};
+
+/// @brief Set the daemon and key that sign() and certificates() use.
+/// @details Applies to every thread. Each thread keeps its own connection.
+/// @param socket_path the socket the daemon listens on.
+/// @param key the name of the key to sign with.
+void configure(const std::filesystem::path &socket_path,
+               const std::string &key = "default");
+
+/// @brief Sign data with the daemon, a c2pa::SignerFunc.
+/// @details Reconnects once if the daemon has restarted since the last call.
+/// @throws std::runtime_error if the daemon refuses the request.
+/// @throws std::system_error if the daemon can't be reached.
+std::vector<unsigned char> sign(const std::vector<unsigned char> &data);
+
+/// @brief Get the certificate chain of the configured key, as PEM.
+/// @throws std::runtime_error if the daemon refuses the request.
+/// @throws std::system_error if the daemon can't be reached.
+std::string certificates();
+
+} // namespace c2pa::signd
+
+#endif // C2PA_SIGND_H
@@ -0,0 +1,320 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "unix_socket.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+namespace c2pa::tools {
+
+namespace {
+[[noreturn]] void throw_errno(const std::string &what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+sockaddr_un socket_address(const std::filesystem::path &path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const std::string native = path.string();
+  if (native.size() >= sizeof(address.sun_path)) {
+    throw std::system_error(ENAMETOOLONG, std::generic_category(),
+                            "socket path " + native);
+  }
+  std::memcpy(address.sun_path, native.c_str(), native.size() + 1);
+  return address;
+}
+
+Fd unix_socket() {
+#ifdef SOCK_CLOEXEC
+  Fd fd(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+#else
+  Fd fd(socket(AF_UNIX, SOCK_STREAM, 0));
+#endif
+  if (!fd.valid()) {
+    throw_errno("socket");
+  }
+#ifdef SO_NOSIGPIPE
+  // macOS has no MSG_NOSIGNAL, a closed peer must not kill the process
+  const int on = 1;
+  setsockopt(fd.get(), SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+  return fd;
+}
+
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+// reads exactly size bytes, returns the number read before end of file
+size_t read_all(int fd, uint8_t *data, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t count = recv(fd, data + done, size - done, 0);
+    if (count == 0) {
+      break;
+    }
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_errno("recv");
+    }
+    done += static_cast<size_t>(count);
+  }
+  return done;
+}
+
+// reads the first bytes of a message, which carry any passed descriptor
+size_t read_first(int fd, uint8_t *data, size_t size, Fd *passed) {
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  iovec io{data, size};
+  msghdr message{};
+  message.msg_iov = &io;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+#ifdef MSG_CMSG_CLOEXEC
+  const int flags = MSG_CMSG_CLOEXEC;
+#else
+  const int flags = 0;
+#endif
+  ssize_t count = 0;
+  do {
+    count = recvmsg(fd, &message, flags);
+  } while (count < 0 && errno == EINTR);
+  if (count < 0) {
+    throw_errno("recvmsg");
+  }
+  for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    int received = -1;
+    std::memcpy(&received, CMSG_DATA(header), sizeof(received));
+    Fd owned(received);
+    if (passed != nullptr) {
+      *passed = std::move(owned);
+    }
+  }
+  if (count == 0) {
+    return 0;
+  }
+  const auto first = static_cast<size_t>(count);
+  return first + read_all(fd, data + first, size - first);
+}
+
+void write_all(int fd, const uint8_t *data, size_t size) {
+  while (size > 0) {
+    const ssize_t count = send(fd, data, size, send_flags);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_errno("send");
+    }
+    data += count;
+    size -= static_cast<size_t>(count);
+  }
+}
+} // namespace
+
+Fd::Fd(Fd &&other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+
+Fd &Fd::operator=(Fd &&other) noexcept {
+  if (this != &other) {
+    reset();
+    fd_ = std::exchange(other.fd_, -1);
+  }
+  return *this;
+}
+
+Fd::~Fd() { reset(); }
+
+void Fd::reset() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+Fd listen_unix(const std::filesystem::path &path) {
+  // bound under another name and renamed once listening, so clients never
+  // find a socket that refuses them
+  std::filesystem::path bound_path = path;
+  bound_path += ".listening";
+  const sockaddr_un address = socket_address(bound_path);
+  Fd fd = unix_socket();
+  std::error_code ignored;
+  std::filesystem::remove(bound_path, ignored);
+  const mode_t mask = umask(0077);
+  const int bound = bind(fd.get(), reinterpret_cast<const sockaddr *>(&address),
+                         sizeof(address));
+  umask(mask);
+  if (bound != 0) {
+    throw_errno("bind " + bound_path.string());
+  }
+  if (listen(fd.get(), SOMAXCONN) != 0) {
+    throw_errno("listen " + bound_path.string());
+  }
+  // replaces a socket left by a daemon that did not shut down
+  if (std::filesystem::exists(path, ignored) &&
+      !std::filesystem::is_socket(path, ignored)) {
+    std::filesystem::remove(bound_path, ignored);
+    throw std::system_error(EEXIST, std::generic_category(), path.string());
+  }
+  if (rename(bound_path.c_str(), path.c_str()) != 0) {
+    throw_errno("rename " + path.string());
+  }
+  return fd;
+}
+
+Fd connect_unix(const std::filesystem::path &path) {
+  const sockaddr_un address = socket_address(path);
+  Fd fd = unix_socket();
+  while (connect(fd.get(), reinterpret_cast<const sockaddr *>(&address),
+                 sizeof(address)) != 0) {
+    if (errno != EINTR) {
+      throw_errno("connect " + path.string());
+    }
+  }
+  return fd;
+}
+
+bool read_frame(int fd, std::vector<uint8_t> &frame, Fd *passed) {
+  uint8_t header[4];
+  const size_t read = read_first(fd, header, sizeof(header), passed);
+  if (read == 0) {
+    return false;
+  }
+  if (read < sizeof(header)) {
+    throw std::system_error(EPROTO, std::generic_category(), "short frame");
+  }
+  const uint32_t size = uint32_t{header[0]} | uint32_t{header[1]} << 8 |
+                        uint32_t{header[2]} << 16 | uint32_t{header[3]} << 24;
+  if (size > max_frame_size) {
+    throw std::system_error(EMSGSIZE, std::generic_category(), "frame size");
+  }
+  frame.resize(size);
+  if (read_all(fd, frame.data(), size) < size) {
+    throw std::system_error(EPROTO, std::generic_category(), "short frame");
+  }
+  return true;
+}
+
+void write_frame(int fd, std::span<const uint8_t> frame, int passed) {
+  if (frame.size() > max_frame_size) {
+    throw std::system_error(EMSGSIZE, std::generic_category(), "frame size");
+  }
+  const auto size = static_cast<uint32_t>(frame.size());
+  uint8_t header[4] = {
+      static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+      static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 24)};
+  if (passed < 0) {
+    write_all(fd, header, sizeof(header));
+  } else {
+    // the descriptor goes with the header, where read_frame looks for it
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    iovec io{header, sizeof(header)};
+    msghdr message{};
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr *control_header = CMSG_FIRSTHDR(&message);
+    control_header->cmsg_level = SOL_SOCKET;
+    control_header->cmsg_type = SCM_RIGHTS;
+    control_header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(control_header), &passed, sizeof(passed));
+    ssize_t count = 0;
+    do {
+      count = sendmsg(fd, &message, send_flags);
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+      throw_errno("sendmsg");
+    }
+    const auto sent = static_cast<size_t>(count);
+    write_all(fd, header + sent, sizeof(header) - sent);
+  }
+  write_all(fd, frame.data(), frame.size());
+}
+
+void serve_connections(int listener, int stop_fd,
+                       const std::function<void(int)> &handler) {
+  // shared with the connection threads, which may outlive the loop briefly
+  struct Connections {
+    std::mutex mutex;
+    std::condition_variable done;
+    std::set<int> open;
+  };
+  const auto connections = std::make_shared<Connections>();
+
+  pollfd fds[2] = {{listener, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if ((fds[1].revents & POLLIN) != 0) {
+      char drained = 0;
+      (void)read(stop_fd, &drained, 1);
+      break;
+    }
+    if ((fds[0].revents & POLLIN) == 0) {
+      continue;
+    }
+    Fd client(accept(listener, nullptr, nullptr));
+    if (!client.valid()) {
+      continue;
+    }
+    const std::lock_guard lock(connections->mutex);
+    connections->open.insert(client.get());
+    std::thread([connections, &handler, fd = std::move(client)]() mutable {
+      try {
+        handler(fd.get());
+      } catch (...) {
+        // a failed connection does not stop the others
+      }
+      const std::lock_guard closing(connections->mutex);
+      connections->open.erase(fd.get());
+      fd.reset();
+      connections->done.notify_all();
+    }).detach();
+  }
+
+  std::unique_lock lock(connections->mutex);
+  for (const int fd : connections->open) {
+    shutdown(fd, SHUT_RDWR);
+  }
+  connections->done.wait(lock, [&] { return connections->open.empty(); });
+}
+
+} // namespace c2pa::tools
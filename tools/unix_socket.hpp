@@ -0,0 +1,79 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+/// @file   unix_socket.hpp
+/// @brief  Unix domain sockets and message framing for the local daemons.
+/// @details Each message is a 32 bit little endian length followed by that
+///          many bytes. Errors are thrown as std::system_error.
+
+#ifndef C2PA_TOOLS_UNIX_SOCKET_H
+#define C2PA_TOOLS_UNIX_SOCKET_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace c2pa::tools {
+
+/// The largest message read, to bound memory for a misbehaving peer.
+constexpr uint32_t max_frame_size = 64 * 1024 * 1024;
+
+/// @brief A file descriptor, closed when it goes out of scope.
+class Fd {
+public:
+  Fd() = default;
+  explicit Fd(int fd) : fd_(fd) {}
+  Fd(const Fd &) = delete;
+  Fd &operator=(const Fd &) = delete;
+  Fd(Fd &&other) noexcept;
+  Fd &operator=(Fd &&other) noexcept;
+  ~Fd();
+
+  [[nodiscard]] int get() const { return fd_; }
+  [[nodiscard]] bool valid() const { return fd_ >= 0; }
+  void reset();
+
+private:
+  int fd_ = -1;
+};
+
+/// @brief Listen on a socket path, replacing a socket left at the path.
+/// @details The socket is only accessible to the owner of the process.
+Fd listen_unix(const std::filesystem::path &path);
+
+/// @brief Connect to a listening socket path.
+Fd connect_unix(const std::filesystem::path &path);
+
+/// @brief Read one message, and a descriptor sent with it.
+/// @param passed receives a descriptor sent with the message. Descriptors
+/// are closed if this is nullptr.
+/// @return false if the peer closed the connection between messages.
+bool read_frame(int fd, std::vector<uint8_t> &frame, Fd *passed = nullptr);
+
+/// @brief Write one message.
+/// @param passed a descriptor to send with the message, or -1.
+void write_frame(int fd, std::span<const uint8_t> frame, int passed = -1);
+
+/// @brief Run a handler on a thread of its own for each connection.
+/// @details Returns once stop_fd is readable and every handler has returned.
+/// Connections still open then are shut down, so blocked reads return.
+/// @param listener a socket from listen_unix.
+/// @param stop_fd a descriptor that becomes readable to stop, it is read.
+/// @param handler serves a connection, which is closed when it returns.
+void serve_connections(int listener, int stop_fd,
+                       const std::function<void(int)> &handler);
+
+} // namespace c2pa::tools
+
+#endif // C2PA_TOOLS_UNIX_SOCKET_H
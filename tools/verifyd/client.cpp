@@ -0,0 +1,89 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "verifyd.hpp"
+
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+namespace c2pa::verifyd {
+
+Client::Client(std::filesystem::path socket_path)
+    : socket_path_(std::move(socket_path)) {}
+
+std::vector<uint8_t> Client::request(Operation operation, uint8_t flags,
+                                     const std::string &format,
+                                     const std::string &path, int fd) {
+  if (format.size() > 255) {
+    throw std::runtime_error("format is too long");
+  }
+  std::vector<uint8_t> frame;
+  frame.reserve(format.size() + path.size() + 3);
+  frame.push_back(static_cast<uint8_t>(operation));
+  frame.push_back(flags);
+  frame.push_back(static_cast<uint8_t>(format.size()));
+  frame.insert(frame.end(), format.begin(), format.end());
+  frame.insert(frame.end(), path.begin(), path.end());
+
+  std::vector<uint8_t> response;
+  for (int attempt = 0;; attempt++) {
+    const bool reused = connection_.valid();
+    try {
+      if (!reused) {
+        connection_ = tools::connect_unix(socket_path_);
+      }
+      tools::write_frame(connection_.get(), frame, fd);
+      if (!tools::read_frame(connection_.get(), response)) {
+        throw std::system_error(ECONNRESET, std::generic_category(),
+                                "verifyd closed the connection");
+      }
+      break;
+    } catch (const std::system_error &) {
+      connection_.reset();
+      // a kept connection fails once when the daemon restarts
+      if (!reused || attempt > 0) {
+        throw;
+      }
+    }
+  }
+
+  if (response.empty()) {
+    throw std::runtime_error("verifyd sent an empty response");
+  }
+  if (response[0] != 0) {
+    throw std::runtime_error(std::string(response.begin() + 1, response.end()));
+  }
+  response.erase(response.begin());
+  return response;
+}
+
+std::string Client::verify(const std::filesystem::path &path,
+                           const std::string &format) {
+  const auto summary =
+      request(Operation::VerifyPath, 0, format,
+              std::filesystem::absolute(path).string(), -1);
+  return {summary.begin(), summary.end()};
+}
+
+std::string Client::verify(int fd, const std::string &format) {
+  const auto summary = request(Operation::VerifyFd, 0, format, "", fd);
+  return {summary.begin(), summary.end()};
+}
+
+std::vector<uint8_t> Client::store(const std::filesystem::path &path,
+                                   const std::string &format) {
+  return request(Operation::VerifyPath, FullStore, format,
+                 std::filesystem::absolute(path).string(), -1);
+}
+
+} // namespace c2pa::verifyd
@@ -0,0 +1,108 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "verifyd.hpp"
+
+#include <c2pa.hpp>
+#include <csignal>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+
+using namespace c2pa::verifyd;
+
+namespace {
+Server *running = nullptr;
+
+void handle_signal(int /*signal*/) {
+  if (running != nullptr) {
+    running->stop();
+  }
+}
+
+void usage() {
+  std::cerr << "usage: c2pa-verifyd --socket PATH [--threads N] [--cache N]\n"
+               "                    [--cache-bytes N]\n"
+               "                    [--settings FILE.json|FILE.toml]\n";
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string socket_path;
+  std::string settings_path;
+  unsigned threads = 0;
+  size_t cache = 1024;
+  size_t cache_bytes = size_t{64} << 20;
+  try {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (i + 1 >= argc) {
+        usage();
+        return 2;
+      }
+      const std::string value = argv[++i];
+      if (arg == "--socket") {
+        socket_path = value;
+      } else if (arg == "--threads") {
+        threads = static_cast<unsigned>(std::stoul(value));
+      } else if (arg == "--cache") {
+        cache = std::stoul(value);
+      } else if (arg == "--cache-bytes") {
+        cache_bytes = std::stoul(value);
+      } else if (arg == "--settings") {
+        settings_path = value;
+      } else {
+        usage();
+        return 2;
+      }
+    }
+    if (socket_path.empty()) {
+      usage();
+      return 2;
+    }
+
+    // parsed once here instead of in every short lived process
+    std::optional<std::string> settings;
+    std::string format = "json";
+    if (!settings_path.empty()) {
+      std::ifstream file(settings_path);
+      if (!file) {
+        throw std::runtime_error("failed to open " + settings_path);
+      }
+      settings.emplace(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+      if (std::filesystem::path(settings_path).extension() == ".toml") {
+        format = "toml";
+      }
+    }
+    // so the first request does not pay for setting up the library
+    c2pa::initialize(settings, format);
+
+    Server server(threads, cache, cache_bytes);
+    running = &server;
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cerr << "c2pa-verifyd listening on " << socket_path << '\n';
+    server.serve(socket_path);
+    running = nullptr;
+    std::cerr << "c2pa-verifyd answered " << server.request_count()
+              << " requests with " << server.read_count() << " reads\n";
+  } catch (const std::exception &e) {
+    std::cerr << "c2pa-verifyd: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
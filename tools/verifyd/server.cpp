@@ -0,0 +1,395 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+#include "verifyd.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <c2pa.hpp>
+#include <c2pa_view.hpp>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fcntl.h>
+#include <future>
+#include <list>
+#include <mutex>
+#include <span>
+#include <streambuf>
+#include <string_view>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace c2pa::verifyd {
+
+namespace {
+/// Reads a file descriptor with pread, leaving its offset to the client.
+class FdStreambuf : public std::streambuf {
+public:
+  explicit FdStreambuf(int fd) : fd_(fd) { setg(buffer_, buffer_, buffer_); }
+
+protected:
+  int_type underflow() override {
+    ssize_t count = 0;
+    do {
+      count = pread(fd_, buffer_, sizeof(buffer_), offset_);
+    } while (count < 0 && errno == EINTR);
+    if (count <= 0) {
+      return traits_type::eof();
+    }
+    offset_ += count;
+    setg(buffer_, buffer_, buffer_ + count);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode /*which*/) override {
+    off_type base = offset_ - (egptr() - gptr());
+    if (dir == std::ios_base::beg) {
+      base = 0;
+    } else if (dir == std::ios_base::end) {
+      struct stat status {};
+      if (fstat(fd_, &status) != 0) {
+        return pos_type(off_type(-1));
+      }
+      base = status.st_size;
+    }
+    if (base + off < 0) {
+      return pos_type(off_type(-1));
+    }
+    offset_ = static_cast<off_t>(base + off);
+    setg(buffer_, buffer_, buffer_);
+    return pos_type(offset_);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+
+private:
+  int fd_;
+  off_t offset_ = 0;
+  char buffer_[64 * 1024];
+};
+
+struct Result {
+  bool ok = false;
+  std::vector<uint8_t> body;
+};
+
+Result failure(std::string_view message) {
+  return {false, {message.begin(), message.end()}};
+}
+
+void append_json_string(std::string &out, std::string_view text) {
+  out += '"';
+  for (const char c : text) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+  }
+  out += '"';
+}
+
+// reads the fields from the CBOR in place, there is no json to parse
+Result summarize(const c2pa::Reader &reader, bool full) {
+  if (full) {
+    return {true, reader.cbor()};
+  }
+  const auto store = reader.store();
+  const auto manifest = store.active_manifest();
+  std::string out = "{\"active_manifest\":";
+  append_json_string(out, manifest.label());
+  out += ",\"title\":";
+  append_json_string(out, manifest.title());
+  out += ",\"claim_generator\":";
+  append_json_string(out, manifest.claim_generator());
+  out += ",\"ingredients\":";
+  out += std::to_string(manifest.ingredients().size());
+  out += ",\"validation_status\":[";
+  bool first = true;
+  for (const auto &status : store.validation_status()) {
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+    append_json_string(out, status.value["code"].text());
+  }
+  out += "]}";
+  return {true, {out.begin(), out.end()}};
+}
+
+// the file's identity, so changed files are read again
+std::string identity(const struct stat &status) {
+#ifdef __APPLE__
+  const auto &mtime = status.st_mtimespec;
+#else
+  const auto &mtime = status.st_mtim;
+#endif
+  return std::to_string(status.st_dev) + ':' + std::to_string(status.st_ino) +
+         ':' + std::to_string(status.st_size) + ':' +
+         std::to_string(mtime.tv_sec) + '.' + std::to_string(mtime.tv_nsec);
+}
+
+std::vector<uint8_t> reply(const Result &result) {
+  std::vector<uint8_t> response;
+  response.reserve(result.body.size() + 1);
+  response.push_back(result.ok ? 0 : 1);
+  response.insert(response.end(), result.body.begin(), result.body.end());
+  return response;
+}
+} // namespace
+
+struct Server::State {
+  struct Job {
+    std::string key;
+    tools::Fd fd;
+    std::string format;
+    bool full = false;
+    std::promise<Result> result;
+  };
+
+  unsigned threads = 0;
+  size_t cache_entries = 0;
+  size_t cache_bytes = 0;
+
+  std::mutex queue_mutex;
+  std::condition_variable queue_ready;
+  std::deque<std::unique_ptr<Job>> queue;
+  bool stopping = false;
+
+  // guards in_flight and the cache
+  std::mutex results_mutex;
+  std::unordered_map<std::string, std::shared_future<Result>> in_flight;
+  // most recently used first
+  std::list<std::pair<std::string, Result>> cache;
+  std::unordered_map<std::string, decltype(cache)::iterator> cache_index;
+  // the size of the kept result bodies
+  size_t cached_bytes = 0;
+
+  std::atomic<uint64_t> request_count{0};
+  std::atomic<uint64_t> read_count{0};
+  std::atomic<uint64_t> coalesced_count{0};
+  std::atomic<uint64_t> cache_hit_count{0};
+
+  // written to by stop(), watched by serve()
+  int stop_pipe[2] = {-1, -1};
+
+  void work();
+  Result read(Job &job);
+  void finish(const std::string &key, const Result &result);
+  Result respond(std::span<const uint8_t> request, tools::Fd passed);
+  void connection(int fd);
+};
+
+Result Server::State::read(Job &job) {
+  read_count++;
+  try {
+    FdStreambuf buffer(job.fd.get());
+    std::istream stream(&buffer);
+    const c2pa::Reader reader(job.format, stream);
+    return summarize(reader, job.full);
+  } catch (const std::exception &e) {
+    return failure(e.what());
+  }
+}
+
+void Server::State::finish(const std::string &key, const Result &result) {
+  const std::lock_guard lock(results_mutex);
+  in_flight.erase(key);
+  // failures may be passing, such as an unreachable remote manifest
+  if (!result.ok || cache_entries == 0 || result.body.size() > cache_bytes) {
+    return;
+  }
+  cache.emplace_front(key, result);
+  cache_index[key] = cache.begin();
+  cached_bytes += result.body.size();
+  while (cache.size() > cache_entries || cached_bytes > cache_bytes) {
+    cached_bytes -= cache.back().second.body.size();
+    cache_index.erase(cache.back().first);
+    cache.pop_back();
+  }
+}
+
+void Server::State::work() {
+  std::unique_lock lock(queue_mutex);
+  while (true) {
+    queue_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (queue.empty()) {
+      return;
+    }
+    const std::unique_ptr<Job> job = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+
+    const Result result = read(*job);
+    finish(job->key, result);
+    job->result.set_value(result);
+
+    lock.lock();
+  }
+}
+
+Result Server::State::respond(std::span<const uint8_t> request,
+                              tools::Fd passed) {
+  request_count++;
+  if (request.size() < 3 || request.size() < size_t{3} + request[2]) {
+    return failure("malformed request");
+  }
+  auto job = std::make_unique<Job>();
+  const auto operation = static_cast<Operation>(request[0]);
+  job->full = (request[1] & FullStore) != 0;
+  const auto *text = reinterpret_cast<const char *>(request.data());
+  job->format.assign(text + 3, request[2]);
+  const std::string path(text + 3 + request[2], text + request.size());
+
+  if (operation == Operation::VerifyFd) {
+    if (!passed.valid() || job->format.empty()) {
+      return failure("a descriptor and format are needed");
+    }
+    job->fd = std::move(passed);
+  } else if (operation == Operation::VerifyPath) {
+    // opened once, so the read is of the file the key was made from
+    job->fd = tools::Fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!job->fd.valid()) {
+      return failure("failed to open " + path);
+    }
+    if (job->format.empty()) {
+      // as Reader does for a path
+      job->format = std::filesystem::path(path).extension().string();
+      if (!job->format.empty()) {
+        job->format.erase(0, 1);
+      }
+    }
+  } else {
+    return failure("unknown operation");
+  }
+  struct stat status {};
+  if (fstat(job->fd.get(), &status) != 0) {
+    return failure("failed to stat the file");
+  }
+  // the format chooses how the file is read
+  job->key = identity(status) + ':' + std::to_string(request[1]) + ':' +
+             job->format;
+
+  std::shared_future<Result> result;
+  {
+    const std::lock_guard lock(results_mutex);
+    if (const auto cached = cache_index.find(job->key);
+        cached != cache_index.end()) {
+      cache.splice(cache.begin(), cache, cached->second);
+      cache_hit_count++;
+      return cached->second->second;
+    }
+    if (const auto reading = in_flight.find(job->key);
+        reading != in_flight.end()) {
+      coalesced_count++;
+      result = reading->second;
+    } else {
+      result = job->result.get_future().share();
+      in_flight.emplace(job->key, result);
+      const std::lock_guard queue_lock(queue_mutex);
+      queue.push_back(std::move(job));
+      queue_ready.notify_one();
+    }
+  }
+  return result.get();
+}
+
+void Server::State::connection(int fd) {
+  std::vector<uint8_t> request;
+  tools::Fd passed;
+  try {
+    while (tools::read_frame(fd, request, &passed)) {
+      tools::write_frame(fd, reply(respond(request, std::move(passed))));
+      passed.reset();
+    }
+  } catch (const std::exception &) {
+    // the client went away or broke the framing, drop the connection
+  }
+}
+
+Server::Server(unsigned threads, size_t cache_entries, size_t cache_bytes)
+    : state_(std::make_unique<State>()) {
+  state_->threads = threads != 0
+                        ? threads
+                        : std::max(1u, std::thread::hardware_concurrency());
+  state_->cache_entries = cache_entries;
+  state_->cache_bytes = cache_bytes;
+  if (pipe(state_->stop_pipe) != 0) {
+    throw std::system_error(errno, std::generic_category(), "pipe");
+  }
+}
+
+Server::~Server() {
+  close(state_->stop_pipe[0]);
+  close(state_->stop_pipe[1]);
+}
+
+void Server::serve(const std::filesystem::path &socket_path) {
+  State &state = *state_;
+  const tools::Fd listener = tools::listen_unix(socket_path);
+
+  std::vector<std::thread> workers;
+  state.stopping = false;
+  for (unsigned i = 0; i < state.threads; i++) {
+    workers.emplace_back([&state] { state.work(); });
+  }
+
+  // reads in the queue are still answered while the connections close
+  tools::serve_connections(listener.get(), state.stop_pipe[0],
+                           [&state](int fd) { state.connection(fd); });
+  std::error_code ignored;
+  std::filesystem::remove(socket_path, ignored);
+  {
+    const std::lock_guard lock(state.queue_mutex);
+    state.stopping = true;
+  }
+  state.queue_ready.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void Server::stop() {
+  const char wake = 1;
+  (void)write(state_->stop_pipe[1], &wake, 1);
+}
+
+uint64_t Server::request_count() const { return state_->request_count; }
+
+uint64_t Server::read_count() const { return state_->read_count; }
+
+uint64_t Server::coalesced_count() const { return state_->coalesced_count; }
+
+uint64_t Server::cache_hit_count() const { return state_->cache_hit_count; }
+
+} // namespace c2pa::verifyd
@@ -0,0 +1,39 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+// A command line client for c2pa-verifyd, for scripts. Prints a line for
+// each file, the path then a json summary or an error, and exits with 1 if
+// any file failed.
+
+#include "verifyd.hpp"
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]) {
+  if (argc < 4 || std::string(argv[1]) != "--socket") {
+    std::cerr << "usage: c2pa-verify --socket PATH FILE...\n";
+    return 2;
+  }
+  c2pa::verifyd::Client client(argv[2]);
+  int status = 0;
+  for (int i = 3; i < argc; i++) {
+    try {
+      std::cout << argv[i] << '\t' << client.verify(argv[i]) << '\n';
+    } catch (const std::exception &e) {
+      std::cout << argv[i] << "\terror: " << e.what() << '\n';
+      status = 1;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,138 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+/// @file   verifyd.hpp
+/// @brief  A local verification daemon and its client.
+/// @details c2pa-verifyd loads the settings and sets up the library once
+///          and reads manifests for short lived processes over a Unix
+///          domain socket. c2pa still parses the trust lists in the
+///          settings for every read.
+///          Clients send a path, or pass an open file descriptor, and get
+///          back a one line json summary or the manifest store as CBOR.
+///
+///          A request is a frame holding an operation byte, a flags byte,
+///          the length of the format as a byte, the format and, for paths,
+///          the path. A descriptor is sent with the frame. A response is a
+///          status byte, 0 for success, followed by the result or an error
+///          message.
+
+#ifndef C2PA_VERIFYD_H
+#define C2PA_VERIFYD_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "unix_socket.hpp"
+
+namespace c2pa::verifyd {
+
+/// Operations a client can request.
+enum class Operation : uint8_t {
+  /// Read the file at a path.
+  VerifyPath = 1,
+  /// Read the file descriptor sent with the request.
+  VerifyFd = 2,
+};
+
+/// Request flags.
+enum Flags : uint8_t {
+  /// Reply with the manifest store as CBOR instead of a summary.
+  FullStore = 1,
+};
+
+/// @brief Serves verification requests on a Unix domain socket.
+/// @details Requests are read by a pool of reader threads. Requests for a
+/// file another thread is already reading wait for that read instead of
+/// starting their own, and the results of recent reads are kept, keyed by
+/// the file's device, inode, size and modification time. The least recently
+/// used results are dropped once either limit on the kept results is passed.
+class Server {
+public:
+  /// @param threads the number of reader threads, 0 for one per core.
+  /// @param cache_entries the number of results to keep, 0 for none.
+  /// @param cache_bytes the total size of the results to keep.
+  explicit Server(unsigned threads = 0, size_t cache_entries = 1024,
+                  size_t cache_bytes = size_t{64} << 20);
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+  ~Server();
+
+  /// @brief Serve requests until stop() is called.
+  /// @param socket_path the socket to listen on, replaced if it exists.
+  /// @throws std::system_error if the socket can't be opened.
+  void serve(const std::filesystem::path &socket_path);
+
+  /// @brief Make serve() return once the reads in progress are answered.
+  /// @details Safe to call from a signal handler.
+  void stop();
+
+  /// @brief The number of requests answered so far.
+  [[nodiscard]] uint64_t request_count() const;
+
+  /// @brief The number of files read so far.
+  [[nodiscard]] uint64_t read_count() const;
+
+  /// @brief The number of requests that waited for another's read.
+  [[nodiscard]] uint64_t coalesced_count() const;
+
+  /// @brief The number of requests answered from kept results.
+  [[nodiscard]] uint64_t cache_hit_count() const;
+
+private:
+  struct State;
+  std::unique_ptr<State> state_;
+};
+
+/// @brief A connection to the daemon, for one thread at a time.
+class Client {
+public:
+  /// @param socket_path the socket the daemon listens on.
+  explicit Client(std::filesystem::path socket_path);
+
+  /// @brief Verify a file the daemon can open.
+  /// @param path the file, made absolute for the daemon.
+  /// @param format the mime format, or empty to go by the extension.
+  /// @return a json summary of the active manifest and validation status.
+  /// @throws std::runtime_error if the file has no valid manifest store.
+  /// @throws std::system_error if the daemon can't be reached.
+  std::string verify(const std::filesystem::path &path,
+                     const std::string &format = "");
+
+  /// @brief Verify an open file, which the daemon reads without seeking it.
+  /// @param fd the file.
+  /// @param format the mime format.
+  /// @return a json summary of the active manifest and validation status.
+  /// @throws std::runtime_error if the file has no valid manifest store.
+  /// @throws std::system_error if the daemon can't be reached.
+  std::string verify(int fd, const std::string &format);
+
+  /// @brief Get the manifest store of a file as CBOR, see Reader::cbor.
+  /// @throws std::runtime_error if the file has no valid manifest store.
+  /// @throws std::system_error if the daemon can't be reached.
+  std::vector<uint8_t> store(const std::filesystem::path &path,
+                             const std::string &format = "");
+
+private:
+  std::vector<uint8_t> request(Operation operation, uint8_t flags,
+                               const std::string &format,
+                               const std::string &path, int fd);
+
+  std::filesystem::path socket_path_;
+  tools::Fd connection_;
+};
+
+} // namespace c2pa::verifyd
+
+#endif // C2PA_VERIFYD_H